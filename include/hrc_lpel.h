@@ -22,7 +22,36 @@ void LpelTaskSetPriorityFunc(int func);
 /* set negative demand limit */
 void LpelTaskSetNegLim(int lim);
 
+/* set the priority tolerance within which the master prefers to dispatch
+ * a task to the worker it ran on last (or a topology neighbour);
+ * < 0 = no affinity (default)
+ */
+void LpelWorkerSetAffinityTol(double tol);
+
+/* number of direct switches from a leaving task to the next one on worker
+ * wid so far, without going through the worker loop; an unlocked snapshot
+ * for monitoring, to be called until LpelCleanup; -1 for an unknown worker
+ */
+long LpelWorkerDirectSwitches(int wid);
+
+/* set the default number of credits for middle streams (0 = unbounded);
+ * a producer without credits is not scheduled and blocks on writing */
+void LpelStreamSetMiddleCredit(int credit);
+
+/* set the number of credits for a stream, before it is written */
+void LpelStreamSetCredit(lpel_stream_t *s, int credit);
+
 /* set the limit of output records for a task */
 void LpelTaskSetRecLimit(lpel_task_t *t, int lim);
 
+/* adapt the limit of output records for a task online, so that the task
+ * yields after roughly slice usec of execution (0 = default slice,
+ * < 0 = back to the fixed limit)
+ */
+void LpelTaskSetRecLimitAdaptive(lpel_task_t *t, int slice);
+
+/* get the current limit of records for a task; in adaptive mode it
+ * follows the execution time per record */
+int LpelTaskGetRecLimit(lpel_task_t *t);
+
 #endif /* _HRC_LPEL_H */
@@ -34,15 +34,49 @@ void LpelTaskSetPriority(lpel_task_t *t, int prio);
 /* get wid of a task */
 int LpelTaskGetWorkerId(lpel_task_t *t);
 
+/** in-place access to the values of a value stream: the producer
+ * reserves up to *n values, writes them and commits them, the consumer
+ * acquires up to *n values, reads them and releases them. Both block
+ * for the first value only; *n is set to the number of values, which
+ * follow each other from the returned address */
+void *LpelStreamReserve( lpel_stream_desc_t *sd, int *n);
+void  LpelStreamCommit(  lpel_stream_desc_t *sd, int n);
+void *LpelStreamAcquire( lpel_stream_desc_t *sd, int *n);
+void  LpelStreamRelease( lpel_stream_desc_t *sd, int n);
+
+/** multicast stream: every item written is read by each of the readers,
+ * which open the stream one after the other. It is destroyed when a
+ * reader closes it with destroy_s, once all descriptors are closed.
+ * Multicast streams cannot be polled, peeked at or replaced */
+lpel_stream_t *LpelStreamCreateMulticast(int size, int readers);
+
+/** multi-producer stream: several tasks may open it for writing and
+ * write to it at the same time, a single task reads from it.
+ * Multi-producer streams cannot be polled or replaced */
+lpel_stream_t *LpelStreamCreateMultiProducer(int size);
+
 /******************************************************************************/
 /*  SPMD FUNCTIONS                                                            */
 /******************************************************************************/
 typedef void (*lpel_spmdfunc_t)(void *);
 int LpelSpmdVId(void);
 
+/** number of workers taking part in the current SPMD region */
+int LpelSpmdNumWorkers(void);
+
 /** enter SPMD request */
 void LpelTaskEnterSPMD(lpel_spmdfunc_t, void *);
 
+/** enter SPMD request on a subset of the workers (NULL = all),
+ * the worker of the calling task always takes part;
+ * requests on disjoint subsets run concurrently */
+void LpelTaskEnterSPMDSet(lpel_spmdfunc_t, void *, const int *workers, int num);
+
+/** fill workers with the ids of the workers on the same socket as the
+ * worker of the calling task (all workers if the topology is unknown),
+ * return their number; workers must hold LpelWorkerCount() entries */
+int LpelWorkerSocketSet(int *workers);
+
 void LpelTaskMigrationInit(lpel_tm_config_t *conf);
 
 
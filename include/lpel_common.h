@@ -74,6 +74,9 @@ typedef struct lpel_monitoring_cb_t {
   void (*task_assign)(mon_task_t*, mon_worker_t*);
   void (*task_start)(mon_task_t*);
   void (*task_stop)(mon_task_t*, lpel_taskstate_t);
+  /* peak stack use and stack size in bytes, upon destruction;
+   * only with stack watermarks (USE_STACK_WATERMARK) */
+  void (*task_stack)(mon_task_t*, unsigned long, unsigned long);
 
   /* callback functions support for task migration in lpel_decen */
   void (*task_ready)(mon_task_t*);
@@ -148,6 +151,14 @@ typedef struct lpel_task_t lpel_task_t;
 /* task function signature */
 typedef void *(*lpel_taskfunc_t)(void *inarg);
 
+/* record function of a stackless task, returns 0 to go on, LPEL_REC_RETRY
+ * if an output stream was full, or any other value to terminate the task */
+typedef int (*lpel_recfunc_t)(void *item, void *arg);
+
+/* the record function gets the same item again once the stream on which
+ * LpelStreamTryWrite has failed last has space */
+#define LPEL_REC_RETRY  (-1)
+
 
 /* stream type */
 typedef struct lpel_stream_t         lpel_stream_t;
@@ -174,6 +185,21 @@ typedef struct lpel_stream_iter_t    lpel_stream_iter_t;
 /** return the total number of workers (including master if in lpel_hrc) */
 int LpelWorkerCount(void);
 
+/** set the time slice (usec) after which a running task is hinted to yield,
+ * 0 = no preemption hints (default); to be called before LpelStart */
+void LpelWorkerSetTimeSlice(int usec);
+
+/** set the maximum number of helper threads for LpelTaskOffload (default 4);
+ * to be called before LpelStart */
+void LpelWorkerSetOffloadThreads(int n);
+
+/** queue depths of worker wid, an unlocked snapshot for monitoring:
+ * ready gets the number of ready tasks queued at the worker, mbox the
+ * number of messages in its mailbox and mbox_peak the highest number so
+ * far; wid -1 is the master in lpel_hrc. To be called until LpelCleanup;
+ * returns -1 for an unknown worker */
+int LpelWorkerQueueDepth(int wid, int *ready, int *mbox, int *mbox_peak);
+
 
 /******************************************************************************/
 /*  TASK FUNCTIONS                                                            */
@@ -182,21 +208,76 @@ int LpelWorkerCount(void);
 lpel_task_t *LpelTaskCreate( int worker, lpel_taskfunc_t func,
     void *inarg, int stacksize );
 
+/** create a task on the shared stack of its worker: only the used part of
+ * the stack is kept while the task is suspended; the task is not migrated,
+ * on wrappers and the hierarchical scheduler it gets a stack of its own */
+lpel_task_t *LpelTaskCreateShared( int worker, lpel_taskfunc_t func,
+    void *inarg );
+
+/** create a stackless task consuming the stream in: func is called on the
+ * stack of the worker for every item, it must not block. It writes with
+ * LpelStreamTryWrite, and returns LPEL_REC_RETRY if that fails: the task
+ * waits for space then, and func is called with the same item again (it
+ * has to skip what it wrote for the item before). Multicast and
+ * multi-producer streams cannot be waited for. Start it with LpelTaskStart */
+lpel_task_t *LpelTaskCreateStackless( int worker, lpel_recfunc_t func,
+    void *arg, lpel_stream_t *in );
+
 /** monitor a task */
 void LpelTaskMonitor(lpel_task_t *t, mon_task_t *mt);
 
 unsigned int LpelTaskGetId( lpel_task_t *t );
 mon_task_t *LpelTaskGetMon( lpel_task_t *t );
 
+/** let the task keep its floating-point control state (MXCSR, x87
+ * control word) across context switches, for tasks changing the rounding
+ * mode or the exception masks; the other tasks run with the default
+ * state. To be called before LpelTaskStart */
+void LpelTaskSaveFpState( lpel_task_t *t );
+
 /** let the previously created task run */
 void LpelTaskStart( lpel_task_t *t );
 
+/** number of buckets of LpelTaskStackHistogram() */
+#define LPEL_STACK_HIST_BUCKETS  16
+
+/** peak stack use of the tasks destroyed so far, for a library built with
+ * stack watermarks (--enable-stack-watermark): hist[i] counts the tasks
+ * using less than 512 << i bytes, the last bucket all larger ones;
+ * returns the number of tasks, maxpeak gets the largest peak in bytes */
+unsigned long LpelTaskStackHistogram( unsigned long *hist,
+    unsigned long *maxpeak );
+
 
 /** to be called from within a task: */
 lpel_task_t *LpelTaskSelf(void);
 void LpelTaskExit(void);
 void LpelTaskYield(void);
 
+/** suspend the current task for at least usec microseconds,
+ * without blocking its worker */
+void LpelTaskSleep(unsigned long usec);
+
+/** suspend the current task until abstime (w.r.t. LpelTimingNow) */
+struct timespec;
+void LpelTaskWaitUntil(const struct timespec *abstime);
+
+/** events for LpelTaskWaitFd */
+#define LPEL_FD_READ    1
+#define LPEL_FD_WRITE   2
+
+/** suspend the current task until fd is ready for one of the events,
+ * without blocking its worker; returns the ready events, -1 on error */
+int LpelTaskWaitFd(int fd, int events);
+
+/** run the blocking call fn(arg) on a helper thread and return its result,
+ * without blocking the worker of the current task */
+void *LpelTaskOffload(void *(*fn)(void *), void *arg);
+
+/** cheap check if the current task has used up its time slice
+ * (see LpelWorkerSetTimeSlice); a long running task should yield then */
+int LpelTaskShouldYield(void);
+
 /** check and migrate the current task if required, used in decen_lpel
  * to be called from snet-rts
  * */
@@ -248,6 +329,19 @@ void *LpelStreamRead(     lpel_stream_desc_t *sd);
 void  LpelStreamWrite(    lpel_stream_desc_t *sd, void *item);
 int   LpelStreamTryWrite( lpel_stream_desc_t *sd, void *item);
 
+/** non-blocking read, returns NULL if the stream is empty */
+void *LpelStreamTryRead(  lpel_stream_desc_t *sd);
+/** read waiting at most usec microseconds, returns NULL on timeout */
+void *LpelStreamReadTimeout( lpel_stream_desc_t *sd, unsigned long usec);
+
+/** value streams: records of elemsize bytes are stored in the stream
+ * itself, copied in by LpelStreamWriteValue and out by LpelStreamReadValue,
+ * without an allocation per record. LpelStreamPeek returns the address of
+ * the next value; the pointer reads must not be used on value streams */
+lpel_stream_t *LpelStreamCreateValue( int size, int elemsize);
+void  LpelStreamWriteValue( lpel_stream_desc_t *sd, const void *val);
+void  LpelStreamReadValue(  lpel_stream_desc_t *sd, void *val);
+
 lpel_stream_t *LpelStreamGet(lpel_stream_desc_t *sd);
 int LpelStreamGetId(lpel_stream_desc_t *sd);
 
@@ -255,6 +349,9 @@ int LpelStreamGetId(lpel_stream_desc_t *sd);
 /** stream set functions*/
 
 lpel_stream_desc_t *LpelStreamPoll(    lpel_streamset_t *set);
+/** poll waiting at most usec microseconds, returns NULL on timeout */
+lpel_stream_desc_t *LpelStreamPollTimeout( lpel_streamset_t *set,
+    unsigned long usec);
 
 
 
@@ -282,13 +379,23 @@ void LpelStreamIterRemove(  lpel_stream_iter_t *iter);
 
 /**
  * Binary Semaphores
+ *
+ * Waiting tasks are blocked on a FIFO queue, so that their worker can
+ * execute other tasks; a signal hands the semaphore over to the first waiter.
  */
 typedef struct {
   volatile int counter;
-  unsigned char padding[64-sizeof(int)];
+  volatile int lock;            /* protects the waiter queue */
+  lpel_task_t *head, *tail;     /* waiter queue */
+  unsigned char padding[64-2*sizeof(int)-2*sizeof(lpel_task_t *)];
 } lpel_bisema_t;
 
 
+/** Set the number of cycles a task spins on a non-signalled semaphore
+ * before it is blocked (default 0) */
+void LpelBiSemaSetSpin(unsigned long cycles);
+
+
 /** Initialize a binary semaphore. It is signalled by default. */
 void LpelBiSemaInit(lpel_bisema_t *sem);
 
@@ -301,4 +408,45 @@ void LpelBiSemaWait(lpel_bisema_t *sem);
 /** Signal the semaphore, possibly releasing a waiting task. */
 void LpelBiSemaSignal(lpel_bisema_t *sem);
 
+
+/******************************************************************************/
+/*  MUTEX AND CONDITION VARIABLE FUNCTIONS                                    */
+/******************************************************************************/
+
+struct lpel_sync_waiter_t;
+
+/**
+ * Task-level mutex
+ *
+ * A task entering a busy mutex is blocked (its worker executes other tasks)
+ * and queued in FIFO order; leaving the mutex hands it over to the first
+ * waiting task directly.
+ */
+typedef struct {
+  volatile int locked;
+  volatile int lock;                        /* protects the waiter queue */
+  struct lpel_sync_waiter_t *head, *tail;   /* waiter queue */
+} lpel_mutex_t;
+
+/**
+ * Task-level condition variable, waiters are woken in FIFO order
+ */
+typedef struct {
+  volatile int lock;                        /* protects the waiter queue */
+  struct lpel_sync_waiter_t *head, *tail;   /* waiter queue */
+} lpel_cond_t;
+
+
+void LpelMutexInit(lpel_mutex_t *mx);
+void LpelMutexDestroy(lpel_mutex_t *mx);
+void LpelMutexEnter(lpel_mutex_t *mx);
+int  LpelMutexTryEnter(lpel_mutex_t *mx);
+void LpelMutexLeave(lpel_mutex_t *mx);
+
+void LpelCondInit(lpel_cond_t *cv);
+void LpelCondDestroy(lpel_cond_t *cv);
+void LpelCondWait(lpel_cond_t *cv, lpel_mutex_t *mx);
+void LpelCondSignal(lpel_cond_t *cv);
+void LpelCondBroadcast(lpel_cond_t *cv);
+
 #endif /* _LPEL_H_ */
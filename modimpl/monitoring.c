@@ -25,6 +25,7 @@ static const char end_entry = END_LOG_ENTRY;
 static const char worker_start = WORKER_START_EVENT;
 static const char worker_end = WORKER_END_EVENT;
 static const char worker_wait = WORKER_WAIT_EVENT;
+static const char task_stack = TASK_STACK_EVENT;
 
 #define MON_USREVT_BUFSIZE_DELTA 64
 #define MON_TASKNAME_MAXLEN  64
@@ -153,6 +154,7 @@ static lpel_timing_t monitoring_begin = LPEL_TIMING_INITIALIZER;
 #define FLAG_TASK(mt)  (mt->flags & LPEL_MON_TASK)
 #define FLAG_WORKER(mt)  (mt->flags & LPEL_MON_WORKER)
 #define FLAG_LOAD(mt)	(mt->flags & LPEL_MON_LOAD)
+#define FLAG_STACK(mt)	(mt->flags & LPEL_MON_STACK)
 
 /**
  * Print a time in usec
@@ -509,6 +511,22 @@ static void MonCbWorkerWaitStop(mon_worker_t *mon)
 
 
 
+/**
+ * Called before destroying a task, with stack watermarks enabled.
+ *
+ * Logs the peak stack use and the stack size of the task.
+ */
+static void MonCbTaskStack(mon_task_t *mt, unsigned long peak,
+		unsigned long size)
+{
+	assert( mt != NULL );
+	if ( mt->mw==NULL || !FLAG_STACK(mt)) return;
+
+	fprintf( mt->mw->outfile, "%c%lu %lu %lu%c",
+			task_stack, mt->tid, peak, size, end_entry);
+}
+
+
 static void MonCbTaskDestroy(mon_task_t *mt)
 {
 	assert( mt != NULL );
@@ -776,6 +794,7 @@ void LpelMonInit(lpel_monitoring_cb_t *cb, unsigned long flags)
   cb->task_assign  = MonCbTaskAssign;
   cb->task_start   = MonCbTaskStart;
   cb->task_stop    = MonCbTaskStop;
+  cb->task_stack   = MonCbTaskStack;
   cb->stream_open         = MonCbStreamOpen;
   cb->stream_close        = MonCbStreamClose;
   cb->stream_replace      = MonCbStreamReplace;
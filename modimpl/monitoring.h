@@ -10,6 +10,7 @@
 #define LPEL_MON_STREAM  	  (1<<4)
 #define LPEL_MON_MAP  	  (1<<5)
 #define LPEL_MON_LOAD	 (1<<6)
+#define LPEL_MON_STACK	 (1<<7)
 
 
 
@@ -33,6 +34,7 @@ struct mon_task_t *LpelMonTaskCreate(unsigned long tid,
 #define WORKER_START_EVENT 		'S'
 #define WORKER_WAIT_EVENT 		'W'
 #define WORKER_END_EVENT 		'E'
+#define TASK_STACK_EVENT 		'K'
 
 #define LOG_FORMAT_VERSION		"Log format version 2.2 (since 05/03/2012)"
 
@@ -0,0 +1,334 @@
+/**
+ * Waiting for file descriptors on the workers
+ *
+ * Each worker owns an epoll instance with the descriptors its tasks are
+ * waiting for, registered one-shot. The ready descriptors are collected
+ * without blocking whenever the worker dispatches; an idle worker waits in
+ * epoll_wait() instead of on its mailbox, an eventfd in the same epoll set
+ * is written by the senders of messages to wake it up.
+ *
+ * Wrappers run a single task on a thread of its own, they simply block
+ * in poll(). Without epoll, tasks poll their descriptor periodically and
+ * sleep in between.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <lpel_common.h>
+#include "lpel_main.h"
+#include "fdpoll.h"
+#include "timerwheel.h"
+
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_SYS_EVENTFD_H)
+#define FDPOLL_AVAILABLE
+#endif
+
+/* interval of the fallback polling */
+#ifndef LPEL_FDPOLL_FALLBACK_USEC
+#define LPEL_FDPOLL_FALLBACK_USEC  1000
+#endif
+
+
+#ifdef FDPOLL_AVAILABLE
+
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+/* events fetched by one epoll_wait() */
+#define FP_MAXEVENTS  64
+
+struct fdpoll_t {
+  int epfd;
+  int evfd;                       /* notification of the worker */
+  unsigned int count;             /* number of waiting tasks */
+  int nready, pos;                /* fetched events, next to pop */
+  struct epoll_event ready[FP_MAXEVENTS];
+};
+
+
+fdpoll_t *LpelFdPollCreate(void)
+{
+  fdpoll_t *fp = (fdpoll_t *) malloc(sizeof(fdpoll_t));
+  struct epoll_event ev;
+
+  fp->epfd = epoll_create(FP_MAXEVENTS);
+  fp->evfd = eventfd(0, EFD_NONBLOCK);
+  if (fp->epfd < 0 || fp->evfd < 0) goto fail;
+
+  /* data.ptr == NULL denotes the notification */
+  ev.events = EPOLLIN;
+  ev.data.ptr = NULL;
+  if (epoll_ctl(fp->epfd, EPOLL_CTL_ADD, fp->evfd, &ev) < 0) goto fail;
+
+  fp->count = 0;
+  fp->nready = fp->pos = 0;
+  return fp;
+
+fail:
+  if (fp->epfd >= 0) close(fp->epfd);
+  if (fp->evfd >= 0) close(fp->evfd);
+  free(fp);
+  return NULL;
+}
+
+/** Destroy a poller, tasks still waiting are not woken up */
+void LpelFdPollDestroy(fdpoll_t *fp)
+{
+  if (fp == NULL) return;
+  close(fp->epfd);
+  close(fp->evfd);
+  free(fp);
+}
+
+
+unsigned int LpelFdPollCount(fdpoll_t *fp)
+{
+  return fp->count;
+}
+
+int LpelFdPollNotifyFd(fdpoll_t *fp)
+{
+  return fp->evfd;
+}
+
+
+/**
+ * Register fd for the task t
+ *
+ * The waiter must stay valid until the task has been returned by
+ * LpelFdPollReady().
+ *
+ * @return 1 if added, 0 if fd does not support polling (e.g. a regular
+ *         file, which is always ready), -1 on error (errno is set)
+ */
+int LpelFdPollAdd(fdpoll_t *fp, lpel_fdwait_t *w, lpel_task_t *t,
+    int fd, int events)
+{
+  struct epoll_event ev;
+  int res;
+
+  ev.events = EPOLLONESHOT;
+  if (events & LPEL_FD_READ)  ev.events |= EPOLLIN;
+  if (events & LPEL_FD_WRITE) ev.events |= EPOLLOUT;
+  ev.data.ptr = w;
+
+  w->task = t;
+  w->fd = fd;
+  w->events = events;
+  w->dupfd = 0;
+  w->revents = 0;
+
+  res = epoll_ctl(fp->epfd, EPOLL_CTL_ADD, fd, &ev);
+  if (res < 0 && errno == EEXIST) {
+    /* another task waits for the same descriptor,
+     * epoll tells apart the duplicate */
+    w->fd = dup(fd);
+    if (w->fd < 0) return -1;
+    w->dupfd = 1;
+    res = epoll_ctl(fp->epfd, EPOLL_CTL_ADD, w->fd, &ev);
+  }
+  if (res < 0) {
+    if (w->dupfd) {
+      int err = errno;
+      close(w->fd);
+      errno = err;
+    }
+    return (errno == EPERM) ? 0 : -1;
+  }
+  fp->count++;
+  return 1;
+}
+
+
+/**
+ * Fetch ready events
+ *
+ * @param timeout  in milliseconds, -1 for none
+ */
+static void Fetch(fdpoll_t *fp, int timeout)
+{
+  int n = epoll_wait(fp->epfd, fp->ready, FP_MAXEVENTS, timeout);
+
+  /* interrupted, e.g. by the time slice signal */
+  fp->nready = (n < 0) ? 0 : n;
+  fp->pos = 0;
+}
+
+
+/**
+ * Return the task of the next ready descriptor
+ *
+ * Has to be called by the owning worker, repeatedly until NULL is returned.
+ */
+lpel_task_t *LpelFdPollReady(fdpoll_t *fp)
+{
+  struct epoll_event *ev;
+  lpel_fdwait_t *w;
+
+  while (1) {
+    if (fp->pos == fp->nready) {
+      /* cheap check, there are no waiting tasks most of the time */
+      if (fp->count == 0) return NULL;
+      Fetch(fp, 0);
+      if (fp->nready == 0) return NULL;
+    }
+    ev = &fp->ready[fp->pos++];
+    w = (lpel_fdwait_t *) ev->data.ptr;
+
+    if (w == NULL) {
+      /* notification, reset the eventfd */
+      uint64_t val;
+      (void) read(fp->evfd, &val, sizeof(val));
+      continue;
+    }
+
+    (void) epoll_ctl(fp->epfd, EPOLL_CTL_DEL, w->fd, NULL);
+    if (w->dupfd) close(w->fd);
+    fp->count--;
+
+    if (ev->events & EPOLLIN)  w->revents |= LPEL_FD_READ;
+    if (ev->events & EPOLLOUT) w->revents |= LPEL_FD_WRITE;
+    /* let the subsequent call report the error */
+    if (ev->events & (EPOLLERR | EPOLLHUP)) {
+      w->revents |= w->events;
+    }
+    /* the waiter must not be accessed after waking up the task */
+    return w->task;
+  }
+}
+
+
+/**
+ * Block the worker until a descriptor is ready, the notify descriptor has
+ * been written, or the deadline has passed
+ */
+void LpelFdPollWait(fdpoll_t *fp, const struct timespec *deadline)
+{
+  int timeout = -1;
+
+  /* there are fetched events not popped yet */
+  if (fp->pos < fp->nready) return;
+
+  if (deadline != NULL) {
+    struct timespec now;
+    long long ms;
+    LpelTimerNow(&now);
+    ms = (long long) (deadline->tv_sec - now.tv_sec) * 1000
+      + (deadline->tv_nsec - now.tv_nsec + 999999) / 1000000;
+    timeout = (ms < 0) ? 0 : (int) ms;
+  }
+  Fetch(fp, timeout);
+}
+
+#else /* FDPOLL_AVAILABLE */
+
+fdpoll_t *LpelFdPollCreate(void) { return NULL; }
+void LpelFdPollDestroy(fdpoll_t *fp) { (void) fp; }
+unsigned int LpelFdPollCount(fdpoll_t *fp) { (void) fp; return 0; }
+int LpelFdPollNotifyFd(fdpoll_t *fp) { (void) fp; return -1; }
+
+int LpelFdPollAdd(fdpoll_t *fp, lpel_fdwait_t *w, lpel_task_t *t,
+    int fd, int events)
+{
+  (void) fp; (void) w; (void) t; (void) fd; (void) events;
+  errno = ENOSYS;
+  return -1;
+}
+
+lpel_task_t *LpelFdPollReady(fdpoll_t *fp) { (void) fp; return NULL; }
+
+void LpelFdPollWait(fdpoll_t *fp, const struct timespec *deadline)
+{
+  (void) fp; (void) deadline;
+}
+
+#endif /* FDPOLL_AVAILABLE */
+
+
+/******************************************************************************/
+/*  TASK FUNCTIONS                                                            */
+/******************************************************************************/
+
+/**
+ * Poll fd with poll()
+ *
+ * @param timeout  in milliseconds, -1 for none
+ * @return the ready events, 0 on timeout, -1 on error
+ */
+static int PollOnce(int fd, int events, int timeout)
+{
+  struct pollfd pfd;
+  int res, revents = 0;
+
+  pfd.fd = fd;
+  pfd.events = 0;
+  if (events & LPEL_FD_READ)  pfd.events |= POLLIN;
+  if (events & LPEL_FD_WRITE) pfd.events |= POLLOUT;
+
+  do {
+    res = poll(&pfd, 1, timeout);
+  } while (res < 0 && errno == EINTR);
+  if (res <= 0) return res;
+
+  if (pfd.revents & POLLNVAL) {
+    errno = EBADF;
+    return -1;
+  }
+  if (pfd.revents & POLLIN)  revents |= LPEL_FD_READ;
+  if (pfd.revents & POLLOUT) revents |= LPEL_FD_WRITE;
+  if (pfd.revents & (POLLERR | POLLHUP)) revents |= events;
+  return revents;
+}
+
+
+/**
+ * Suspend the current task until fd is ready for reading and/or writing
+ *
+ * The worker executes other tasks meanwhile, so a task doing I/O does not
+ * need a wrapper of its own. Descriptors which cannot be polled, like
+ * regular files, are always ready. An error or hangup on fd is reported
+ * as all requested events, the subsequent I/O call yields the condition.
+ *
+ * @param fd      file descriptor
+ * @param events  LPEL_FD_READ and/or LPEL_FD_WRITE
+ * @return the ready events, -1 on error (errno is set)
+ *
+ * @pre This call must be made from within a LPEL task!
+ */
+int LpelTaskWaitFd(int fd, int events)
+{
+  lpel_fdwait_t *w;
+  lpel_task_t *t = LpelTaskSelf();
+  fdpoll_t *fp = LpelWorkerFdPoll();
+  int res;
+
+  assert(t != NULL);
+  assert((events & (LPEL_FD_READ | LPEL_FD_WRITE)) != 0);
+
+  if (fp == NULL) {
+#ifdef FDPOLL_AVAILABLE
+    /* only wrappers have no poller, they own their thread and may block */
+    return PollOnce(fd, events, -1);
+#else
+    while ((res = PollOnce(fd, events, 0)) == 0) {
+      LpelTaskSleep(LPEL_FDPOLL_FALLBACK_USEC);
+    }
+    return res;
+#endif
+  }
+
+  /* the waiter lives in the TCB of the blocked task */
+  w = (lpel_fdwait_t *) LpelTaskWaitRecord(t);
+  assert(sizeof(*w) <= LPEL_TASK_WAITREC_SIZE);
+  res = LpelFdPollAdd(fp, w, t, fd, events);
+  if (res <= 0) return (res == 0) ? events : -1;
+
+  LpelTaskBlock(t);
+  return w->revents;
+}
@@ -45,4 +45,33 @@ typedef int bool;
 #endif
 
 
+/*
+ * Busy waiting, for all of the above:
+ * atomic_cpu_relax - custom: pause in a spin loop
+ * atomic_spin_lock - custom: test-and-test-and-set lock on an int flag
+ * atomic_spin_unlock - custom
+ */
+
+static inline void atomic_cpu_relax(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  __asm__ __volatile__ ("pause" ::: "memory");
+#else
+  __sync_synchronize();
+#endif
+}
+
+static inline void atomic_spin_lock(volatile int *lock)
+{
+  while (__sync_lock_test_and_set(lock, 1)) {
+    while (*lock) atomic_cpu_relax();
+  }
+}
+
+static inline void atomic_spin_unlock(volatile int *lock)
+{
+  __sync_lock_release(lock);
+}
+
+
 #endif /* _ATOMIC_H_ */
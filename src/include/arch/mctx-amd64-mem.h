@@ -1,4 +1,4 @@
-
+#include <stddef.h>
 
 
 typedef struct {
@@ -15,7 +15,9 @@ static inline int mctx_create(mctx_t *mctx, void *func, void *arg, char *sk_addr
 {
   mctx->sk_addr = sk_addr + sk_size;
   mctx->sk_size = sk_size;
-  ctx_init_internal(mctx->regs, sk_addr+sk_size, func, arg);
+  /* the first switch writes the entry address at the stack pointer,
+   * keep it within the stack; 16 bytes to preserve the alignment */
+  ctx_init_internal(mctx->regs, sk_addr+sk_size-16, func, arg);
   return 0;
 }
 
@@ -24,3 +26,11 @@ static inline void mctx_switch(mctx_t *octx, mctx_t *nctx)
   ctx_swap_internal(octx->regs, nctx->regs);
 }
 
+#define MCTX_HAVE_SP
+
+/* lowest stack address in use by a context that has been switched from */
+static inline char *mctx_sp(mctx_t *mctx)
+{
+  return (char *) mctx->regs[0];
+}
+
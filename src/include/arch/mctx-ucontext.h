@@ -1,16 +1,21 @@
 
 
+#include <stddef.h>
 #include <ucontext.h>
 
+
+#ifdef USE_MCTX_UCONTEXT_SIGMASK
+
+/*
+ * swapcontext() saves and restores the signal mask on every switch,
+ * i.e. there is a system call per switch
+ */
+
 typedef ucontext_t mctx_t;
 
 
 static inline int mctx_create(mctx_t *mctx, void *func, void *arg, char *sk_addr, long sk_size)
 {
-
-  //unsigned int x,y;
-  //unsigned long z;
-
   if (getcontext(mctx))
     return -1;
 
@@ -20,21 +25,6 @@ static inline int mctx_create(mctx_t *mctx, void *func, void *arg, char *sk_addr
   mctx->uc_stack.ss_size = sk_size - 2*sizeof(long);
   mctx->uc_stack.ss_flags = 0;
 
-  /*
-   * From libtask, by Ross Cox:
-   *
-   * All this magic is because you have to pass makecontext a
-   * function that takes some number of word-sized variables,
-   * and on 64-bit machines pointers are bigger than words.
-   */
-#if 0
-  z = (unsigned long) arg;
-  y = z;
-  z >>= 16;
-  x = z >>16;
-  makecontext(mctx, func, 2, y, x);
-#endif
-
   makecontext(mctx, func, 2, arg);
   return 0;
 }
@@ -44,3 +34,83 @@ static inline void mctx_switch(mctx_t *octx, mctx_t *nctx)
   (void) swapcontext(octx, nctx);
 }
 
+#else /* USE_MCTX_UCONTEXT_SIGMASK */
+
+/*
+ * The context is set up portably with makecontext() and entered once
+ * at creation, where it saves itself with __builtin_setjmp() and returns.
+ * Switches are __builtin_setjmp()/__builtin_longjmp() pairs: the compiler
+ * saves the live registers around the setjmp, the buffer holds only the
+ * frame pointer, stack pointer and resume address. The signal mask is
+ * not touched, it is the mask of the thread running the context.
+ */
+
+typedef struct {
+  void *jb[5];
+  void (*func)(void *);
+  void *arg;
+} mctx_t;
+
+
+/* the callers of a function resuming through a longjmp must not rely on
+ * the registers it leaves untouched otherwise (-fipa-ra) */
+#if defined(__GNUC__) && __GNUC__ >= 8 && !defined(__clang__)
+#define MCTX_NOIPA  __attribute__((noipa))
+#else
+#define MCTX_NOIPA  __attribute__((noinline))
+#endif
+
+/* a function calling __builtin_setjmp must not call __builtin_longjmp */
+static void __attribute__((noinline, noreturn, unused)) mctx_jump(void **jb)
+{
+  __builtin_longjmp(jb, 1);
+}
+
+/*
+ * makecontext() passes int arguments only, the mctx pointer is split
+ * (from libtask, by Russ Cox)
+ */
+static void __attribute__((noinline, unused)) mctx_entry(unsigned int lo, unsigned int hi)
+{
+  unsigned long p = ((unsigned long) hi << 16 << 16) | lo;
+  mctx_t *mctx = (mctx_t *) p;
+  void **ret = mctx->jb[0];
+
+  if (__builtin_setjmp(mctx->jb) == 0) mctx_jump(ret);
+  mctx->func(mctx->arg);
+  /* never returns */
+}
+
+static MCTX_NOIPA __attribute__((unused))
+int mctx_create(mctx_t *mctx, void *func, void *arg, char *sk_addr, long sk_size)
+{
+  ucontext_t uc;
+  void *ret[5];
+  unsigned long p = (unsigned long) mctx;
+
+  if (getcontext(&uc))
+    return -1;
+
+  uc.uc_link = NULL;
+  uc.uc_stack.ss_sp = sk_addr;
+  uc.uc_stack.ss_size = sk_size - 2*sizeof(long);
+  uc.uc_stack.ss_flags = 0;
+
+  makecontext(&uc, (void (*)(void)) mctx_entry, 2,
+      (unsigned int) p, (unsigned int) (p >> 16 >> 16));
+
+  mctx->func = (void (*)(void *)) func;
+  mctx->arg = arg;
+  /* passes the return buffer, overwritten by the entry */
+  mctx->jb[0] = ret;
+  if (__builtin_setjmp(ret) == 0) (void) setcontext(&uc);
+  return 0;
+}
+
+static MCTX_NOIPA __attribute__((unused))
+void mctx_switch(mctx_t *octx, mctx_t *nctx)
+{
+  if (__builtin_setjmp(octx->jb) == 0) mctx_jump(nctx->jb);
+}
+
+#endif /* USE_MCTX_UCONTEXT_SIGMASK */
@@ -9,7 +9,10 @@ void ctx_swap_internal(void**, void**);
 
 static inline int mctx_create(mctx_t *mctx, void *func, void *arg, char *sk_addr, long sk_size)
 {
-  ctx_init_internal(mctx, sk_addr+sk_size, func, arg);
+  /* ctx_init_internal writes the entry address (amd64) or the argument
+   * (i386) at the stack pointer it is given, keep that word within the
+   * stack; 16 bytes to preserve the stack alignment */
+  ctx_init_internal(mctx, sk_addr+sk_size-16, func, arg);
   return 0;
 }
 
@@ -18,4 +21,38 @@ static inline void mctx_switch(mctx_t *octx, mctx_t *nctx)
   ctx_swap_internal(octx, nctx);
 }
 
+/* the context is the stack pointer saved by the switch, the registers
+ * (and FP control state) are on the stack above it */
+#define MCTX_HAVE_SP
 
+/* lowest stack address in use by a context that has been switched from */
+static inline char *mctx_sp(mctx_t *mctx)
+{
+  return (char *) *mctx;
+}
+
+
+#ifdef __x86_64__
+
+#define MCTX_HAVE_FP
+
+void ctx_swap_fp_internal(void**, void**, int);
+
+/* the FP control state is kept below the registers on the stack,
+ * a new context starts with the default one */
+static inline void mctx_init_fp(mctx_t *mctx)
+{
+  unsigned int *fp = (unsigned int *) ((char *) *mctx - 8);
+
+  fp[0] = 0x1f80;       /* MXCSR */
+  fp[1] = 0x037f;       /* x87 control word */
+  *mctx = fp;
+}
+
+static inline void mctx_switch_fp(mctx_t *octx, mctx_t *nctx, int flags)
+{
+  if (flags == 0) ctx_swap_internal(octx, nctx);
+  else ctx_swap_fp_internal(octx, nctx, flags);
+}
+
+#endif /* __x86_64__ */
@@ -6,6 +6,16 @@
 //#define USE_MCTX_PCL
 //#define USE_MCTX_SETJMP
 
+/*
+ * Flags of mctx_switch_fp(), for contexts keeping their floating-point
+ * control state (MXCSR, x87 control word) across switches; the other
+ * contexts run with the default state. A context switched to with
+ * MCTX_FP_NEW must have been switched from with MCTX_FP_OLD before, or
+ * be new and prepared with mctx_init_fp().
+ */
+#define MCTX_FP_OLD  1      /* save the state of octx */
+#define MCTX_FP_NEW  2      /* restore the state of nctx */
+
 #ifdef USE_MCTX_PCL
 
 #include "mctx-pcl.h"
@@ -15,7 +25,11 @@
 
 #include "mctx-setjmp.h"
 
-#elif defined(USE_MCTX_X86) || defined(USE_MCTX_X86_64) || defined(USE_MCTX_X86_64_MEM)
+#elif defined(USE_MCTX_X86_64_MEM)
+
+#include "mctx-amd64-mem.h"
+
+#elif defined(USE_MCTX_X86) || defined(USE_MCTX_X86_64)
 
 #include "mctx-x86.h"
 
@@ -29,4 +43,46 @@
 
 #endif
 
+
+#ifndef MCTX_HAVE_FP
+
+/*
+ * Generic version: the state is saved on the stack of the old context
+ * and restored when it is switched back to
+ */
+
+static inline void mctx_init_fp(mctx_t *mctx)
+{
+  (void) mctx;
+}
+
+static inline void mctx_switch_fp(mctx_t *octx, mctx_t *nctx, int flags)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  unsigned int mxcsr, def_mxcsr = 0x1f80;
+  unsigned short cw, def_cw = 0x037f;
+
+  if (flags & MCTX_FP_OLD) {
+#ifdef __SSE__
+    __asm__ __volatile__ ("stmxcsr %0" : "=m" (mxcsr));
+    __asm__ __volatile__ ("ldmxcsr %0" : : "m" (def_mxcsr));
+#endif
+    __asm__ __volatile__ ("fnstcw %0" : "=m" (cw));
+    __asm__ __volatile__ ("fldcw %0" : : "m" (def_cw));
+  }
+  mctx_switch(octx, nctx);
+  if (flags & MCTX_FP_OLD) {
+#ifdef __SSE__
+    __asm__ __volatile__ ("ldmxcsr %0" : : "m" (mxcsr));
+#endif
+    __asm__ __volatile__ ("fldcw %0" : : "m" (cw));
+  }
+#else
+  (void) flags;
+  mctx_switch(octx, nctx);
+#endif
+}
+
+#endif /* MCTX_HAVE_FP */
+
 #endif /* _MCTX_H_ */
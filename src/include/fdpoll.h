@@ -0,0 +1,55 @@
+#ifndef _FDPOLL_H_
+#define _FDPOLL_H_
+
+/*
+ * Per-worker file descriptor poller
+ *
+ * Tasks waiting in LpelTaskWaitFd() register their descriptor with the
+ * poller of their worker and block. The worker collects the ready
+ * descriptors whenever it dispatches, and waits on the poller instead of
+ * its mailbox when it is idle; a message arriving meanwhile is signalled
+ * through the notify descriptor (see LpelMailboxArmNotify()).
+ * Only the owning worker thread may use a poller.
+ */
+
+#include <time.h>
+#include <lpel_common.h>
+
+
+typedef struct fdpoll_t fdpoll_t;
+
+typedef struct lpel_fdwait_t {
+  lpel_task_t *task;            /* task to wake up */
+  int fd;                       /* registered descriptor */
+  int events;                   /* LPEL_FD_* events waited for */
+  int dupfd;                    /* fd was registered already, dup'ed */
+  int revents;                  /* LPEL_FD_* events on wakeup */
+} lpel_fdwait_t;
+
+
+/* returns NULL if polling is not supported */
+fdpoll_t *LpelFdPollCreate(void);
+void LpelFdPollDestroy(fdpoll_t *fp);
+
+/* number of waiting tasks */
+unsigned int LpelFdPollCount(fdpoll_t *fp);
+
+/* descriptor to be written when the worker has to wake up */
+int  LpelFdPollNotifyFd(fdpoll_t *fp);
+
+/* returns 1 if added, 0 if fd cannot be polled (always ready), -1 on error */
+int  LpelFdPollAdd(fdpoll_t *fp, lpel_fdwait_t *w, lpel_task_t *t,
+    int fd, int events);
+
+/* pop the task of the next ready descriptor, NULL if there is none */
+lpel_task_t *LpelFdPollReady(fdpoll_t *fp);
+
+/* wait for ready descriptors or a notification until the deadline
+ * of the monotonic clock, NULL = no timeout */
+void LpelFdPollWait(fdpoll_t *fp, const struct timespec *deadline);
+
+/* the poller of the calling worker, NULL for wrappers,
+ * implemented by the scheduler */
+fdpoll_t *LpelWorkerFdPoll(void);
+
+#endif /* _FDPOLL_H_ */
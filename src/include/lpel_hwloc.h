@@ -16,5 +16,7 @@ void LpelHwLocInit(lpel_config_t *cfg);
 int LpelHwLocCheckConfig(lpel_config_t *cfg);
 void LpelHwLocStart(lpel_config_t *cfg);
 int LpelThreadAssign(int core);
+int LpelHwLocCloseness(int core_a, int core_b);
+int LpelHwLocSocket(int core);
 void LpelHwLocCleanup(void);
 #endif
@@ -10,6 +10,10 @@ struct lpel_stream_desc_t {
   char mode;                  /** either 'r' or 'w' */
   struct lpel_stream_desc_t *next; /** for organizing in stream sets */
   struct mon_stream_t *mon;   /** monitoring object */
+  int held;                   /** values reserved by the writer resp. acquired
+                                  by the reader of a value stream */
+  int is_mcast;               /** opened on a multicast stream */
+  int reader;                 /** index of the reader of a multicast stream */
 };
 
 //#define STREAM_POLL_SPINLOCK
@@ -41,5 +45,18 @@ void LpelWorkersCleanup( void);
 void LpelWorkersSpawn(void);
 void LpelWorkersTerminate(void);
 
+/* implemented by the scheduler, for the synchronisation primitives:
+ * block the calling task t until LpelTaskWakeup(t) is called;
+ * a wakeup issued before t actually blocked must not get lost
+ */
+void LpelTaskBlock(lpel_task_t *t);
+void LpelTaskWakeup(lpel_task_t *t);
+
+/* space in the TCB for the record (timer, queue node, ...) a blocking call
+ * shares with the waker of the task; valid until the call returns.
+ * Unlike the stack, it stays in place while the task is suspended. */
+#define LPEL_TASK_WAITREC_SIZE  64
+void *LpelTaskWaitRecord(lpel_task_t *t);
+
 
 #endif /* _LPELMAIN_H */
@@ -1,6 +1,7 @@
 #ifndef _MAILBOX_H_
 #define _MAILBOX_H_
 
+#include <time.h>
 #include "workermsg.h"
 
 typedef struct mailbox_t mailbox_t;
@@ -9,7 +10,17 @@ mailbox_t *LpelMailboxCreate(void);
 void LpelMailboxDestroy(mailbox_t *mbox);
 void LpelMailboxSend(mailbox_t *mbox, workermsg_t *msg);
 void LpelMailboxRecv(mailbox_t *mbox, workermsg_t *msg);
+/* abstime refers to LPEL_TIMER_CLOCK, returns 0 on timeout */
+int  LpelMailboxRecvTimed(mailbox_t *mbox, workermsg_t *msg,
+    const struct timespec *abstime);
 int  LpelMailboxHasIncoming(mailbox_t *mbox);
+/* number of messages in the inbox, peak gets the highest number so far */
+int  LpelMailboxDepth(mailbox_t *mbox, int *peak);
+/* for receivers waiting on descriptors as well: returns 0 if there is an
+ * incoming message, otherwise notify_fd (an eventfd) is written on the next
+ * arrival until LpelMailboxDisarmNotify() and 1 is returned */
+int  LpelMailboxArmNotify(mailbox_t *mbox, int notify_fd);
+void LpelMailboxDisarmNotify(mailbox_t *mbox);
 
 
 #endif /* _MAILBOX_H_ */
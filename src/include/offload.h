@@ -0,0 +1,16 @@
+#ifndef _OFFLOAD_H_
+#define _OFFLOAD_H_
+
+/*
+ * Helper threads for blocking calls
+ *
+ * LpelTaskOffload() queues a call for a bounded pool of helper threads and
+ * suspends the calling task; the helper wakes the task up on completion.
+ * Helpers are started on demand, pinned like wrappers, and stay idle
+ * until LpelCleanup().
+ */
+
+/* wait for the helper threads to finish, after the workers have finished */
+void LpelOffloadCleanup(void);
+
+#endif /* _OFFLOAD_H_ */
@@ -0,0 +1,28 @@
+#ifndef _STACKMARK_H_
+#define _STACKMARK_H_
+
+/*
+ * Stack high-water marks
+ *
+ * Built with USE_STACK_WATERMARK (configure --enable-stack-watermark),
+ * the stack of a task is painted when the task is created. When it is
+ * destroyed, the lowest overwritten word gives the peak use, which is
+ * reported to the task_stack monitoring callback and collected in the
+ * histogram of LpelTaskStackHistogram().
+ */
+
+#include <stddef.h>
+#include <lpel_common.h>
+
+
+/* fill the stack with the canary pattern */
+void LpelStackPaint(char *stack, size_t size);
+
+/* bytes from the top of the stack down to the lowest overwritten word */
+size_t LpelStackPeak(const char *stack, size_t size);
+
+/* add the peak use of a stack of the given size to the histogram,
+ * and report it to the monitoring object mt, if any */
+void LpelStackRecord(mon_task_t *mt, size_t peak, size_t size);
+
+#endif /* _STACKMARK_H_ */
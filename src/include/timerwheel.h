@@ -0,0 +1,61 @@
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+/*
+ * Per-worker hierarchical timer wheel
+ *
+ * Each worker (and wrapper) owns a wheel holding the timers of the tasks
+ * that went to sleep on it. Timers are added and expired by the owning
+ * worker thread; any thread may cancel a pending timer.
+ * Deadlines are absolute times of the monotonic clock (LpelTimerNow).
+ */
+
+#include <time.h>
+#include <lpel_common.h>
+
+
+#ifdef CLOCK_MONOTONIC
+#define LPEL_TIMER_CLOCK  CLOCK_MONOTONIC
+#else
+#define LPEL_TIMER_CLOCK  CLOCK_REALTIME
+#endif
+
+
+typedef struct timerwheel_t timerwheel_t;
+
+typedef struct lpel_timer_t {
+  struct lpel_timer_t *next, **pprev;
+  timerwheel_t *wheel;          /* wheel the timer is pending on, or NULL */
+  unsigned long long expire;    /* absolute expiry, in ticks */
+  lpel_task_t *task;            /* task to wake up */
+  int (*claim)(lpel_task_t *);  /* optional, the task is only woken up
+                                   if it returns != 0 */
+} lpel_timer_t;
+
+
+timerwheel_t *LpelTimerWheelCreate(void);
+void LpelTimerWheelDestroy(timerwheel_t *tw);
+
+/* current time of the monotonic clock the deadlines refer to */
+void LpelTimerNow(struct timespec *ts);
+
+/* deadline usec microseconds from now */
+void LpelTimerDeadline(struct timespec *deadline, unsigned long usec);
+
+/* returns 0 without adding the timer if the deadline has passed already */
+int  LpelTimerWheelAdd(timerwheel_t *tw, lpel_timer_t *tm, lpel_task_t *t,
+    int (*claim)(lpel_task_t *), const struct timespec *deadline);
+
+/* returns 1 if the timer was still pending, 0 if it has expired already */
+int  LpelTimerWheelCancel(lpel_timer_t *tm);
+
+/* pop the task of the next expired timer, NULL if there is none */
+lpel_task_t *LpelTimerWheelExpire(timerwheel_t *tw);
+
+/* earliest time the wheel needs to be expired, 0 if there are no timers */
+int  LpelTimerWheelNext(timerwheel_t *tw, struct timespec *deadline);
+
+/* the timer wheel of the calling worker/wrapper, implemented by the scheduler */
+timerwheel_t *LpelWorkerTimerWheel(void);
+
+#endif /* _TIMERWHEEL_H_ */
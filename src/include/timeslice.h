@@ -0,0 +1,23 @@
+#ifndef _TIMESLICE_H_
+#define _TIMESLICE_H_
+
+/*
+ * Timer driven preemption hints
+ *
+ * Each worker thread owns a periodic timer on its own thread CPU clock.
+ * If a task is still running after a full slice, the timer signal sets a
+ * flag, which is polled by LpelTaskShouldYield() and the stream operations.
+ * Idle workers do not consume CPU time, hence their timer does not fire.
+ */
+
+void LpelTimesliceInit(void);
+void LpelTimesliceCleanup(void);
+
+/* to be called by a worker thread at start and before exit */
+void LpelTimesliceThreadStart(void);
+void LpelTimesliceThreadStop(void);
+
+/* to be called whenever a task is dispatched on the current thread */
+void LpelTimesliceDispatch(void);
+
+#endif /* _TIMESLICE_H_ */
@@ -271,6 +271,42 @@ int LpelThreadAssign(int core)
   return 0;
 }
 
+/*
+ * Topological closeness of the processors two threads are assigned to
+ * by LpelThreadAssign(): 2 = same core, 1 = same socket, 0 = unknown/other
+ */
+int LpelHwLocCloseness(int core_a, int core_b)
+{
+  if (core_a < 0 || core_b < 0) return 0;
+#ifdef HAVE_HWLOC
+  if (core_a >= pu_count || core_b >= pu_count) return 0;
+  if (hw_places[core_a].socket != hw_places[core_b].socket) return 0;
+  if (hw_places[core_a].core != hw_places[core_b].core) return 1;
+  return 2;
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP)
+  /* only pinned threads have a fixed core */
+  if ( LPEL_ICFG(LPEL_FLAG_PINNED) && proc_workers > 0 &&
+      core_a % proc_workers == core_b % proc_workers) return 2;
+  return 0;
+#else
+  return 0;
+#endif
+}
+
+/*
+ * Socket of the processor a thread is assigned to by LpelThreadAssign(),
+ * -1 if unknown
+ */
+int LpelHwLocSocket(int core)
+{
+#ifdef HAVE_HWLOC
+  if (core < 0 || core >= pu_count) return -1;
+  return hw_places[core].socket;
+#else
+  return -1;
+#endif
+}
+
 void LpelHwLocCleanup(void)
 {
 #ifdef HAVE_HWLOC
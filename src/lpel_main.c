@@ -19,6 +19,8 @@
 #include "lpel_hwloc.h"
 #include "lpelcfg.h"
 #include "lpel_main.h"
+#include "timeslice.h"
+#include "offload.h"
 
 
 /**
@@ -90,6 +92,9 @@ int LpelStart(lpel_config_t *cfg)
   /* initialise workers */
   LpelWorkersInit( _lpel_global_config.num_workers);
 
+  /* install the handler for preemption hints, if enabled */
+  LpelTimesliceInit();
+
   LpelWorkersSpawn();
 
   return 0;
@@ -112,6 +117,11 @@ void LpelCleanup(void)
   /* Cleanup workers */
   LpelWorkersCleanup();
 
+  /* no task is left to offload calls */
+  LpelOffloadCleanup();
+
+  LpelTimesliceCleanup();
+
   /* Cleanup hardware info */
   LpelHwLocCleanup();
 
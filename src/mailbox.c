@@ -1,8 +1,11 @@
 
 #include <stdlib.h>
+#include <stdint.h>
 #include <pthread.h>
+#include <unistd.h>
 #include <assert.h>
 #include "mailbox.h"
+#include "timerwheel.h"
 
 
 /* mailbox structures */
@@ -18,6 +21,9 @@ struct mailbox_t {
   pthread_cond_t   notempty;
   mailbox_node_t  *list_free;
   mailbox_node_t  *list_inbox;
+  int              notify_fd;   /* armed by the receiver, or -1 */
+  int              depth;       /* messages in the inbox */
+  int              depth_peak;
 };
 
 
@@ -65,12 +71,21 @@ static void PutFree( mailbox_t *mbox, mailbox_node_t *node)
 mailbox_t *LpelMailboxCreate(void)
 {
   mailbox_t *mbox = (mailbox_t *)malloc(sizeof(mailbox_t));
+  pthread_condattr_t attr;
+
+  /* timed waits refer to the clock of the timer wheel */
+  pthread_condattr_init( &attr);
+  (void) pthread_condattr_setclock( &attr, LPEL_TIMER_CLOCK);
 
   pthread_mutex_init( &mbox->lock_free,  NULL);
   pthread_mutex_init( &mbox->lock_inbox, NULL);
-  pthread_cond_init(  &mbox->notempty,   NULL);
+  pthread_cond_init(  &mbox->notempty,   &attr);
+  pthread_condattr_destroy( &attr);
   mbox->list_free  = NULL;
   mbox->list_inbox = NULL;
+  mbox->notify_fd  = -1;
+  mbox->depth      = 0;
+  mbox->depth_peak = 0;
 
   return mbox;
 }
@@ -129,6 +144,11 @@ void LpelMailboxSend( mailbox_t *mbox, workermsg_t *msg)
     node->next = node; /* self-loop */
 
     pthread_cond_signal( &mbox->notempty);
+    if ( mbox->notify_fd >= 0) {
+      /* the receiver waits in a poll */
+      uint64_t one = 1;
+      (void) write( mbox->notify_fd, &one, sizeof(one));
+    }
 
   } else {
     /* insert stream between last node=list_inbox
@@ -137,20 +157,20 @@ void LpelMailboxSend( mailbox_t *mbox, workermsg_t *msg)
     mbox->list_inbox->next = node;
     mbox->list_inbox = node;
   }
+  if ( ++mbox->depth > mbox->depth_peak) mbox->depth_peak = mbox->depth;
   pthread_mutex_unlock( &mbox->lock_inbox);
 }
 
 
-void LpelMailboxRecv( mailbox_t *mbox, workermsg_t *msg)
+/**
+ * Take the first node off the inbox and copy its message
+ *
+ * @pre inbox is locked and not empty; it is unlocked on return
+ */
+static void TakeFirst( mailbox_t *mbox, workermsg_t *msg)
 {
   mailbox_node_t *node;
 
-  /* get node from inbox */
-  pthread_mutex_lock( &mbox->lock_inbox);
-  while( mbox->list_inbox == NULL) {
-      pthread_cond_wait( &mbox->notempty, &mbox->lock_inbox);
-  }
-
   assert( mbox->list_inbox != NULL);
 
   /* get first node (handle points to last) */
@@ -161,6 +181,7 @@ void LpelMailboxRecv( mailbox_t *mbox, workermsg_t *msg)
   } else {
     mbox->list_inbox->next = node->next;
   }
+  mbox->depth--;
   pthread_mutex_unlock( &mbox->lock_inbox);
 
   /* copy the message */
@@ -170,6 +191,43 @@ void LpelMailboxRecv( mailbox_t *mbox, workermsg_t *msg)
   PutFree( mbox, node);
 }
 
+
+void LpelMailboxRecv( mailbox_t *mbox, workermsg_t *msg)
+{
+  /* get node from inbox */
+  pthread_mutex_lock( &mbox->lock_inbox);
+  while( mbox->list_inbox == NULL) {
+      pthread_cond_wait( &mbox->notempty, &mbox->lock_inbox);
+  }
+
+  TakeFirst( mbox, msg);
+}
+
+
+/**
+ * Receive a message, waiting at most until abstime
+ *
+ * @return 1 if a message was received, 0 on timeout
+ */
+int LpelMailboxRecvTimed( mailbox_t *mbox, workermsg_t *msg,
+    const struct timespec *abstime)
+{
+  int res = 0;
+
+  pthread_mutex_lock( &mbox->lock_inbox);
+  while( mbox->list_inbox == NULL && res == 0) {
+      res = pthread_cond_timedwait( &mbox->notempty, &mbox->lock_inbox,
+          abstime);
+  }
+
+  if ( mbox->list_inbox == NULL) {
+    pthread_mutex_unlock( &mbox->lock_inbox);
+    return 0;
+  }
+  TakeFirst( mbox, msg);
+  return 1;
+}
+
 /**
  * @return 1 if there is an incoming msg, 0 otherwise
  * @note: does not need to be locked as a 'missed' msg
@@ -178,4 +236,42 @@ void LpelMailboxRecv( mailbox_t *mbox, workermsg_t *msg)
 int LpelMailboxHasIncoming( mailbox_t *mbox)
 {
   return ( mbox->list_inbox != NULL);
-}
\ No newline at end of file
+}
+
+/* a snapshot, without locking */
+int LpelMailboxDepth( mailbox_t *mbox, int *peak)
+{
+  if (peak != NULL) *peak = mbox->depth_peak;
+  return mbox->depth;
+}
+
+
+/**
+ * Arm a descriptor to be notified of the next incoming message
+ *
+ * For a receiver that waits on other descriptors as well, instead of
+ * blocking in LpelMailboxRecv(). Checking and arming is atomic w.r.t.
+ * the senders, so no arrival is missed.
+ *
+ * @param notify_fd  an eventfd, it is written with 1
+ * @return 1 if armed, 0 if there is an incoming message already
+ */
+int LpelMailboxArmNotify( mailbox_t *mbox, int notify_fd)
+{
+  int armed = 0;
+
+  pthread_mutex_lock( &mbox->lock_inbox);
+  if ( mbox->list_inbox == NULL) {
+    mbox->notify_fd = notify_fd;
+    armed = 1;
+  }
+  pthread_mutex_unlock( &mbox->lock_inbox);
+  return armed;
+}
+
+void LpelMailboxDisarmNotify( mailbox_t *mbox)
+{
+  pthread_mutex_lock( &mbox->lock_inbox);
+  mbox->notify_fd = -1;
+  pthread_mutex_unlock( &mbox->lock_inbox);
+}
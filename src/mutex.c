@@ -1,33 +1,205 @@
-#include <time.h>
+/**
+ * Task-level mutex and condition variable
+ *
+ * Both are implemented on top of the blocking primitives of the scheduler,
+ * LpelTaskBlock() and LpelTaskWakeup(), hence a waiting task does not
+ * occupy its worker. Waiters are kept in FIFO order; the queue nodes live
+ * in the TCBs of the blocked tasks.
+ */
 
-#include "mutex.h"
-#include "worker.h"
-#include "lpel.h"
+#include <stdlib.h>
+#include <assert.h>
+
+#include <lpel_common.h>
+#include "lpel_main.h"
+#include "arch/atomic.h"
+
+
+struct lpel_sync_waiter_t {
+  lpel_task_t *task;
+  struct lpel_sync_waiter_t *next;
+};
+
+
+static inline void QueueAppend(struct lpel_sync_waiter_t **head,
+    struct lpel_sync_waiter_t **tail, struct lpel_sync_waiter_t *w)
+{
+  w->next = NULL;
+  if (*tail) (*tail)->next = w;
+  else *head = w;
+  *tail = w;
+}
+
+static inline struct lpel_sync_waiter_t *QueuePop(
+    struct lpel_sync_waiter_t **head, struct lpel_sync_waiter_t **tail)
+{
+  struct lpel_sync_waiter_t *w = *head;
+  if (w != NULL) {
+    *head = w->next;
+    if (*head == NULL) *tail = NULL;
+  }
+  return w;
+}
+
+
+/******************************************************************************/
+/*  MUTEX                                                                     */
+/******************************************************************************/
 
 void LpelMutexInit(lpel_mutex_t *mx)
 {
-  __sync_lock_release(&mx->counter);
+  mx->head = mx->tail = NULL;
+  mx->locked = 0;
+  atomic_spin_unlock(&mx->lock);
 }
 
 void LpelMutexDestroy(lpel_mutex_t *mx)
 {
-  /*NOP*/
+  assert(mx->head == NULL);
 }
 
 
-void LpelMutexEnter(lpel_task_t *t, lpel_mutex_t *mx)
+/**
+ * Acquire the mutex, block the calling task if it is busy
+ *
+ * @pre This call must be made from within a LPEL task!
+ */
+void LpelMutexEnter(lpel_mutex_t *mx)
 {
-  while (1==__sync_lock_test_and_set(&mx->counter,1)) {
-    /* mutex is busy, schedule another thread */
-    t->state = TASK_READY;
-    LpelWorkerSelfTaskYield(t);
-    TaskStop(t);
-    LpelWorkerDispatcher(t);
-    TaskStart(t);
+  struct lpel_sync_waiter_t *self;
+  lpel_task_t *t;
+
+  if (__sync_bool_compare_and_swap(&mx->locked, 0, 1)) return;
+
+  t = LpelTaskSelf();
+  assert(t != NULL);
+  self = (struct lpel_sync_waiter_t *) LpelTaskWaitRecord(t);
+  assert(sizeof(*self) <= LPEL_TASK_WAITREC_SIZE);
+  self->task = t;
+
+  atomic_spin_lock(&mx->lock);
+  /* the mutex might have been released meanwhile */
+  if (__sync_bool_compare_and_swap(&mx->locked, 0, 1)) {
+    atomic_spin_unlock(&mx->lock);
+    return;
+  }
+  QueueAppend(&mx->head, &mx->tail, self);
+  atomic_spin_unlock(&mx->lock);
+
+  /* the mutex is handed over to us by LpelMutexLeave() */
+  LpelTaskBlock(t);
+}
+
+
+/**
+ * Try to acquire the mutex without blocking
+ *
+ * @return 1 if the mutex has been acquired, 0 otherwise
+ */
+int LpelMutexTryEnter(lpel_mutex_t *mx)
+{
+  return __sync_bool_compare_and_swap(&mx->locked, 0, 1);
+}
+
+
+/**
+ * Release the mutex; the first waiting task becomes the owner directly
+ */
+void LpelMutexLeave(lpel_mutex_t *mx)
+{
+  struct lpel_sync_waiter_t *w;
+  lpel_task_t *t = NULL;
+
+  assert(mx->locked == 1);
+
+  atomic_spin_lock(&mx->lock);
+  w = QueuePop(&mx->head, &mx->tail);
+  if (w != NULL) {
+    /* hand-off: the mutex stays locked */
+    t = w->task;
+  } else {
+    __sync_lock_release(&mx->locked);
   }
+  atomic_spin_unlock(&mx->lock);
+
+  /* the waiter node must not be accessed after this point */
+  if (t != NULL) LpelTaskWakeup(t);
+}
+
+
+/******************************************************************************/
+/*  CONDITION VARIABLE                                                        */
+/******************************************************************************/
+
+void LpelCondInit(lpel_cond_t *cv)
+{
+  cv->head = cv->tail = NULL;
+  atomic_spin_unlock(&cv->lock);
 }
 
-void LpelMutexLeave(lpel_task_t *t, lpel_mutex_t *mx)
+void LpelCondDestroy(lpel_cond_t *cv)
 {
-  __sync_lock_release(&mx->counter);
+  assert(cv->head == NULL);
+}
+
+
+/**
+ * Release the mutex, block until signalled and re-acquire the mutex
+ *
+ * @pre mx is held by the calling task
+ */
+void LpelCondWait(lpel_cond_t *cv, lpel_mutex_t *mx)
+{
+  struct lpel_sync_waiter_t *self;
+  lpel_task_t *t = LpelTaskSelf();
+
+  assert(t != NULL);
+  self = (struct lpel_sync_waiter_t *) LpelTaskWaitRecord(t);
+  self->task = t;
+
+  /* enqueue before releasing the mutex, so no signal is lost;
+   * a wakeup arriving before the task is blocked is kept by the scheduler
+   */
+  atomic_spin_lock(&cv->lock);
+  QueueAppend(&cv->head, &cv->tail, self);
+  atomic_spin_unlock(&cv->lock);
+
+  LpelMutexLeave(mx);
+  LpelTaskBlock(t);
+  /* the node has been dequeued, it is reused for the mutex */
+  LpelMutexEnter(mx);
+}
+
+
+/** Wake the task waiting longest on the condition, if any */
+void LpelCondSignal(lpel_cond_t *cv)
+{
+  struct lpel_sync_waiter_t *w;
+  lpel_task_t *t = NULL;
+
+  atomic_spin_lock(&cv->lock);
+  w = QueuePop(&cv->head, &cv->tail);
+  if (w != NULL) t = w->task;
+  atomic_spin_unlock(&cv->lock);
+
+  if (t != NULL) LpelTaskWakeup(t);
+}
+
+
+/** Wake all tasks waiting on the condition */
+void LpelCondBroadcast(lpel_cond_t *cv)
+{
+  struct lpel_sync_waiter_t *w, *next;
+
+  atomic_spin_lock(&cv->lock);
+  w = cv->head;
+  cv->head = cv->tail = NULL;
+  atomic_spin_unlock(&cv->lock);
+
+  while (w != NULL) {
+    /* read the link before the waiter can resume */
+    next = w->next;
+    LpelTaskWakeup(w->task);
+    w = next;
+  }
 }
@@ -0,0 +1,157 @@
+/**
+ * Offloading blocking calls to helper threads
+ *
+ * A task calling a blocking function would block its whole worker.
+ * Instead, the call is queued for a pool of helper threads and the task
+ * blocks; the helper wakes the task up by the usual wakeup messages when
+ * the call has returned. The number of helpers is bounded, further calls
+ * wait in the queue in FIFO order.
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include <lpel_common.h>
+#include "lpel_main.h"
+#include "lpel_hwloc.h"
+#include "offload.h"
+
+
+#ifndef LPEL_OFFLOAD_THREADS_DEFAULT
+#define LPEL_OFFLOAD_THREADS_DEFAULT  4
+#endif
+
+
+typedef struct offload_job_t {
+  struct offload_job_t *next;
+  void *(*fn)(void *);
+  void *arg;
+  void *result;
+  lpel_task_t *task;            /* task to wake up */
+} offload_job_t;
+
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  notempty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t  finished = PTHREAD_COND_INITIALIZER;
+
+static offload_job_t *head = NULL, *tail = NULL;
+
+static int max_threads = LPEL_OFFLOAD_THREADS_DEFAULT;
+static int num_threads = 0;     /* started helpers */
+static int num_idle = 0;        /* helpers waiting for a job */
+static int terminate = 0;
+
+
+/**
+ * Set the maximum number of helper threads for LpelTaskOffload().
+ * Has to be called before LpelStart().
+ */
+void LpelWorkerSetOffloadThreads(int n)
+{
+  max_threads = (n > 0) ? n : 1;
+}
+
+
+static void *HelperThread(void *arg)
+{
+  offload_job_t *job;
+  (void) arg;
+
+  (void) LpelThreadAssign(LPEL_MAP_OTHERS);
+
+  pthread_mutex_lock(&lock);
+  while (1) {
+    while (head == NULL && !terminate) {
+      num_idle++;
+      pthread_cond_wait(&notempty, &lock);
+      num_idle--;
+    }
+    if (head == NULL) break;
+
+    job = head;
+    head = job->next;
+    if (head == NULL) tail = NULL;
+    pthread_mutex_unlock(&lock);
+
+    job->result = job->fn(job->arg);
+    /* the job must not be accessed after waking up the task */
+    LpelTaskWakeup(job->task);
+
+    pthread_mutex_lock(&lock);
+  }
+  num_threads--;
+  pthread_cond_signal(&finished);
+  pthread_mutex_unlock(&lock);
+  return NULL;
+}
+
+
+/**
+ * Call fn(arg) on a helper thread
+ *
+ * The calling task is suspended until fn has returned, its worker
+ * executes other tasks meanwhile. Meant for blocking library calls
+ * (name resolution, fsync, legacy I/O); fn must not call LPEL task
+ * functions.
+ *
+ * @return  the result of fn
+ * @pre This call must be made from within a LPEL task!
+ */
+void *LpelTaskOffload(void *(*fn)(void *), void *arg)
+{
+  offload_job_t *job;
+  lpel_task_t *t = LpelTaskSelf();
+  pthread_t thread;
+
+  assert(t != NULL);
+
+  /* the job lives in the TCB of the blocked task */
+  job = (offload_job_t *) LpelTaskWaitRecord(t);
+  assert(sizeof(*job) <= LPEL_TASK_WAITREC_SIZE);
+  job->next = NULL;
+  job->fn = fn;
+  job->arg = arg;
+  job->result = NULL;
+  job->task = t;
+
+  pthread_mutex_lock(&lock);
+  assert(!terminate);
+  if (tail != NULL) tail->next = job;
+  else head = job;
+  tail = job;
+
+  if (num_idle > 0) {
+    pthread_cond_signal(&notempty);
+  } else if (num_threads < max_threads) {
+    if (0 == pthread_create(&thread, NULL, HelperThread, NULL)) {
+      (void) pthread_detach(thread);
+      num_threads++;
+    }
+  }
+  if (num_threads == 0) {
+    /* no helper could be started, block the worker as a last resort */
+    head = tail = NULL;
+    pthread_mutex_unlock(&lock);
+    return fn(arg);
+  }
+  pthread_mutex_unlock(&lock);
+
+  LpelTaskBlock(t);
+  return job->result;
+}
+
+
+void LpelOffloadCleanup(void)
+{
+  pthread_mutex_lock(&lock);
+  terminate = 1;
+  pthread_cond_broadcast(&notempty);
+  while (num_threads > 0) {
+    pthread_cond_wait(&finished, &lock);
+  }
+  /* allow for a restart */
+  terminate = 0;
+  pthread_mutex_unlock(&lock);
+}
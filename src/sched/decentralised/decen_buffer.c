@@ -14,11 +14,14 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <sched.h>
 
 
+#include "arch/atomic.h"
 #include "decen_buffer.h"
 
 
+
 /**
  * Initialize a buffer.
  *
@@ -33,6 +36,25 @@ void LpelBufferInit(buffer_t *buf, unsigned int size)
   buf->data = malloc( size*sizeof(void*) );
   /* clear all the buffer space */
   memset(buf->data, 0, size*sizeof(void *));
+  buf->elemsize = 0;
+  buf->values = NULL;
+}
+
+/**
+ * Initialize a buffer holding values instead of pointers.
+ *
+ * The values are kept in a separate array, the pointer of a full
+ * location points to its value, so that synchronisation is the same.
+ *
+ * @param buf       pointer to buffer struct
+ * @param size      number of values in the buffer
+ * @param elemsize  size of a value in bytes
+ */
+void LpelBufferInitValue(buffer_t *buf, unsigned int size, unsigned int elemsize)
+{
+  LpelBufferInit(buf, size);
+  buf->elemsize = elemsize;
+  buf->values = malloc( size*elemsize );
 }
 
 /**
@@ -44,6 +66,7 @@ void LpelBufferInit(buffer_t *buf, unsigned int size)
 void  LpelBufferCleanup(buffer_t *buf)
 {
   free(buf->data);
+  free(buf->values);
 }
 
 
@@ -78,6 +101,32 @@ void LpelBufferPop( buffer_t *buf)
 }
 
 
+/**
+ * Returns the top from a buffer with several writers, waiting for it
+ *
+ * A writer may have claimed the location and counted its item
+ * before an earlier writer has filled its location, which
+ * happens right after the claim.
+ *
+ * @pre         no concurrent reads
+ * @pre         the item has been counted
+ * @param buf   buffer to read from
+ * @return      the top item
+ */
+void *LpelBufferTopWait( buffer_t *buf)
+{
+  void *item;
+  unsigned long spins = 0;
+
+  while ((item = buf->data[buf->pread]) == NULL) {
+    /* the writer may have been preempted */
+    if (++spins % 1024 == 0) sched_yield();
+    atomic_cpu_relax();
+  }
+  return item;
+}
+
+
 /**
  * Check if there is space in the buffer
  *
@@ -125,6 +174,110 @@ void LpelBufferPut( buffer_t *buf, void *item)
 }
 
 
+/**
+ * Copy a value into the buffer
+ *
+ * The value is copied into its location before the location is
+ * marked full; the consumer copies it out before LpelBufferPop().
+ *
+ * @param buf   buffer to write to, initialized with LpelBufferInitValue
+ * @param val   value of elemsize bytes
+ * @pre         no concurrent writes
+ * @pre         there has to be space in the buffer
+ */
+void LpelBufferPutValue( buffer_t *buf, const void *val)
+{
+  char *slot = buf->values + buf->pwrite * buf->elemsize;
+
+  assert( buf->elemsize > 0 );
+  assert( LpelBufferIsSpace(buf) );
+
+  memcpy( slot, val, buf->elemsize);
+  LpelBufferPut( buf, slot);
+}
+
+
+/**
+ * Put an item into a location claimed by one of several writers
+ *
+ * The writers advance a shared write position of their own,
+ * pwrite is not used.
+ *
+ * @param buf   buffer to write to
+ * @param pos   the claimed location
+ * @param item  data item (a pointer) to write
+ * @pre         item != NULL
+ * @pre         the location is empty
+ */
+void LpelBufferPutAt( buffer_t *buf, unsigned long pos, void *item)
+{
+  assert( item != NULL );
+  assert( pos < buf->size && buf->data[pos] == NULL );
+
+  WMB();
+  buf->data[pos] = item;
+}
+
+
+/**
+ * Values from pwrite on which lie in one piece
+ *
+ * @param buf   value buffer to write to
+ * @param n     in: number of values wanted,
+ *              out: at most that many, up to the end of the array
+ * @return      address of the value at pwrite
+ * @pre         no concurrent writes
+ */
+void *LpelBufferWriteSpan( buffer_t *buf, int *n)
+{
+  assert( buf->elemsize > 0 && *n > 0 );
+
+  if ((unsigned long) *n > buf->size - buf->pwrite) {
+    *n = (int) (buf->size - buf->pwrite);
+  }
+  return buf->values + buf->pwrite * buf->elemsize;
+}
+
+
+/**
+ * Mark n values from pwrite on full, after they were written in place
+ *
+ * @param buf   value buffer to write to
+ * @param n     number of values
+ * @pre         no concurrent writes
+ * @pre         there has to be space for the n values
+ */
+void LpelBufferCommit( buffer_t *buf, int n)
+{
+  assert( buf->elemsize > 0 );
+
+  /* in order, the consumer stops at the first empty location */
+  while (n-- > 0) {
+    LpelBufferPut( buf, buf->values + buf->pwrite * buf->elemsize);
+  }
+}
+
+
+/**
+ * Values from pread on which lie in one piece
+ *
+ * @param buf   value buffer to read from
+ * @param n     in: number of values wanted,
+ *              out: at most that many, up to the end of the array
+ * @return      address of the value at pread
+ * @pre         no concurrent reads
+ */
+void *LpelBufferReadSpan( buffer_t *buf, int *n)
+{
+  assert( buf->elemsize > 0 && *n > 0 );
+
+  if ((unsigned long) *n > buf->size - buf->pread) {
+    *n = (int) (buf->size - buf->pread);
+  }
+  return buf->values + buf->pread * buf->elemsize;
+}
+
+
 int LpelBufferIsEmpty(buffer_t *buf) {
 	return (buf->data[buf->pread] == NULL);
 }
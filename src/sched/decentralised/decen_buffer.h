@@ -21,15 +21,24 @@ struct buffer_t {
   long padding2[longxCacheLine-1];
   unsigned long size;
   void **data;
+  unsigned long elemsize;   /* of the values, 0 for pointer items */
+  char *values;             /* size values, data[i] points to value i */
 };
 
 void  LpelBufferInit(buffer_t *buf, unsigned int size);
+void  LpelBufferInitValue(buffer_t *buf, unsigned int size, unsigned int elemsize);
 void  LpelBufferCleanup(buffer_t *buf);
 
 void *LpelBufferTop(buffer_t *buf);
+void *LpelBufferTopWait(buffer_t *buf);
 void  LpelBufferPop(buffer_t *buf);
 int   LpelBufferIsSpace(buffer_t *buf);
 void  LpelBufferPut(buffer_t *buf, void *item);
+void  LpelBufferPutValue(buffer_t *buf, const void *val);
+void  LpelBufferPutAt(buffer_t *buf, unsigned long pos, void *item);
+void *LpelBufferWriteSpan(buffer_t *buf, int *n);
+void  LpelBufferCommit(buffer_t *buf, int n);
+void *LpelBufferReadSpan(buffer_t *buf, int *n);
 int LpelBufferIsEmpty(buffer_t *buf);
 int LpelBufferCount(buffer_t *buf);
 #endif /* _BUFFER_H_ */
@@ -63,3 +63,14 @@ lpel_task_t *LpelSchedFetchReady( schedctx_t *sc)
   return t;
 }
 
+
+/* number of ready tasks, read without locking by other threads */
+int LpelSchedQueueSize( schedctx_t *sc)
+{
+  int i, n = 0;
+  for (i=0; i<SCHED_NUM_PRIO; i++) {
+    n += ((volatile taskqueue_t *) sc->queue[i])->count;
+  }
+  return n;
+}
+
@@ -17,6 +17,7 @@ void LpelSchedDestroy( schedctx_t *sc);
 
 void LpelSchedMakeReady( schedctx_t* sc, lpel_task_t *t);
 struct lpel_task_t *LpelSchedFetchReady( schedctx_t *sc);
+int LpelSchedQueueSize( schedctx_t *sc);
 
 
 
@@ -11,6 +11,7 @@
 
 #include "decen_stream.h"
 #include "lpel/monitor.h"
+#include "timerwheel.h"
 
 //#define _USE_STREAM_DBG__
 
@@ -22,6 +23,65 @@
 
 static atomic_int stream_seq = ATOMIC_VAR_INIT(0);
 
+static void InitStream(lpel_stream_t *s, int size);
+static int TryDown( atomic_int *sem, int n);
+
+
+/**
+ * A multicast stream passes every item to each of a fixed number of
+ * readers. The items are kept in a ring of their own, every reader has
+ * its own position and counter of the items it has yet to read.
+ * A location is free again when its last reader has read it; the free
+ * locations are counted in e_sem of the stream, as for other streams.
+ */
+typedef struct {
+  atomic_int n_sem;             /** items the reader has yet to read */
+  unsigned long pos;            /** position of its next item */
+  lpel_stream_desc_t *sd;       /** the reader, once it has opened */
+  long padding[longxCacheLine]; /** readers are on different cache lines */
+} mcast_reader_t;
+
+struct mcast_t {
+  int size;                 /** number of locations */
+  int num;                  /** number of readers */
+  atomic_int opened;        /** readers which have opened the stream */
+  int active;               /** readers which have not closed it yet */
+  atomic_int refs;          /** open descriptors, of readers and writer */
+  int destroy;              /** a reader has closed it with destroy_s */
+  unsigned long wpos;       /** position of the next write */
+  void **data;              /** the items */
+  atomic_int *left;         /** per location, readers yet to read it */
+  mcast_reader_t *readers;
+};
+
+static void McastWrite( lpel_stream_desc_t *sd, void *item);
+static void *McastRead( lpel_stream_desc_t *sd);
+
+
+/**
+ * A multi-producer stream may be written by several tasks at the same
+ * time. A writer claims a location by advancing the shared write
+ * position with a CAS and fills it without a lock. The consumer is the
+ * same as for other streams. Writers which find the stream full wait
+ * in a list, in the order they blocked; the list entries are the wait
+ * records of their tasks.
+ */
+typedef struct prod_waiter_t {
+  lpel_task_t *task;
+  struct prod_waiter_t *next;
+} prod_waiter_t;
+
+struct multi_t {
+  atomic_ulong claim;       /** next location to be claimed by a writer */
+  prod_waiter_t *first;     /** blocked writers, protected by prod_lock */
+  prod_waiter_t *last;
+  int wakeups;              /** for writers about to block, by prod_lock */
+};
+
+static void MultiWrite( lpel_stream_desc_t *sd, void *item);
+static int MultiTryWrite( lpel_stream_desc_t *sd, void *item);
+static void MultiWakeup( lpel_stream_desc_t *sd, int n);
+
 /**
  * Create a stream
  *
@@ -39,7 +99,103 @@ lpel_stream_t *LpelStreamCreate(int size)
 
   /* reset buffer (including buffer area) */
   LpelBufferInit(&s->buffer, size);
+  InitStream(s, size);
+  return s;
+}
+
+
+/**
+ * Create a value stream
+ *
+ * @param size      number of values the stream holds, 0 for the default
+ * @param elemsize  size of a value in bytes
+ * @return pointer to the created stream
+ */
+lpel_stream_t *LpelStreamCreateValue(int size, int elemsize)
+{
+  assert( size >= 0 && elemsize > 0);
+  if (0==size) size = STREAM_BUFFER_SIZE;
+
+  lpel_stream_t *s = (lpel_stream_t *) malloc( sizeof(lpel_stream_t) );
+  LpelBufferInitValue(&s->buffer, size, elemsize);
+  InitStream(s, size);
+  return s;
+}
+
+
+/**
+ * Create a multicast stream
+ *
+ * Every item written is read by each of the readers. They open the
+ * stream one after the other with LpelStreamOpen(), items written
+ * before a reader has opened the stream wait for it.
+ *
+ * @param size      number of items the stream holds, 0 for the default
+ * @param readers   number of readers
+ * @return pointer to the created stream
+ */
+lpel_stream_t *LpelStreamCreateMulticast(int size, int readers)
+{
+  struct mcast_t *m;
+  int i;
+
+  assert( size >= 0 && readers > 0);
+  if (0==size) size = STREAM_BUFFER_SIZE;
+
+  lpel_stream_t *s = (lpel_stream_t *) malloc( sizeof(lpel_stream_t) );
+  /* the items are not kept in the buffer */
+  LpelBufferInit(&s->buffer, 1);
+  InitStream(s, size);
+
+  m = (struct mcast_t *) malloc( sizeof(struct mcast_t) );
+  m->size = size;
+  m->num = readers;
+  atomic_init( &m->opened, 0);
+  m->active = readers;
+  atomic_init( &m->refs, 0);
+  m->destroy = 0;
+  m->wpos = 0;
+  m->data = (void **) malloc( size * sizeof(void *) );
+  m->left = (atomic_int *) malloc( size * sizeof(atomic_int) );
+  for (i = 0; i < size; i++) atomic_init( &m->left[i], 0);
+  m->readers = (mcast_reader_t *) malloc( readers * sizeof(mcast_reader_t) );
+  for (i = 0; i < readers; i++) {
+    atomic_init( &m->readers[i].n_sem, 0);
+    m->readers[i].pos = 0;
+    m->readers[i].sd = NULL;
+  }
+  s->mcast = m;
+  return s;
+}
+
+
+/**
+ * Create a multi-producer stream
+ *
+ * Several tasks may open the stream for writing and write to it
+ * concurrently, a single task reads from it.
+ *
+ * @param size  number of items the stream holds, 0 for the default
+ * @return pointer to the created stream
+ */
+lpel_stream_t *LpelStreamCreateMultiProducer(int size)
+{
+  struct multi_t *m;
+
+  lpel_stream_t *s = LpelStreamCreate(size);
+
+  m = (struct multi_t *) malloc( sizeof(struct multi_t) );
+  atomic_init( &m->claim, 0);
+  m->first = NULL;
+  m->last = NULL;
+  m->wakeups = 0;
+  s->multi = m;
+  return s;
+}
+
 
+static void InitStream(lpel_stream_t *s, int size)
+{
   s->uid = atomic_fetch_add( &stream_seq, 1);
   PRODLOCK_INIT( &s->prod_lock );
   atomic_init( &s->n_sem, 0);
@@ -48,93 +204,867 @@ lpel_stream_t *LpelStreamCreate(int size)
   s->prod_sd = NULL;
   s->cons_sd = NULL;
   s->usr_data = NULL;
-  return s;
+  s->mcast = NULL;
+  s->multi = NULL;
+}
+
+
+/**
+ * Destroy a stream
+ *
+ * Free the memory allocated for a stream.
+ *
+ * @param s   stream to be freed
+ * @pre       stream must not be opened by any task!
+ */
+void LpelStreamDestroy( lpel_stream_t *s)
+{
+  PRODLOCK_DESTROY( &s->prod_lock);
+  atomic_destroy( &s->n_sem);
+  atomic_destroy( &s->e_sem);
+  LpelBufferCleanup( &s->buffer);
+  if (s->multi != NULL) {
+    assert( s->multi->first == NULL);
+    atomic_destroy( &s->multi->claim);
+    free( s->multi);
+  }
+  if (s->mcast != NULL) {
+    struct mcast_t *m = s->mcast;
+    int i;
+
+    for (i = 0; i < m->size; i++) atomic_destroy( &m->left[i]);
+    for (i = 0; i < m->num; i++) atomic_destroy( &m->readers[i].n_sem);
+    atomic_destroy( &m->opened);
+    atomic_destroy( &m->refs);
+    free( m->readers);
+    free( m->left);
+    free( m->data);
+    free( m);
+  }
+  free( s);
+}
+
+/**
+ * Blocking P(e_sem) of a producer, for the space of one item
+ */
+static void WaitSpace( lpel_stream_desc_t *sd, void *item)
+{
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_writeprepare)) {
+    MON_CB(stream_writeprepare)(sd->mon, item);
+  }
+#endif
+
+  /* quasi P(e_sem) */
+  if ( atomic_fetch_sub( &sd->stream->e_sem, 1)== 0) {
+
+	/* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+    if (sd->mon && MON_CB(stream_blockon)) {
+      MON_CB(stream_blockon)(sd->mon);
+    }
+#endif
+
+    /* wait on stream: */
+    LpelTaskBlockStream( sd->task);
+  }
+}
+
+
+/**
+ * Put n items into the buffer after P(e_sem) for each, and V(n_sem):
+ * the item, the value val if item is NULL, or the n values written
+ * in place if both are NULL
+ */
+static void PutItems( lpel_stream_desc_t *sd, void *item, const void *val,
+    int n)
+{
+  lpel_task_t *self = sd->task;
+  int poll_wakeup = 0;
+
+  /* writing to the buffer and checking if consumer polls must be atomic */
+  PRODLOCK_LOCK( &sd->stream->prod_lock);
+  {
+    /* there must be space now in buffer */
+    assert( LpelBufferIsSpace( &sd->stream->buffer) );
+    /* put item into buffer */
+    if (item != NULL) {
+      LpelBufferPut( &sd->stream->buffer, item);
+    } else if (val != NULL) {
+      LpelBufferPutValue( &sd->stream->buffer, val);
+    } else {
+      LpelBufferCommit( &sd->stream->buffer, n);
+    }
+
+    if ( sd->stream->is_poll) {
+      /* get consumer's poll token */
+      poll_wakeup = atomic_exchange( &sd->stream->cons_sd->task->poll_token, 0);
+      sd->stream->is_poll = 0;
+    }
+  }
+  PRODLOCK_UNLOCK( &sd->stream->prod_lock);
+
+
+
+  /* quasi V(n_sem), the consumer waits for a single item only */
+  if ( atomic_fetch_add( &sd->stream->n_sem, n) < 0) {
+    /* n_sem was -1 */
+    lpel_task_t *cons = sd->stream->cons_sd->task;
+    /* wakeup consumer: make ready */
+    LpelTaskUnblock( self, cons);
+
+    /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+    if (sd->mon && MON_CB(stream_wakeup)) {
+      MON_CB(stream_wakeup)(sd->mon);
+    }
+#endif
+  } else {
+    /* we are the sole producer task waking the polling consumer up */
+    if (poll_wakeup) {
+      lpel_task_t *cons = sd->stream->cons_sd->task;
+      cons->wakeup_sd = sd->stream->cons_sd;
+
+      LpelTaskUnblock( self, cons);
+
+      /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+      if (sd->mon && MON_CB(stream_wakeup)) {
+        MON_CB(stream_wakeup)(sd->mon);
+      }
+#endif
+    }
+  }
+
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_writefinish)) {
+    MON_CB(stream_writefinish)(sd->mon);
+  }
+#endif
+
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
+}
+
+
+/**
+ * Blocking write of an item, or of the value val if item is NULL
+ */
+static void WriteItem( lpel_stream_desc_t *sd, void *item, const void *val)
+{
+  /* check if opened for writing */
+  assert( sd->mode == 'w' );
+  assert( (item != NULL) == (sd->stream->buffer.elemsize == 0) );
+  assert( sd->held == 0 );
+  assert( sd->stream->mcast == NULL );
+  assert( sd->stream->multi == NULL );
+
+  WaitSpace( sd, (item != NULL) ? item : (void *) val);
+  PutItems( sd, item, val, 1);
+}
+
+
+/**
+ * Blocking write to a stream
+ *
+ * If the stream is full, the task is suspended until the consumer
+ * reads items from the stream, freeing space for more items.
+ *
+ * @param sd    stream descriptor
+ * @param item  data item (a pointer) to write
+ * @pre         current task is single writer
+ * @pre         item != NULL
+ */
+void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
+{
+  if (sd->stream->mcast != NULL) {
+    McastWrite( sd, item);
+    return;
+  }
+  if (sd->stream->multi != NULL) {
+    MultiWrite( sd, item);
+    return;
+  }
+  WriteItem( sd, item, NULL);
+}
+
+
+/**
+ * Blocking write of a value to a value stream
+ *
+ * @param sd    stream descriptor
+ * @param val   the value, elemsize bytes are copied into the stream
+ * @pre         current task is single writer
+ */
+void LpelStreamWriteValue( lpel_stream_desc_t *sd, const void *val)
+{
+  WriteItem( sd, NULL, val);
+}
+
+
+/**
+ * Non-blocking write to a stream
+ *
+ * The space is claimed before the item is written: the buffer might
+ * have space already while the reader has not given it back yet.
+ * A stackless task remembers the full stream, to wait for space.
+ *
+ * @param sd    stream descriptor
+ * @param item  data item (a pointer) to write
+ * @pre         current task is single writer
+ * @pre         item != NULL
+ * @return 0 if the item could be written, -1 if the stream was full
+ */
+int LpelStreamTryWrite( lpel_stream_desc_t *sd, void *item)
+{
+  assert( sd->mode == 'w' );
+  assert( sd->stream->buffer.elemsize == 0 );
+
+  if (sd->stream->multi != NULL) {
+    if (MultiTryWrite( sd, item) == 0) return 0;
+  } else if (sd->stream->mcast != NULL) {
+    if (atomic_load( &sd->stream->e_sem) > 0) {
+      McastWrite( sd, item);
+      return 0;
+    }
+  } else if (TryDown( &sd->stream->e_sem, 1)) {
+    assert( sd->held == 0 );
+    /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+    if (sd->mon && MON_CB(stream_writeprepare)) {
+      MON_CB(stream_writeprepare)(sd->mon, item);
+    }
+#endif
+    PutItems( sd, item, NULL, 1);
+    return 0;
+  }
+
+  if (TASK_STACKLESS(sd->task)) sd->task->rec_full = sd;
+  return -1;
+}
+
+
+/**
+ * Non-blocking, consuming read from a stream
+ *
+ * @param sd  stream descriptor
+ * @return    the next item of the stream, or NULL if the stream is empty
+ * @pre       current task is single reader
+ */
+void *LpelStreamTryRead( lpel_stream_desc_t *sd)
+{
+  assert( sd->mode == 'r');
+  if (sd->stream->mcast != NULL) {
+    mcast_reader_t *r = &sd->stream->mcast->readers[sd->reader];
+    if (atomic_load( &r->n_sem) <= 0) return NULL;
+  } else if (sd->stream->multi != NULL) {
+    /* the top location may still be being filled */
+    if (atomic_load( &sd->stream->n_sem) <= 0) return NULL;
+  } else if (LpelBufferTop( &sd->stream->buffer) == NULL) {
+    return NULL;
+  }
+  return LpelStreamRead( sd);
+}
+
+
+/**
+ * Claim the poll token of a task for its timer,
+ * the producers compete for it in LpelStreamWrite()
+ */
+static int ClaimPollToken( lpel_task_t *t)
+{
+  return atomic_exchange( &t->poll_token, 0);
+}
+
+
+/**
+ * Block a task which has placed its poll token until either a producer
+ * or the timer at the deadline wakes it up, whichever claims the token first
+ *
+ * @pre   self->wakeup_sd was reset before placing the token
+ * @return 1 if woken up by a producer, 0 on timeout
+ */
+static int PollBlockTimed( lpel_task_t *self, const struct timespec *deadline)
+{
+  lpel_timer_t *tm = (lpel_timer_t *) LpelTaskWaitRecord( self);
+
+  assert( sizeof(*tm) <= LPEL_TASK_WAITREC_SIZE);
+  if (!LpelTimerWheelAdd( LpelWorkerTimerWheel(), tm, self,
+        ClaimPollToken, deadline)) {
+    /* the deadline has passed already */
+    if (atomic_exchange( &self->poll_token, 0)) return 0;
+    /* a producer has claimed the token, its wakeup is on the way */
+    LpelTaskBlockStream( self);
+    return 1;
+  }
+  LpelTaskBlockStream( self);
+
+  /* woken up by a producer, the timer must not fire anymore */
+  (void) LpelTimerWheelCancel( tm);
+  return (self->wakeup_sd != NULL);
+}
+
+
+/**
+ * Consuming read from a stream, waiting at most usec microseconds
+ *
+ * @param sd    stream descriptor
+ * @param usec  timeout in microseconds
+ * @return      the next item of the stream, or NULL on timeout
+ * @pre         current task is single reader
+ */
+void *LpelStreamReadTimeout( lpel_stream_desc_t *sd, unsigned long usec)
+{
+  lpel_task_t *self = sd->task;
+  lpel_stream_t *s = sd->stream;
+  struct timespec deadline;
+  int wait = 1;
+
+  assert( sd->mode == 'r');
+  assert( s->mcast == NULL && s->multi == NULL);
+
+  /* fast path */
+  if (LpelBufferTop( &s->buffer) != NULL) return LpelStreamRead( sd);
+
+  LpelTimerDeadline( &deadline, usec);
+
+  /* register as polling consumer of the single stream */
+  self->wakeup_sd = NULL;
+  atomic_store( &self->poll_token, 1);
+  PRODLOCK_LOCK( &s->prod_lock);
+  if (LpelBufferTop( &s->buffer) != NULL) {
+    /* the item may have arrived meanwhile */
+    if (atomic_exchange( &self->poll_token, 0)) wait = 0;
+  } else {
+    s->is_poll = 1;
+  }
+  PRODLOCK_UNLOCK( &s->prod_lock);
+
+  if (wait) (void) PollBlockTimed( self, &deadline);
+  assert( atomic_load( &self->poll_token) == 0);
+
+  PRODLOCK_LOCK( &s->prod_lock);
+  s->is_poll = 0;
+  PRODLOCK_UNLOCK( &s->prod_lock);
+
+  /* an item might also have arrived right at the timeout */
+  if (LpelBufferTop( &s->buffer) == NULL) return NULL;
+  return LpelStreamRead( sd);
+}
+
+/**
+ * V(e_sem) for n locations the consumer has freed
+ */
+static void FreeSpace( lpel_stream_desc_t *sd, int n)
+{
+  int cnt;
+
+  if (sd->stream->multi != NULL) {
+    /* quasi V(e_sem), every blocked writer waits for a single item */
+    cnt = atomic_fetch_add( &sd->stream->e_sem, n);
+    if (cnt < 0) MultiWakeup( sd, (-cnt < n) ? -cnt : n);
+    return;
+  }
+
+  /* quasi V(e_sem), the producer waits for the space of a single item */
+  if ( atomic_fetch_add( &sd->stream->e_sem, n) < 0) {
+    /* e_sem was -1 */
+    lpel_task_t *prod = sd->stream->prod_sd->task;
+    /* wakeup producer: make ready */
+    LpelTaskUnblock( sd->task, prod);
+
+    /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+    if (sd->mon && MON_CB(stream_wakeup)) {
+      MON_CB(stream_wakeup)(sd->mon);
+    }
+#endif
+
+  }
+}
+
+
+/**
+ * Pop n items, the first of which is item, after P(n_sem) for each,
+ * and V(e_sem)
+ */
+static void FreeItems( lpel_stream_desc_t *sd, void *item, int n)
+{
+  int i;
+
+  for (i = 0; i < n; i++) LpelBufferPop( &sd->stream->buffer);
+  FreeSpace( sd, n);
+
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_readfinish)) {
+    MON_CB(stream_readfinish)(sd->mon, item);
+  }
+#endif
+}
+
+
+/**
+ * Take the top item off the stream after P(n_sem) and free its space
+ */
+static void *TakeItem( lpel_stream_desc_t *sd, void *val)
+{
+  void *item;
+
+  assert( sd->held == 0);
+
+  /* read the top element */
+  if (sd->stream->multi != NULL) {
+    item = LpelBufferTopWait( &sd->stream->buffer);
+  } else {
+    item = LpelBufferTop( &sd->stream->buffer);
+  }
+  assert( item != NULL);
+  /* a value must be copied out before its location is given back */
+  if (val != NULL) memcpy( val, item, sd->stream->buffer.elemsize);
+  /* pop off the top element */
+  FreeItems( sd, item, 1);
+  return item;
+}
+
+
+/**
+ * Blocking P(n_sem) of the consumer, for one item
+ */
+static void WaitItem( lpel_stream_desc_t *sd, atomic_int *n_sem)
+{
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_readprepare)) {
+    MON_CB(stream_readprepare)(sd->mon);
+  }
+#endif
+
+  /* quasi P(n_sem) */
+  if ( atomic_fetch_sub( n_sem, 1) == 0) {
+
+#ifdef USE_TASK_EVENT_LOGGING
+    /* MONITORING CALLBACK */
+    if (sd->mon && MON_CB(stream_blockon)) {
+      MON_CB(stream_blockon)(sd->mon);
+    }
+#endif
+
+    /* wait on stream: */
+    LpelTaskBlockStream( sd->task);
+  }
+}
+
+
+/**
+ * Blocking read of the next item, copying it to val for a value stream
+ */
+static void *ReadItem( lpel_stream_desc_t *sd, void *val)
+{
+  void *item;
+
+  assert( sd->mode == 'r');
+
+  WaitItem( sd, &sd->stream->n_sem);
+  item = TakeItem( sd, val);
+
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
+  return item;
+}
+
+
+/**
+ * Blocking, consuming read from a stream
+ *
+ * If the stream is empty, the task is suspended until
+ * a producer writes an item to the stream.
+ *
+ * @param sd  stream descriptor
+ * @return    the next item of the stream
+ * @pre       current task is single reader
+ */
+void *LpelStreamRead( lpel_stream_desc_t *sd)
+{
+  assert( sd->stream->buffer.elemsize == 0);
+  if (sd->stream->mcast != NULL) return McastRead( sd);
+  return ReadItem( sd, NULL);
+}
+
+
+/**
+ * Blocking, consuming read from a value stream
+ *
+ * @param sd  stream descriptor
+ * @param val receives the next value of the stream
+ * @pre       current task is single reader
+ */
+void LpelStreamReadValue( lpel_stream_desc_t *sd, void *val)
+{
+  assert( sd->stream->buffer.elemsize > 0);
+  (void) ReadItem( sd, val);
 }
 
 
+/**
+ * Consuming read for a task which must not block
+ *
+ * Instead of blocking on an empty stream, the task is registered as the
+ * waiting consumer and NULL is returned. The next write wakes the task up,
+ * which then must call again with resume != 0 to take the item.
+ *
+ * @param sd      stream descriptor
+ * @param resume  the task has been woken up after returning NULL
+ * @return        the next item of the stream, or NULL
+ * @pre           current task is single reader
+ */
+void *LpelStreamReadOrWait( lpel_stream_desc_t *sd, int resume)
+{
+  assert( sd->mode == 'r');
+  assert( sd->stream->buffer.elemsize == 0);
+  assert( sd->stream->mcast == NULL);
+
+  if (!resume) {
+    /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+    if (sd->mon && MON_CB(stream_readprepare)) {
+      MON_CB(stream_readprepare)(sd->mon);
+    }
+#endif
+
+    /* quasi P(n_sem) */
+    if ( atomic_fetch_sub( &sd->stream->n_sem, 1) == 0) {
+#ifdef USE_TASK_EVENT_LOGGING
+      /* MONITORING CALLBACK */
+      if (sd->mon && MON_CB(stream_blockon)) {
+        MON_CB(stream_blockon)(sd->mon);
+      }
+#endif
+      return NULL;
+    }
+  }
+  return TakeItem( sd, NULL);
+}
+
+
+/**
+ * Instead of blocking on a full stream, the task is registered as the
+ * waiting producer and 0 is returned. The next read wakes the task up,
+ * which then must call again with resume != 0. The space is not kept,
+ * the item is written as usual afterwards.
+ *
+ * @param sd      stream descriptor
+ * @param resume  the task has been woken up after 0 was returned
+ * @return        1 if there is space for an item, 0 otherwise
+ * @pre           current task is single writer, not of a multicast or
+ *                multi-producer stream
+ */
+int LpelStreamSpaceOrWait( lpel_stream_desc_t *sd, int resume)
+{
+  assert( sd->mode == 'w');
+  assert( sd->stream->mcast == NULL && sd->stream->multi == NULL);
+
+  if (!resume) {
+    /* quasi P(e_sem) */
+    if ( atomic_fetch_sub( &sd->stream->e_sem, 1) == 0) {
+#ifdef USE_TASK_EVENT_LOGGING
+      /* MONITORING CALLBACK */
+      if (sd->mon && MON_CB(stream_blockon)) {
+        MON_CB(stream_blockon)(sd->mon);
+      }
+#endif
+      return 0;
+    }
+  }
+  /* give the space back, the sole writer claims it again on writing */
+  atomic_fetch_add( &sd->stream->e_sem, 1);
+  return 1;
+}
+
+
+/**
+ * Decrement a semaphore by up to n while it is positive, without blocking
+ *
+ * @return the amount it was decremented by
+ */
+static int TryDown( atomic_int *sem, int n)
+{
+  int got = 0, cnt;
+
+  while (got < n) {
+    cnt = atomic_load( sem);
+    if (cnt <= 0) break;
+    if (atomic_test_and_set( sem, cnt, cnt-1)) got++;
+  }
+  return got;
+}
+
+
+/**
+ * Reserve values of a value stream, to be written in place
+ *
+ * Blocks until a value is free. Then as many of the wanted values are
+ * reserved as are free and lie in one piece in the stream.
+ *
+ * @param sd  stream descriptor of a value stream
+ * @param n   in: number of values wanted, out: number of values reserved
+ * @return    address of the first reserved value, the others follow it
+ * @pre       current task is single writer, and has no values reserved
+ */
+void *LpelStreamReserve( lpel_stream_desc_t *sd, int *n)
+{
+  lpel_stream_t *s = sd->stream;
+  void *first;
+
+  assert( sd->mode == 'w');
+  assert( s->buffer.elemsize > 0);
+  assert( sd->held == 0);
+
+  first = LpelBufferWriteSpan( &s->buffer, n);
+  WaitSpace( sd, first);
+  *n = 1 + TryDown( &s->e_sem, *n - 1);
+  sd->held = *n;
+  return first;
+}
+
+
+/**
+ * Make the first n reserved values visible to the consumer,
+ * the other reserved values become free again
+ *
+ * @param sd  stream descriptor of a value stream
+ * @param n   number of values written, at most the number reserved
+ * @pre       current task is single writer
+ */
+void LpelStreamCommit( lpel_stream_desc_t *sd, int n)
+{
+  lpel_stream_t *s = sd->stream;
+
+  assert( sd->mode == 'w');
+  assert( n >= 0 && n <= sd->held);
+
+  /* only the producer waits for space, no wakeup needed */
+  if (n < sd->held) atomic_fetch_add( &s->e_sem, sd->held - n);
+  sd->held = 0;
+  if (n > 0) PutItems( sd, NULL, NULL, n);
+}
+
+
+/**
+ * Acquire values of a value stream, to be read in place
+ *
+ * Blocks until a value is available. Then as many of the wanted values
+ * are acquired as are available and lie in one piece in the stream.
+ *
+ * @param sd  stream descriptor of a value stream
+ * @param n   in: number of values wanted, out: number of values acquired
+ * @return    address of the first acquired value, the others follow it
+ * @pre       current task is single reader, and has no values acquired
+ */
+void *LpelStreamAcquire( lpel_stream_desc_t *sd, int *n)
+{
+  lpel_stream_t *s = sd->stream;
+  void *first;
+
+  assert( sd->mode == 'r');
+  assert( s->buffer.elemsize > 0);
+  assert( sd->held == 0);
+
+  WaitItem( sd, &sd->stream->n_sem);
+  first = LpelBufferReadSpan( &s->buffer, n);
+  *n = 1 + TryDown( &s->n_sem, *n - 1);
+  sd->held = *n;
+  return first;
+}
+
 
 /**
- * Destroy a stream
- *
- * Free the memory allocated for a stream.
+ * Give the space of the first n acquired values back to the producer,
+ * the other acquired values remain in the stream to be read again
  *
- * @param s   stream to be freed
- * @pre       stream must not be opened by any task!
+ * @param sd  stream descriptor of a value stream
+ * @param n   number of values done with, at most the number acquired
+ * @pre       current task is single reader
  */
-void LpelStreamDestroy( lpel_stream_t *s)
+void LpelStreamRelease( lpel_stream_desc_t *sd, int n)
 {
-  PRODLOCK_DESTROY( &s->prod_lock);
-  atomic_destroy( &s->n_sem);
-  atomic_destroy( &s->e_sem);
-  LpelBufferCleanup( &s->buffer);
-  free( s);
+  lpel_stream_t *s = sd->stream;
+  void *first;
+
+  assert( sd->mode == 'r');
+  assert( n >= 0 && n <= sd->held);
+
+  /* only the consumer waits for items, no wakeup needed */
+  if (n < sd->held) atomic_fetch_add( &s->n_sem, sd->held - n);
+  sd->held = 0;
+  if (n == 0) return;
+
+  first = LpelBufferTop( &s->buffer);
+  FreeItems( sd, first, n);
+
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
 }
 
+
 /**
- * Blocking write to a stream
- *
- * If the stream is full, the task is suspended until the consumer
- * reads items from the stream, freeing space for more items.
- *
- * @param sd    stream descriptor
- * @param item  data item (a pointer) to write
- * @pre         current task is single writer
- * @pre         item != NULL
+ * Blocking write to a multicast stream, of an item for every reader
  */
-void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
+static void McastWrite( lpel_stream_desc_t *sd, void *item)
 {
-  lpel_task_t *self = sd->task;
-  int poll_wakeup = 0;
+  lpel_stream_t *s = sd->stream;
+  struct mcast_t *m = s->mcast;
+  unsigned long loc;
+  int i, readers;
 
-  /* check if opened for writing */
   assert( sd->mode == 'w' );
   assert( item != NULL );
 
+  WaitSpace( sd, item);
+
+  /* the readers an item counts for must not leave meanwhile */
+  PRODLOCK_LOCK( &s->prod_lock);
+  {
+    loc = m->wpos % m->size;
+    assert( atomic_load( &m->left[loc]) == 0 );
+    m->data[loc] = item;
+    readers = m->active;
+    atomic_store( &m->left[loc], readers);
+    WMB();
+    m->wpos++;
+  }
+  PRODLOCK_UNLOCK( &s->prod_lock);
+
+  /* all readers have left, the location is free again right away */
+  if (readers == 0) atomic_fetch_add( &s->e_sem, 1);
+
+  /* quasi V(n_sem) of every reader */
+  for (i = 0; i < m->num; i++) {
+    if ( atomic_fetch_add( &m->readers[i].n_sem, 1) < 0) {
+      /* n_sem was -1, the reader has opened the stream */
+      LpelTaskUnblock( sd->task, m->readers[i].sd->task);
+
+      /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+      if (sd->mon && MON_CB(stream_wakeup)) {
+        MON_CB(stream_wakeup)(sd->mon);
+      }
+#endif
+    }
+  }
+
   /* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
-  if (sd->mon && MON_CB(stream_writeprepare)) {
-    MON_CB(stream_writeprepare)(sd->mon, item);
+  if (sd->mon && MON_CB(stream_writefinish)) {
+    MON_CB(stream_writefinish)(sd->mon);
   }
 #endif
 
-  /* quasi P(e_sem) */
-  if ( atomic_fetch_sub( &sd->stream->e_sem, 1)== 0) {
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
+}
 
-	/* MONITORING CALLBACK */
+
+/**
+ * Blocking read of the next item of a reader of a multicast stream
+ */
+static void *McastRead( lpel_stream_desc_t *sd)
+{
+  struct mcast_t *m = sd->stream->mcast;
+  mcast_reader_t *r = &m->readers[sd->reader];
+  unsigned long loc;
+  void *item;
+
+  assert( sd->mode == 'r');
+
+  WaitItem( sd, &r->n_sem);
+
+  loc = r->pos++ % m->size;
+  item = m->data[loc];
+  /* the last reader of the item frees its location */
+  if ( atomic_fetch_sub( &m->left[loc], 1) == 1) FreeSpace( sd, 1);
+
+  /* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
-    if (sd->mon && MON_CB(stream_blockon)) {
-      MON_CB(stream_blockon)(sd->mon);
-    }
+  if (sd->mon && MON_CB(stream_readfinish)) {
+    MON_CB(stream_readfinish)(sd->mon, item);
+  }
 #endif
 
-    /* wait on stream: */
-    LpelTaskBlockStream( self);
-  }
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
+  return item;
+}
 
-  /* writing to the buffer and checking if consumer polls must be atomic */
-  PRODLOCK_LOCK( &sd->stream->prod_lock);
-  {
-    /* there must be space now in buffer */
-    assert( LpelBufferIsSpace( &sd->stream->buffer) );
-    /* put item into buffer */
-    LpelBufferPut( &sd->stream->buffer, item);
 
-    if ( sd->stream->is_poll) {
-      /* get consumer's poll token */
-      poll_wakeup = atomic_exchange( &sd->stream->cons_sd->task->poll_token, 0);
-      sd->stream->is_poll = 0;
+/**
+ * A reader leaves a multicast stream, the items it has not read
+ * are done with for it and later items do not count it anymore
+ */
+static void McastLeave( lpel_stream_desc_t *sd)
+{
+  lpel_stream_t *s = sd->stream;
+  struct mcast_t *m = s->mcast;
+  mcast_reader_t *r = &m->readers[sd->reader];
+  int freed = 0;
+
+  PRODLOCK_LOCK( &s->prod_lock);
+  {
+    m->active--;
+    for (; r->pos != m->wpos; r->pos++) {
+      if ( atomic_fetch_sub( &m->left[r->pos % m->size], 1) == 1) freed++;
     }
   }
-  PRODLOCK_UNLOCK( &sd->stream->prod_lock);
+  PRODLOCK_UNLOCK( &s->prod_lock);
+
+  if (freed > 0) FreeSpace( sd, freed);
+}
 
 
+/**
+ * Close a descriptor of a multicast stream
+ *
+ * The writer may still be waking up readers when the last of them
+ * closes, so the stream is destroyed, if a reader asked for it,
+ * only when all readers have left and no descriptor is open anymore.
+ *
+ * @return 1 if the stream is to be destroyed
+ */
+static int McastClose( lpel_stream_desc_t *sd, int destroy_s)
+{
+  struct mcast_t *m = sd->stream->mcast;
+
+  if (sd->mode == 'r') {
+    McastLeave( sd);
+    if (destroy_s) m->destroy = 1;
+  }
+  if ( atomic_fetch_sub( &m->refs, 1) != 1) return 0;
+  return m->destroy && m->active == 0;
+}
+
+
+/**
+ * Claim the next location of a multi-producer stream, and fill it
+ * after P(e_sem), and V(n_sem)
+ */
+static void MultiPut( lpel_stream_desc_t *sd, void *item)
+{
+  lpel_stream_t *s = sd->stream;
+  unsigned long pos, next;
+
+  do {
+    pos = atomic_load( &s->multi->claim);
+    next = (pos+1 >= s->buffer.size) ? 0 : pos+1;
+  } while (!atomic_test_and_set( &s->multi->claim, pos, next));
+
+  LpelBufferPutAt( &s->buffer, pos, item);
 
   /* quasi V(n_sem) */
-  if ( atomic_fetch_add( &sd->stream->n_sem, 1) < 0) {
+  if ( atomic_fetch_add( &s->n_sem, 1) < 0) {
     /* n_sem was -1 */
-    lpel_task_t *cons = sd->stream->cons_sd->task;
-    /* wakeup consumer: make ready */
-    LpelTaskUnblock( self, cons);
+    LpelTaskUnblock( sd->task, s->cons_sd->task);
 
     /* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
@@ -142,21 +1072,6 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
       MON_CB(stream_wakeup)(sd->mon);
     }
 #endif
-  } else {
-    /* we are the sole producer task waking the polling consumer up */
-    if (poll_wakeup) {
-      lpel_task_t *cons = sd->stream->cons_sd->task;
-      cons->wakeup_sd = sd->stream->cons_sd;
-
-      LpelTaskUnblock( self, cons);
-
-      /* MONITORING CALLBACK */
-#ifdef USE_TASK_EVENT_LOGGING
-      if (sd->mon && MON_CB(stream_wakeup)) {
-        MON_CB(stream_wakeup)(sd->mon);
-      }
-#endif
-    }
   }
 
   /* MONITORING CALLBACK */
@@ -166,96 +1081,115 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
   }
 #endif
 
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
 }
 
 
 /**
- * Non-blocking write to a stream
- *
- * @param sd    stream descriptor
- * @param item  data item (a pointer) to write
- * @pre         current task is single writer
- * @pre         item != NULL
- * @return 0 if the item could be written, -1 if the stream was full
- */
-int LpelStreamTryWrite( lpel_stream_desc_t *sd, void *item)
-{
-  if (!LpelBufferIsSpace(&sd->stream->buffer)) {
-    return -1;
-  }
-  LpelStreamWrite( sd, item );
-  return 0;
-}
-
-/**
- * Blocking, consuming read from a stream
- *
- * If the stream is empty, the task is suspended until
- * a producer writes an item to the stream.
- *
- * @param sd  stream descriptor
- * @return    the next item of the stream
- * @pre       current task is single reader
+ * Blocking write to a multi-producer stream
  */
-void *LpelStreamRead( lpel_stream_desc_t *sd)
+static void MultiWrite( lpel_stream_desc_t *sd, void *item)
 {
-  void *item;
-  lpel_task_t *self = sd->task;
+  struct multi_t *m = sd->stream->multi;
+  prod_waiter_t *self;
 
-  assert( sd->mode == 'r');
+  assert( sd->mode == 'w' );
+  assert( item != NULL );
 
   /* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
-  if (sd->mon && MON_CB(stream_readprepare)) {
-    MON_CB(stream_readprepare)(sd->mon);
+  if (sd->mon && MON_CB(stream_writeprepare)) {
+    MON_CB(stream_writeprepare)(sd->mon, item);
   }
 #endif
 
-  /* quasi P(n_sem) */
-  if ( atomic_fetch_sub( &sd->stream->n_sem, 1) == 0) {
+  /* quasi P(e_sem), other writers may be waiting already */
+  if ( atomic_fetch_sub( &sd->stream->e_sem, 1) <= 0) {
 
-#ifdef USE_TASK_EVENT_LOGGING
     /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
     if (sd->mon && MON_CB(stream_blockon)) {
       MON_CB(stream_blockon)(sd->mon);
     }
 #endif
 
-    /* wait on stream: */
-    LpelTaskBlockStream( self);
+    PRODLOCK_LOCK( &sd->stream->prod_lock);
+    if (m->wakeups > 0) {
+      /* the consumer has freed a location before we got here */
+      m->wakeups--;
+      PRODLOCK_UNLOCK( &sd->stream->prod_lock);
+    } else {
+      /* the consumer accesses the entry while we are blocked, it must
+       * not live on the stack, which may be a shared one */
+      self = (prod_waiter_t *) LpelTaskWaitRecord( sd->task);
+      assert( sizeof(*self) <= LPEL_TASK_WAITREC_SIZE );
+      self->task = sd->task;
+      self->next = NULL;
+      if (m->last != NULL) m->last->next = self;
+      else m->first = self;
+      m->last = self;
+      PRODLOCK_UNLOCK( &sd->stream->prod_lock);
+
+      /* wait on stream: */
+      LpelTaskBlockStream( sd->task);
+    }
   }
 
+  MultiPut( sd, item);
+}
 
-  /* read the top element */
-  item = LpelBufferTop( &sd->stream->buffer);
-  assert( item != NULL);
-  /* pop off the top element */
-  LpelBufferPop( &sd->stream->buffer);
 
+/**
+ * Non-blocking write to a multi-producer stream
+ *
+ * @return 0 if the item could be written, -1 if the stream was full
+ */
+static int MultiTryWrite( lpel_stream_desc_t *sd, void *item)
+{
+  assert( sd->mode == 'w' );
+  assert( item != NULL );
+
+  if (TryDown( &sd->stream->e_sem, 1) == 0) return -1;
+  MultiPut( sd, item);
+  return 0;
+}
 
-  /* quasi V(e_sem) */
-  if ( atomic_fetch_add( &sd->stream->e_sem, 1) < 0) {
-    /* e_sem was -1 */
-    lpel_task_t *prod = sd->stream->prod_sd->task;
-    /* wakeup producer: make ready */
-    LpelTaskUnblock( self, prod);
 
-    /* MONITORING CALLBACK */
-#ifdef USE_TASK_EVENT_LOGGING
-    if (sd->mon && MON_CB(stream_wakeup)) {
-      MON_CB(stream_wakeup)(sd->mon);
+/**
+ * Wake up n writers of a multi-producer stream which have found it full,
+ * in the order they blocked
+ */
+static void MultiWakeup( lpel_stream_desc_t *sd, int n)
+{
+  struct multi_t *m = sd->stream->multi;
+  lpel_task_t *prod;
+
+  while (n-- > 0) {
+    prod = NULL;
+    PRODLOCK_LOCK( &sd->stream->prod_lock);
+    if (m->first != NULL) {
+      prod = m->first->task;
+      m->first = m->first->next;
+      if (m->first == NULL) m->last = NULL;
+    } else {
+      /* the writer has not put itself into the list yet */
+      m->wakeups++;
     }
-#endif
+    PRODLOCK_UNLOCK( &sd->stream->prod_lock);
 
-  }
+    if (prod != NULL) {
+      /* wakeup producer: make ready */
+      LpelTaskUnblock( sd->task, prod);
 
-  /* MONITORING CALLBACK */
+      /* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
-  if (sd->mon && MON_CB(stream_readfinish)) {
-    MON_CB(stream_readfinish)(sd->mon, item);
-  }
+      if (sd->mon && MON_CB(stream_wakeup)) {
+        MON_CB(stream_wakeup)(sd->mon);
+      }
 #endif
-  return item;
+    }
+  }
 }
 
 
@@ -266,7 +1200,8 @@ void *LpelStreamRead( lpel_stream_desc_t *sd)
  * @param mode  either 'r' for reading or 'w' for writing
  * @return      a stream descriptor
  * @pre         only one task may open it for reading resp. writing
- *              at any given point in time
+ *              at any given point in time, except for the readers of
+ *              a multicast and the writers of a multi-producer stream
  */
 lpel_stream_desc_t *LpelStreamOpen( lpel_stream_t *s, char mode)
 {
@@ -293,6 +1228,19 @@ lpel_stream_desc_t *LpelStreamOpen( lpel_stream_t *s, char mode)
   sd->mon = NULL;
 #endif
 
+  sd->held = 0;
+  sd->is_mcast = (s->mcast != NULL);
+  sd->reader = 0;
+  if (s->mcast != NULL) {
+    atomic_fetch_add( &s->mcast->refs, 1);
+    if (mode == 'r') {
+      /* register as the next reader */
+      sd->reader = atomic_fetch_add( &s->mcast->opened, 1);
+      assert( sd->reader < s->mcast->num);
+      s->mcast->readers[sd->reader].sd = sd;
+    }
+  }
+
   switch(mode) {
     case 'r': s->cons_sd = sd; break;
     case 'w': s->prod_sd = sd; break;
@@ -310,6 +1258,12 @@ lpel_stream_desc_t *LpelStreamOpen( lpel_stream_t *s, char mode)
  */
 void LpelStreamClose( lpel_stream_desc_t *sd, int destroy_s)
 {
+  assert( sd->held == 0);
+
+  /* a plain stream may already be destroyed by its reader, do not touch
+   * it; the state of a multicast stream stays until the last close */
+  if (sd->is_mcast) destroy_s = McastClose( sd, destroy_s);
+
   /* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
   if (sd->mon && MON_CB(stream_close)) {
@@ -336,6 +1290,8 @@ void LpelStreamClose( lpel_stream_desc_t *sd, int destroy_s)
 void LpelStreamReplace( lpel_stream_desc_t *sd, lpel_stream_t *snew)
 {
   assert( sd->mode == 'r');
+  assert( sd->stream->mcast == NULL && snew->mcast == NULL);
+  assert( sd->stream->multi == NULL && snew->multi == NULL);
 
   /* destroy old stream */
   LpelStreamDestroy( sd->stream);
@@ -397,26 +1353,16 @@ lpel_stream_t *LpelStreamGet(lpel_stream_desc_t *sd)
 void *LpelStreamPeek( lpel_stream_desc_t *sd)
 {
   assert( sd->mode == 'r');
+  assert( sd->stream->mcast == NULL);
   return LpelBufferTop( &sd->stream->buffer);
 }
 
 
 /**
- * Poll a set of streams
- *
- * This is a blocking function called by a consumer which wants to wait
- * for arrival of data on any of a specified set of streams.
- * The consumer task is suspended while there is no new data on all streams.
- *
- * @param set     a stream descriptor set the task wants to poll
- * @pre           set must not be empty (*set != NULL)
- *
- * @post          The first element when iterating through the set after
- *                LpelStreamPoll() will be the one after the one which
- *                caused the task to wakeup,
- *                i.e., the first stream where data arrived.
+ * Poll a set of streams until the deadline, NULL = no timeout
  */
-lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
+static lpel_stream_desc_t *PollSet( lpel_streamset_t *set,
+    const struct timespec *deadline)
 {
   lpel_task_t *self;
   lpel_stream_iter_t *iter;
@@ -434,6 +1380,7 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
   while( LpelStreamIterHasNext( iter)) {
     lpel_stream_desc_t *sd = LpelStreamIterNext( iter);
     lpel_stream_t *s = sd->stream;
+    assert( s->mcast == NULL && s->multi == NULL);
     if ( LpelBufferTop( &s->buffer) != NULL) {
       LpelStreamIterDestroy(iter);
       *set = sd;
@@ -443,6 +1390,7 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
 
 
   /* place a poll token */
+  self->wakeup_sd = NULL;
   atomic_store( &self->poll_token, 1);
 
   /* for each stream in the set */
@@ -486,8 +1434,12 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
 
   /* context switch */
   if (do_ctx_switch) {
-    /* set task as blocked */
-    LpelTaskBlockStream( self);
+    if (deadline != NULL) {
+      (void) PollBlockTimed( self, deadline);
+    } else {
+      /* set task as blocked */
+      LpelTaskBlockStream( self);
+    }
   }
   assert( atomic_load( &self->poll_token) == 0);
 
@@ -513,12 +1465,54 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
 
   LpelStreamIterDestroy(iter);
 
+  /* timed out */
+  if (self->wakeup_sd == NULL) return NULL;
+
   /* 'rotate' set to stream descriptor for non-empty buffer */
   *set = self->wakeup_sd;
 
   return self->wakeup_sd;
 }
 
+
+/**
+ * Poll a set of streams
+ *
+ * This is a blocking function called by a consumer which wants to wait
+ * for arrival of data on any of a specified set of streams.
+ * The consumer task is suspended while there is no new data on all streams.
+ *
+ * @param set     a stream descriptor set the task wants to poll
+ * @pre           set must not be empty (*set != NULL)
+ *
+ * @post          The first element when iterating through the set after
+ *                LpelStreamPoll() will be the one after the one which
+ *                caused the task to wakeup,
+ *                i.e., the first stream where data arrived.
+ */
+lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
+{
+  return PollSet( set, NULL);
+}
+
+
+/**
+ * Poll a set of streams, waiting at most usec microseconds
+ *
+ * @param set     a stream descriptor set the task wants to poll
+ * @param usec    timeout in microseconds
+ * @pre           set must not be empty (*set != NULL)
+ * @return        as LpelStreamPoll(), or NULL on timeout;
+ *                the set is left unchanged then
+ */
+lpel_stream_desc_t *LpelStreamPollTimeout( lpel_streamset_t *set,
+    unsigned long usec)
+{
+  struct timespec deadline;
+  LpelTimerDeadline( &deadline, usec);
+  return PollSet( set, &deadline);
+}
+
 int LpelStreamGetId(lpel_stream_desc_t *sd) {
 	if (sd)
 		if (sd->stream)
@@ -28,7 +28,16 @@ struct lpel_stream_t {
   atomic_int n_sem;           /** counter for elements in the stream */
   atomic_int e_sem;           /** counter for empty space in the stream */
   void *usr_data;           /** arbitrary user data */
+  struct mcast_t *mcast;    /** readers of a multicast stream, or NULL */
+  struct multi_t *multi;    /** writers of a multi-producer stream, or NULL */
 };
 
 
+/* read of a task that cannot block, for stackless tasks */
+void *LpelStreamReadOrWait( lpel_stream_desc_t *sd, int resume);
+
+/* wait for space of a task that cannot block, for stackless tasks */
+int LpelStreamSpaceOrWait( lpel_stream_desc_t *sd, int resume);
+
+
 #endif /* _STREAM_H_ */
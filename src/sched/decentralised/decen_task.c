@@ -1,17 +1,25 @@
+#include <stdlib.h>
+#include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <lpel.h>
 #include "lpelcfg.h"
 #include "decen_worker.h"
+#include "decen_stream.h"
 #include "spmdext.h"
 #include "lpel/monitor.h"
+#include "stackmark.h"
 #include "decen_scheduler.h"
 #include "task_migration.h"
+#include "timeslice.h"
+#include "lpel_main.h"
 
 extern lpel_tm_config_t tm_conf;
 static atomic_int taskseq = ATOMIC_VAR_INIT(0);
 
 static void FinishOffCurrentTask(lpel_task_t *ct);
 static void TaskStartup( void *arg);
+static void InitTask( lpel_task_t *t, int worker, void *inarg);
 
 
 /**
@@ -47,25 +55,12 @@ lpel_task_t *LpelTaskCreate( int worker, lpel_taskfunc_t func,
 	t->size = size;
 
 
-	/* obtain a usable worker context */
-	t->worker_context = LpelWorkerGetContext(worker);
-
-	t->sched_info.prio = 0;
-
-	t->uid = atomic_fetch_add( &taskseq, 1);  /* obtain a unique task id */
+	InitTask( t, worker, inarg);
 	t->func = func;
-	t->inarg = inarg;
-
-	/* initialize poll token to 0 */
-	atomic_init( &t->poll_token, 0);
 
-	t->state = TASK_CREATED;
-
-	t->prev = t->next = NULL;
-
-	t->mon = NULL;
-	t->usrdata = NULL;
-	t->usrdt_destr = NULL;
+#ifdef USE_STACK_WATERMARK
+	LpelStackPaint( stackaddr, t->size - offset);
+#endif
 
 	/* function, argument (data), stack base address, stacksize */
 	mctx_create( &t->mctx, TaskStartup, (void*)t, stackaddr, t->size - offset);
@@ -77,6 +72,82 @@ lpel_task_t *LpelTaskCreate( int worker, lpel_taskfunc_t func,
 }
 
 
+/**
+ * Create a stackless task.
+ *
+ * The task consists of a record function called on the stack of its
+ * worker for every item read from the stream in, it has no stack and
+ * no machine context of its own. The function must not block: it may
+ * only use the non-blocking stream calls, the task is suspended between
+ * items only. It is terminated when the function returns != 0, closing
+ * and destroying the input stream.
+ *
+ * @param worker  id of the worker where to create the task, no wrappers
+ * @param func    record function
+ * @param arg     second argument of func
+ * @param in      input stream of the task
+ *
+ * @return the task handle of the created task (pointer to TCB)
+ */
+lpel_task_t *LpelTaskCreateStackless( int worker, lpel_recfunc_t func,
+		void *arg, lpel_stream_t *in)
+{
+	lpel_task_t *t;
+
+	/* a wrapper would have to switch to the task */
+	assert( worker >= 0 );
+	assert( func != NULL && in != NULL );
+
+	t = (lpel_task_t *) malloc( sizeof(lpel_task_t) );
+	t->size = sizeof(lpel_task_t);
+
+	InitTask( t, worker, arg);
+	t->func = NULL;
+	t->recfunc = func;
+	t->rec_stream = in;
+
+	return t;
+}
+
+
+/**
+ * Create a task running on the shared stack of its worker.
+ *
+ * While the task runs, its frames live on a large stack shared by all
+ * such tasks of the worker. When another of them needs the stack, only
+ * the used part is copied out to a buffer of the task, and copied back
+ * before the task resumes. A suspended task thus costs its TCB and its
+ * actual stack depth, at the price of the copying. The task is bound to
+ * its worker, it is not migrated.
+ *
+ * Tasks on wrappers get a stack of their own.
+ *
+ * @param worker  id of the worker where to create the task
+ * @param func    task function
+ * @param arg     arguments
+ *
+ * @return the task handle of the created task (pointer to TCB)
+ */
+lpel_task_t *LpelTaskCreateShared( int worker, lpel_taskfunc_t func,
+		void *inarg)
+{
+	/* wrappers run a single task; a PCL coroutine cannot be moved */
+#ifndef USE_MCTX_PCL
+	if (worker >= 0) {
+		lpel_task_t *t = (lpel_task_t *) malloc( sizeof(lpel_task_t) );
+		t->size = sizeof(lpel_task_t);
+
+		InitTask( t, worker, inarg);
+		t->func = func;
+		/* the context is created on the first run, on the shared stack */
+		t->shared = 1;
+		return t;
+	}
+#endif
+	return LpelTaskCreate( worker, func, inarg, 0);
+}
+
+
 /**
  * Destroy a task
  * - completely free the memory for that task
@@ -85,6 +156,15 @@ void LpelTaskDestroy( lpel_task_t *t)
 {
 	assert( t->state == TASK_ZOMBIE);
 
+#ifdef USE_STACK_WATERMARK
+	/* shared-stack and stackless tasks have no stack of their own */
+	if (!TASK_STACKLESS(t) && !TASK_SHARED(t)) {
+		int offset = (sizeof(lpel_task_t) + TASK_STACK_ALIGN-1) & ~(TASK_STACK_ALIGN-1);
+		size_t size = t->size - offset;
+		LpelStackRecord( t->mon, LpelStackPeak( (char *) t + offset, size), size);
+	}
+#endif
+
 #ifdef USE_TASK_EVENT_LOGGING
 	/* if task had a monitoring object, destroy it */
 	if (t->mon && MON_CB(task_destroy)) {
@@ -96,9 +176,11 @@ void LpelTaskDestroy( lpel_task_t *t)
 
 	//FIXME
 #ifdef USE_MCTX_PCL
-	co_delete(t->mctx);
+	if (!TASK_STACKLESS(t)) co_delete(t->mctx);
 #endif
 
+	free(t->stk_save);
+
 	/* free the TCB itself*/
 	free(t);
 }
@@ -113,6 +195,20 @@ void LpelTaskSetPriority(lpel_task_t *t, int prio)
 	t->sched_info.prio = prio;
 }
 
+/**
+ * Let a task keep its floating-point control state across context switches
+ * @param t				task, not started yet
+ */
+void LpelTaskSaveFpState(lpel_task_t *t)
+{
+	assert( t->state == TASK_CREATED );
+	if (t->fpstate) return;
+
+	t->fpstate = 1;
+	/* the context of a shared-stack task is created on its first run */
+	if (!TASK_STACKLESS(t) && !TASK_SHARED(t)) mctx_init_fp( &t->mctx);
+}
+
 
 /**
  * Let a task start
@@ -145,20 +241,29 @@ void LpelTaskExit(void)
  * Task issues an enter world request
  */
 void LpelTaskEnterSPMD( lpel_spmdfunc_t fun, void *arg)
+{
+	LpelTaskEnterSPMDSet( fun, arg, NULL, 0);
+}
+
+
+/**
+ * Task issues a request for a spmd region on a subset of the workers,
+ * the worker of the task always takes part (with virtual id 0).
+ * Requests on disjoint subsets are executed concurrently.
+ *
+ * @param workers   ids of the participating workers, NULL for all workers
+ * @param num       number of entries in workers
+ */
+void LpelTaskEnterSPMDSet( lpel_spmdfunc_t fun, void *arg,
+    const int *workers, int num)
 {
 	lpel_task_t *ct = LpelTaskSelf();
-	workermsg_t msg;
 	assert( ct->state == TASK_RUNNING );
 
 	//FIXME conditional for availability?
 
-	/* world request */
-	LpelSpmdRequest(ct, fun, arg);
-
-	/* broadcast message */
-	msg.type = WORKER_MSG_SPMDREQ;
-	msg.body.from_worker = ct->worker_context->wid;
-	LpelWorkerBroadcast(&msg);
+	/* request, notifies the participating workers */
+	LpelSpmdRequest(ct, fun, arg, workers, num);
 
 	ct->state = TASK_BLOCKED;
 	/* TODO block on what? */
@@ -178,13 +283,16 @@ void LpelTaskYield(void)
   lpel_task_t *ct = LpelTaskSelf();
   assert( ct->state == TASK_RUNNING );
 
+  /* stackless tasks yield between records only */
+  if (TASK_STACKLESS(ct)) return;
+
   ct->state = TASK_READY;
 
   /* task wait_prop is updated
    * check if it should be migrated
    * If yes --> self migrated, if no --> self yield
    */
-  if (tm_conf.mechanism == LPEL_MIG_WAIT_PROP) {
+  if (tm_conf.mechanism == LPEL_MIG_WAIT_PROP && !TASK_SHARED(ct)) {
   	int target = LpelPickTargetWorker(ct);
   	if (target > 0) {
   		TaskStop(ct);
@@ -206,6 +314,7 @@ void LpelTaskYield(void)
  */
 void LpelTaskBlockStream(lpel_task_t *t)
 {
+  assert( !TASK_STACKLESS(t) );
   /* a reference to it is held in the stream */
   t->state = TASK_BLOCKED;
   LpelWorkerTaskBlock(t);
@@ -230,6 +339,34 @@ void LpelTaskUnblock( lpel_task_t *ct, lpel_task_t *blocked)
 }
 
 
+/**
+ * Block a task on a mutex or condition variable
+ */
+void LpelTaskBlock(lpel_task_t *t)
+{
+	LpelTaskBlockStream(t);
+}
+
+
+/**
+ * Wake up a task blocked by LpelTaskBlock(),
+ * possibly from outside of a task context
+ */
+void LpelTaskWakeup(lpel_task_t *t)
+{
+	workerctx_t *wc = LpelWorkerSelf();
+	lpel_task_t *ct = (wc != NULL) ? wc->current_task : NULL;
+
+	LpelWorkerTaskWakeup(ct, t);
+}
+
+/** wait record of a blocking call of t */
+void *LpelTaskWaitRecord(lpel_task_t *t)
+{
+	return t->waitrec;
+}
+
+
 /** check and migrate the current task if required, used in decen_lpel
  * to be called from snet-rts after processing one message record
  * used in random-based mechanism
@@ -241,6 +378,8 @@ void LpelTaskCheckMigrate(void) {
 	lpel_task_t *t = LpelTaskSelf();
 	if (t->worker_context->wid < 0)
 		return;		// no migrate wrapper task
+	if (TASK_STACKLESS(t) || TASK_SHARED(t))
+		return;		// stackless and shared-stack tasks are bound to their worker
 
 	assert( t->state == TASK_RUNNING );
 	int target = LpelPickTargetWorker(t);
@@ -333,6 +472,46 @@ lpel_usrdata_destructor_t LpelGetUserDataDestructor(lpel_task_t *t)
 /* PRIVATE FUNCTIONS                                                          */
 /******************************************************************************/
 
+/**
+ * Initialize the fields common to all kinds of tasks
+ */
+static void InitTask( lpel_task_t *t, int worker, void *inarg)
+{
+	/* obtain a usable worker context */
+	t->worker_context = LpelWorkerGetContext(worker);
+
+	t->sched_info.prio = 0;
+	t->fpstate = 0;
+
+	t->uid = atomic_fetch_add( &taskseq, 1);  /* obtain a unique task id */
+	t->inarg = inarg;
+
+	/* initialize poll token to 0 */
+	atomic_init( &t->poll_token, 0);
+
+	t->state = TASK_CREATED;
+
+	t->prev = t->next = NULL;
+
+	t->mon = NULL;
+	t->usrdata = NULL;
+	t->usrdt_destr = NULL;
+
+	t->recfunc = NULL;
+	t->rec_stream = NULL;
+	t->rec_in = NULL;
+	t->rec_resume = 0;
+	t->rec_item = NULL;
+	t->rec_full = NULL;
+
+	t->shared = 0;
+	t->stk_sp = NULL;
+	t->stk_save = NULL;
+	t->stk_used = 0;
+	t->stk_cap = 0;
+}
+
+
 /**
  * Startup function for user specified task,
  * calls task function with proper signature
@@ -366,6 +545,133 @@ static void TaskStartup( void *data)
 }
 
 
+/**
+ * Run a stackless task on the stack of its worker
+ *
+ * Records are processed until the input stream is empty, the batch is
+ * done or the time slice is used up, or the record function terminates
+ * the task. The task is left blocked, ready or finished, respectively.
+ * If the record function finds an output stream full, the task blocks
+ * on that stream instead, and gets the same item again afterwards.
+ *
+ * @param t   the stackless task, the current task of the worker
+ */
+void LpelTaskRunStackless( lpel_task_t *t)
+{
+  void *item;
+  int n = 0, res;
+
+  TaskStart( t);
+
+  /* the stream is opened within the task */
+  if (t->rec_in == NULL) {
+    t->rec_in = LpelStreamOpen( t->rec_stream, 'r');
+  }
+  if (t->rec_item != NULL) {
+    /* woken up on the full output stream */
+    (void) LpelStreamSpaceOrWait( t->rec_full, 1);
+  }
+
+  while (1) {
+    if (t->rec_item != NULL) {
+      item = t->rec_item;
+      t->rec_item = NULL;
+    } else {
+      item = LpelStreamReadOrWait( t->rec_in, t->rec_resume);
+      t->rec_resume = 0;
+      if (item == NULL) {
+        /* registered on the stream, the writer wakes the task up */
+        t->rec_resume = 1;
+        t->state = TASK_BLOCKED;
+        LpelWorkerTaskBlock(t);
+        break;
+      }
+    }
+
+    t->rec_full = NULL;
+    res = t->recfunc( item, t->inarg);
+    if (res == LPEL_REC_RETRY) {
+      assert( t->rec_full != NULL);
+      t->rec_item = item;
+      if (!LpelStreamSpaceOrWait( t->rec_full, 0)) {
+        /* registered on the stream, the reader wakes the task up */
+        t->state = TASK_BLOCKED;
+        LpelWorkerTaskBlock(t);
+        break;
+      }
+      continue;   /* space has been freed meanwhile */
+    }
+    if (res) {
+      LpelStreamClose( t->rec_in, 1);
+      if (t->usrdt_destr && t->usrdata) {
+        t->usrdt_destr (t, t->usrdata);
+      }
+      t->state = TASK_ZOMBIE;
+      LpelWorkerSelfTaskExit(t);
+      break;
+    }
+
+    if (++n == LPEL_STACKLESS_BATCH || LpelTaskShouldYield()) {
+      t->state = TASK_READY;
+      LpelWorkerSelfTaskYield(t);
+      break;
+    }
+  }
+
+  TaskStop( t);
+}
+
+
+/**
+ * Copy the used part of the shared stack out of the way of another task
+ *
+ * The used part starts at the stack pointer saved by the context switch,
+ * or, if the back-end does not tell it, TASK_STACK_SLACK below the frame
+ * of the dispatcher the task was suspended in.
+ *
+ * @param t     suspended shared-stack task
+ * @param top   upper end of the shared stack
+ */
+void LpelTaskStackOut( lpel_task_t *t, char *top)
+{
+  size_t used;
+
+#ifdef MCTX_HAVE_SP
+  t->stk_sp = mctx_sp( &t->mctx);
+#endif
+  assert( t->stk_sp < top && t->stk_sp >= top - LPEL_SHARED_STACK_SIZE );
+  used = top - t->stk_sp;
+
+  /* keep the buffer right-sized, the depth of a task is mostly stable */
+  if (used > t->stk_cap || used < t->stk_cap / 4) {
+    free(t->stk_save);
+    t->stk_cap = (used + TASK_STACK_ALIGN-1) & ~(TASK_STACK_ALIGN-1);
+    t->stk_save = (char *) malloc( t->stk_cap);
+  }
+  memcpy( t->stk_save, t->stk_sp, used);
+  t->stk_used = used;
+}
+
+
+/**
+ * Place a shared-stack task on the shared stack before it is resumed
+ *
+ * On its first run the context of the task is created on the stack,
+ * afterwards the copy made by LpelTaskStackOut() is put back in place.
+ */
+void LpelTaskStackIn( lpel_task_t *t, char *stack, size_t size)
+{
+  if (t->stk_sp == NULL) {
+    /* leave the topmost bytes to the initial frame */
+    mctx_create( &t->mctx, TaskStartup, (void*)t, stack, size - 64);
+    if (t->fpstate) mctx_init_fp( &t->mctx);
+  } else {
+    assert( t->stk_sp >= stack && t->stk_sp + t->stk_used == stack + size );
+    memcpy( t->stk_sp, t->stk_save, t->stk_used);
+  }
+}
+
+
 void TaskStart( lpel_task_t *t)
 {
 	assert( t->state == TASK_READY );
@@ -377,6 +683,7 @@ void TaskStart( lpel_task_t *t)
 	}
 #endif
 
+	LpelTimesliceDispatch();
 	t->state = TASK_RUNNING;
 }
 
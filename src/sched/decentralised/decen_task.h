@@ -2,10 +2,12 @@
 #define _TASK_H_
 
 
+#include <stddef.h>
 #include <lpel.h>
 #include "arch/mctx.h"
 #include "arch/atomic.h"
 #include "decen_scheduler.h"
+#include "lpel_main.h"
 
 
 /**
@@ -17,6 +19,30 @@
 #define TASK_STACK_ALIGN  256
 #define TASK_MINSIZE  4096
 
+/* records a stackless task processes before it yields */
+#ifndef LPEL_STACKLESS_BATCH
+#define LPEL_STACKLESS_BATCH  64
+#endif
+
+/* stackless tasks are run by a call on the stack of the worker */
+#define TASK_STACKLESS(t)  ((t)->recfunc != NULL)
+
+/* size of the stack a worker shares among its shared-stack tasks */
+#ifndef LPEL_SHARED_STACK_SIZE
+#define LPEL_SHARED_STACK_SIZE  (256*1024)
+#endif
+
+/* room for the context switch below the frame of the dispatcher, for
+ * context back-ends which do not tell the saved stack pointer
+ * (MCTX_HAVE_SP); the others copy out from that pointer */
+#define TASK_STACK_SLACK  256
+
+/* task runs on the shared stack of its worker */
+#define TASK_SHARED(t)  ((t)->shared)
+
+/* flag for mctx_switch_fp() if the task keeps its FP control state */
+#define TASK_FP(t, flag)  ((t)->fpstate ? (flag) : 0)
+
 
 struct workerctx_t;
 struct mon_task_t;
@@ -50,6 +76,25 @@ struct lpel_task_t {
   lpel_taskfunc_t func; /** function of the task */
   void *inarg;          /** input argument  */
   void *outarg;         /** output argument  */
+  int fpstate;          /** FP control state is kept across switches */
+
+  /* STACKLESS TASKS */
+  lpel_recfunc_t recfunc;           /** record function, NULL if stackful */
+  lpel_stream_t *rec_stream;        /** input stream */
+  struct lpel_stream_desc_t *rec_in;  /** opened on the first run */
+  int rec_resume;                   /** woken up on the input stream */
+  void *rec_item;                   /** item to be delivered again, or NULL */
+  struct lpel_stream_desc_t *rec_full;  /** output found full by TryWrite */
+
+  /* SHARED STACK */
+  int shared;           /** runs on the shared stack of its worker */
+  char *stk_sp;         /** lowest address in use when suspended */
+  char *stk_save;       /** used part of the stack, while swapped out */
+  size_t stk_used;      /** bytes in stk_save */
+  size_t stk_cap;       /** capacity of stk_save */
+
+  /** see LpelTaskWaitRecord() */
+  void *waitrec[LPEL_TASK_WAITREC_SIZE / sizeof(void *)];
   
   /* user data */
   void *usrdata;
@@ -63,6 +108,9 @@ struct lpel_task_t {
 void LpelTaskDestroy( lpel_task_t *t);
 void LpelTaskBlockStream( lpel_task_t *ct);
 void LpelTaskUnblock( lpel_task_t *ct, lpel_task_t *blocked);
+void LpelTaskRunStackless( lpel_task_t *t);
+void LpelTaskStackOut( lpel_task_t *t, char *top);
+void LpelTaskStackIn( lpel_task_t *t, char *stack, size_t size);
 
 
 
@@ -26,6 +26,7 @@
 #include "decen_scheduler.h"
 #include "workermsg.h"
 #include "task_migration.h"
+#include "timeslice.h"
 
 #define WORKER_PTR(i) (workers[(i)])
 
@@ -52,7 +53,10 @@ static void *WorkerThread( void *arg);
 
 
 static void FetchAllMessages( workerctx_t *wc);
+static void ExpireTimers( workerctx_t *wc);
+static void WakeupFdWaiters( workerctx_t *wc);
 static void CleanupTaskContext(workerctx_t *wc, lpel_task_t *t);
+static void LoadSharedStack(workerctx_t *wc, lpel_task_t *t);
 
 
 
@@ -140,7 +144,10 @@ void LpelWorkersInit(int size)
 
     wc->sched = LpelSchedCreate( i);
     wc->wraptask = NULL;
+    wc->runnext = NULL;
     wc->migrated = NULL;
+    wc->shstack = NULL;
+    wc->shstack_owner = NULL;
 
 #ifdef USE_LOGGING
 
@@ -155,6 +162,8 @@ void LpelWorkersInit(int size)
 
     /* mailbox */
     wc->mailbox = LpelMailboxCreate();
+    wc->timers = LpelTimerWheelCreate();
+    wc->fds = LpelFdPollCreate();
 
     /* taskqueue of free tasks */
     //LpelTaskqueueInit( &wc->free_tasks);
@@ -183,12 +192,16 @@ void LpelWorkersCleanup(void)
   for( i=0; i<num_workers; i++) {
     wc = WORKER_PTR(i);
     LpelMailboxDestroy(wc->mailbox);
+    LpelTimerWheelDestroy(wc->timers);
+    LpelFdPollDestroy(wc->fds);
     LpelSchedDestroy( wc->sched);
+    free(wc->shstack);
     free(wc);
   }
 
   /* free workers table */
   free( workers);
+  workers = NULL;
 
   /* cleanup spmdext module */
   LpelSpmdCleanup();
@@ -229,6 +242,15 @@ lpel_task_t *LpelWorkerCurrentTask(void)
 }
 
 
+#ifndef MCTX_HAVE_SP
+/* an address below the stack frame of the caller */
+static char * __attribute__((noinline)) StackMark(void)
+{
+  return (char *) __builtin_frame_address(0);
+}
+#endif
+
+
 /**
  * Dispatch next ready task
  *
@@ -255,29 +277,50 @@ void LpelWorkerDispatcher( lpel_task_t *t)
      * also newly arrived READY tasks
      */
     FetchAllMessages( wc);
+    ExpireTimers( wc);
+    WakeupFdWaiters( wc);
 
     /* before executing a task, handle all pending requests! */
     LpelSpmdHandleRequests(wc->wid);
 
     next = LpelSchedFetchReady( wc->sched);
+
+    /* the frames of a shared-stack task stay in place,
+     * they are only copied out when another task needs the stack */
+#ifndef MCTX_HAVE_SP
+    if (TASK_SHARED(t)) {
+      t->stk_sp = StackMark() - TASK_STACK_SLACK;
+    }
+#endif
+
     if (next != NULL) {
       /* short circuit */
       if (next==t) { return; }
 
-      /* execute task */
-      wc->current_task = next;
-      mctx_switch(&t->mctx, &next->mctx); /*SWITCH*/
+      if (TASK_STACKLESS(next)
+          || (TASK_SHARED(next) && wc->shstack_owner != next)) {
+        /* has no context, or its stack has to be put in place;
+         * both is done by the worker loop */
+        wc->runnext = next;
+        wc->current_task = NULL;
+        mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD)); /*SWITCH*/
+      } else {
+        /* execute task */
+        wc->current_task = next;
+        mctx_switch_fp(&t->mctx, &next->mctx,
+            TASK_FP(t, MCTX_FP_OLD) | TASK_FP(next, MCTX_FP_NEW)); /*SWITCH*/
+      }
     } else {
       /* no ready task! -> back to worker context */
       wc->current_task = NULL;
-      mctx_switch(&t->mctx, &wc->mctx); /*SWITCH*/
+      mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD)); /*SWITCH*/
     }
   } else {
     /* we are on a wrapper.
      * back to wrapper context
      */
     wc->current_task = NULL;
-    mctx_switch(&t->mctx, &wc->mctx); /*SWITCH*/
+    mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD)); /*SWITCH*/
     /* nothing to finalize on a wrapper */
   }
   /*********************************
@@ -307,7 +350,9 @@ void LpelWorkersSpawn(void)
 void LpelWorkerMakeTaskReady(lpel_task_t *t) {
 	assert(t->state == TASK_READY);
 	workerctx_t *wc = t->worker_context;
-	if (tm_conf.mechanism == LPEL_MIG_WAIT_PROP){
+	/* stackless and shared-stack tasks are bound to their worker */
+	if (tm_conf.mechanism == LPEL_MIG_WAIT_PROP
+			&& !TASK_STACKLESS(t) && !TASK_SHARED(t)) {
 		int target = LpelPickTargetWorker(t);
 		if (target > 0 && target != wc->wid) {
 			t->worker_context = LpelWorkerGetContext(target);
@@ -399,9 +444,15 @@ workerctx_t *LpelWorkerGetContext(int id) {
     /* Wrapper is excluded from scheduling module */
     wc->sched = NULL;
     wc->wraptask = NULL;
+    wc->runnext = NULL;
+    wc->shstack = NULL;
+    wc->shstack_owner = NULL;
     wc->mon = NULL;
     /* mailbox */
     wc->mailbox = LpelMailboxCreate();
+    wc->timers = LpelTimerWheelCreate();
+    /* a wrapper blocks on descriptors itself */
+    wc->fds = NULL;
     /* taskqueue of free tasks */
     //LpelTaskqueueInit( &wc->free_tasks);
     (void) pthread_create( &wc->thread, NULL, WorkerThread, wc);
@@ -456,16 +507,58 @@ void LpelWorkerSelfTaskMigrate(lpel_task_t *t, int target) {
 	t->worker_context = LpelWorkerGetContext(target);
 	wc->migrated = t;
 	/* switch back to worker context to migrate task, shouldn't migrate the task itself in the task's context */
-	mctx_switch(&t->mctx, &wc->mctx); /* SWITCH */
+	mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD)); /* SWITCH */
 }
 
 void LpelWorkerTaskBlock(lpel_task_t *t) {}
 
+/** the timer wheel of the current worker or wrapper */
+timerwheel_t *LpelWorkerTimerWheel(void)
+{
+  workerctx_t *wc = GetCurrentWorker();
+  return (wc != NULL) ? wc->timers : NULL;
+}
+
+/** the descriptor poller of the current worker, NULL on wrappers */
+fdpoll_t *LpelWorkerFdPoll(void)
+{
+  workerctx_t *wc = GetCurrentWorker();
+  return (wc != NULL) ? wc->fds : NULL;
+}
+
+/** collect the workers on the socket of the current worker */
+int LpelWorkerSocketSet(int *workers)
+{
+  workerctx_t *wc = GetCurrentWorker();
+  int socket, i, n = 0;
+  assert(wc != NULL && wc->wid >= 0);
+
+  /* workers are assigned to the core of their id */
+  socket = LpelHwLocSocket(wc->wid);
+  for (i=0; i<num_workers; i++) {
+    if (socket < 0 || LpelHwLocSocket(i) == socket) {
+      workers[n++] = i;
+    }
+  }
+  return n;
+}
+
 /** return the total number of workers */
 int LpelWorkerCount(void)
 {
   return num_workers;
 }
+
+int LpelWorkerQueueDepth(int wid, int *ready, int *mbox, int *mbox_peak)
+{
+  workerctx_t *wc;
+
+  if (wid < 0 || wid >= num_workers || workers == NULL) return -1;
+  wc = WORKER_PTR(wid);
+  *ready = LpelSchedQueueSize( wc->sched);
+  *mbox = LpelMailboxDepth( wc->mailbox, mbox_peak);
+  return 0;
+}
 /******************************************************************************/
 /*  PRIVATE FUNCTIONS                                                         */
 /******************************************************************************/
@@ -478,6 +571,9 @@ static void CleanupTaskContext(workerctx_t *wc, lpel_task_t *t)
   /* delete task marked before */
   if (wc->marked_del != NULL) {
     //LpelMonDebug( wc->mon, "Destroy task %d\n", wc->marked_del->uid);
+    if (wc->marked_del == wc->shstack_owner) {
+      wc->shstack_owner = NULL;
+    }
     LpelTaskDestroy( wc->marked_del);
     wc->marked_del = NULL;
   }
@@ -490,6 +586,28 @@ static void CleanupTaskContext(workerctx_t *wc, lpel_task_t *t)
 
 
 
+/**
+ * Put a shared-stack task in place on the shared stack of the worker,
+ * copying out the suspended task occupying it
+ */
+static void LoadSharedStack(workerctx_t *wc, lpel_task_t *t)
+{
+  lpel_task_t *owner = wc->shstack_owner;
+
+  if (owner == t) return;
+
+  if (wc->shstack == NULL) {
+    wc->shstack = (char *) valloc( LPEL_SHARED_STACK_SIZE);
+  }
+  if (owner != NULL) {
+    assert( owner->state != TASK_ZOMBIE);
+    LpelTaskStackOut( owner, wc->shstack + LPEL_SHARED_STACK_SIZE);
+  }
+  LpelTaskStackIn( t, wc->shstack, LPEL_SHARED_STACK_SIZE);
+  wc->shstack_owner = t;
+}
+
+
 static void ProcessMessage( workerctx_t *wc, workermsg_t *msg)
 {
   lpel_task_t *t;
@@ -573,6 +691,8 @@ static void ProcessMessage( workerctx_t *wc, workermsg_t *msg)
 static void WaitForNewMessage( workerctx_t *wc)
 {
   workermsg_t msg;
+  struct timespec deadline;
+  int timed, received = 1;
 
 #ifdef USE_LOGGING
   if (wc->mon && MON_CB(worker_waitstart)) {
@@ -580,7 +700,20 @@ static void WaitForNewMessage( workerctx_t *wc)
   }
 #endif
 
-  LpelMailboxRecv(wc->mailbox, &msg);
+  /* do not sleep beyond the next timer */
+  timed = LpelTimerWheelNext(wc->timers, &deadline);
+
+  if (wc->fds != NULL && LpelFdPollCount(wc->fds) > 0
+      && LpelMailboxArmNotify(wc->mailbox, LpelFdPollNotifyFd(wc->fds))) {
+    /* tasks wait for descriptors, a message interrupts the poll */
+    LpelFdPollWait(wc->fds, timed ? &deadline : NULL);
+    LpelMailboxDisarmNotify(wc->mailbox);
+    received = 0;
+  } else if (timed) {
+    received = LpelMailboxRecvTimed(wc->mailbox, &msg, &deadline);
+  } else {
+    LpelMailboxRecv(wc->mailbox, &msg);
+  }
 
 #ifdef USE_LOGGING
   if (wc->mon && MON_CB(worker_waitstop)) {
@@ -588,7 +721,7 @@ static void WaitForNewMessage( workerctx_t *wc)
   }
 #endif
 
-  ProcessMessage( wc, &msg);
+  if (received) ProcessMessage( wc, &msg);
 }
 
 
@@ -602,6 +735,39 @@ static void FetchAllMessages( workerctx_t *wc)
 }
 
 
+/**
+ * Wake up the tasks whose timers have expired
+ */
+static void ExpireTimers( workerctx_t *wc)
+{
+  lpel_task_t *t;
+  while( (t = LpelTimerWheelExpire(wc->timers)) != NULL) {
+    WORKER_DBGMSG(wc, "Timer expired for %d.\n", t->uid);
+    if (wc->wid < 0) {
+      assert(t->state == TASK_BLOCKED);
+      t->state = TASK_READY;
+      wc->wraptask = t;
+    } else {
+      LpelWorkerTaskWakeupLocal(wc, t);
+    }
+  }
+}
+
+
+/**
+ * Wake up the tasks whose descriptors have become ready
+ */
+static void WakeupFdWaiters( workerctx_t *wc)
+{
+  lpel_task_t *t;
+  if (wc->fds == NULL) return;
+  while( (t = LpelFdPollReady(wc->fds)) != NULL) {
+    WORKER_DBGMSG(wc, "Descriptor ready for %d.\n", t->uid);
+    LpelWorkerTaskWakeupLocal(wc, t);
+  }
+}
+
+
 /**
  * Worker loop
  */
@@ -613,11 +779,22 @@ static void WorkerLoop( workerctx_t *wc)
     /* before executing a task, handle all pending requests! */
     LpelSpmdHandleRequests(wc->wid);
 
-    t = LpelSchedFetchReady( wc->sched);
-    if (t != NULL) {
+    /* a stackless task might have been picked by the dispatcher */
+    t = wc->runnext;
+    wc->runnext = NULL;
+    if (t == NULL) t = LpelSchedFetchReady( wc->sched);
+
+    if (t != NULL && TASK_STACKLESS(t)) {
+      /* run the task on the stack of the worker */
+      wc->current_task = t;
+      LpelTaskRunStackless( t);
+      wc->current_task = NULL;
+      CleanupTaskContext(wc, NULL);
+    } else if (t != NULL) {
       /* execute task */
+      if (TASK_SHARED(t)) LoadSharedStack( wc, t);
       wc->current_task = t;
-      mctx_switch(&wc->mctx, &t->mctx);
+      mctx_switch_fp(&wc->mctx, &t->mctx, TASK_FP(t, MCTX_FP_NEW));
       /* task switch back to worker, migrate task if required */
       if (wc->migrated) {
       	SendAssign(wc->migrated->worker_context, wc->migrated);			/* MIGRATE */
@@ -635,6 +812,8 @@ static void WorkerLoop( workerctx_t *wc)
     }
     /* fetch (remaining) messages */
     FetchAllMessages( wc);
+    ExpireTimers( wc);
+    WakeupFdWaiters( wc);
   } while ( !( 0==wc->num_tasks && wc->terminate) );
   //} while ( !wc->terminate);
 
@@ -651,7 +830,7 @@ static void WrapperLoop( workerctx_t *wc)
       /* execute task */
       wc->current_task = t;
       wc->wraptask = NULL;
-      mctx_switch(&wc->mctx, &t->mctx);
+      mctx_switch_fp(&wc->mctx, &t->mctx, TASK_FP(t, MCTX_FP_NEW));
 
     } else {
       /* no ready tasks */
@@ -659,6 +838,8 @@ static void WrapperLoop( workerctx_t *wc)
     }
     /* fetch (remaining) messages */
     FetchAllMessages( wc);
+    ExpireTimers( wc);
+    WakeupFdWaiters( wc);
   } while ( !wc->terminate);
 
   /* cleanup task context marked for deletion */
@@ -698,7 +879,9 @@ static void *WorkerThread( void *arg)
 
   /*******************************************************/
   if ( wc->wid >= 0) {
+    LpelTimesliceThreadStart();
     WorkerLoop( wc);
+    LpelTimesliceThreadStop();
   } else {
     WrapperLoop( wc);
   }
@@ -723,6 +906,7 @@ static void *WorkerThread( void *arg)
   if (wc->wid < 0) {
     /* clean up the mailbox for the worker */
     LpelMailboxDestroy(wc->mailbox);
+    LpelTimerWheelDestroy(wc->timers);
 
     /* free the worker context */
     free( wc);
@@ -8,6 +8,8 @@
 #include "arch/mctx.h"
 #include "decen_task.h"
 #include "mailbox.h"
+#include "timerwheel.h"
+#include "fdpoll.h"
 
 
 typedef struct workerctx_t workerctx_t;
@@ -42,8 +44,13 @@ struct workerctx_t {
   lpel_task_t  *marked_del;
   mon_worker_t *mon;
   mailbox_t    *mailbox;
+  timerwheel_t *timers;
+  fdpoll_t     *fds;            /* NULL for wrappers */
   schedctx_t   *sched;
   lpel_task_t  *wraptask;
+  lpel_task_t  *runnext;        /* task picked by the dispatcher */
+  char         *shstack;        /* stack shared by shared-stack tasks */
+  lpel_task_t  *shstack_owner;  /* task whose frames are on shstack */
   char          padding[64];
   lpel_task_t	 *migrated;
 };
@@ -1,76 +1,119 @@
 
+#include <assert.h>
+
 #include "decen_task.h"
 #include "decen_worker.h"
-#include <sys/time.h>
+
+
+/* number of cycles a waiting task spins before it is blocked, 0 = no spin */
+static unsigned long spin_cycles = 0;
+
+
+/**
+ * Cheap cycle counter for the spin phase;
+ * without a time stamp counter, spin iterations are counted instead
+ */
+static inline unsigned long Cycles(unsigned long iter)
+{
+#if defined(__i386__) || defined(__x86_64__)
+  unsigned int lo, hi;
+  (void) iter;
+  __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((unsigned long long) hi << 32) | lo;
+#else
+  return iter;
+#endif
+}
+
+
+/**
+ * Set the number of cycles a task spins on a busy semaphore before it
+ * is blocked (default 0: block immediately)
+ */
+void LpelBiSemaSetSpin(unsigned long cycles)
+{
+  spin_cycles = cycles;
+}
 
 
 /** Initialize a binary semaphore. It is signalled by default. */
 void LpelBiSemaInit(lpel_bisema_t *sem)
 {
+  sem->head = sem->tail = NULL;
+  atomic_spin_unlock(&sem->lock);
   __sync_lock_release(&sem->counter);
 }
 
 /** Destroy a semaphore */
 void LpelBiSemaDestroy(lpel_bisema_t *sem)
 {
-  /*NOP*/
+  assert(sem->head == NULL);
 }
 
 /** Wait on the semaphore */
 void LpelBiSemaWait(lpel_bisema_t *sem)
 {
-  struct timeval start_tv, current_tv;
-  int looping = 0;
+  lpel_task_t *t;
 
   /* __sync_lock_test_and_set is an atomic exchange.
-   *  It writes value into *ptr, and returns the previous contents of *ptr.
-   * Hence, the while loop is executed as long as the previous value in the
-   * counter has been 1 (non-signalled).
+   * It writes value into *ptr, and returns the previous contents of *ptr.
+   * The semaphore is taken if the previous value was 0 (signalled).
    */
-  while (1 == __sync_lock_test_and_set(&sem->counter,1)) {
-    /* Throttle LPEL task re-scheduling to max 1000 times per sec.
-     * Rationale: Binary semaphores are used in SAC to implement fast barriers.
-     * Ideally there shouldn't be other tasks on those workers that run SAC bees.
-     * The need for task rescheduling on these dedicated workers is very low.
-     * Therefore, to optimize overheads this function will try to re-schedule
-     * the LPEL worker at most once per 1 milisecond.
-     */
-    if (!looping) {
-      /* the first cycle */
-      gettimeofday(&start_tv, NULL);
-      looping = 1;
-    } else {
-      /* not the first cycle; determine the current time */
-      gettimeofday(&current_tv, NULL);    /* this takes roughly hundreds of nanoseconds */
-      /* has elapsed more than, say, roughly 1 ms? */
-      int yeah = 0;
-      long sec_diff = current_tv.tv_sec - start_tv.tv_sec;
-      if (sec_diff != 0) {
-        yeah = 1;
-      } else {
-        long usec_diff = current_tv.tv_usec - start_tv.tv_usec;
-        if (usec_diff > 1000) {
-          yeah = 1;
-        }
-      }
-
-      if (yeah) {
-        start_tv = current_tv;
-        /* re-schedule another task */
-        lpel_task_t *t = LpelTaskSelf();
-        t->state = TASK_READY;
-        LpelWorkerSelfTaskYield(t);
-        TaskStop(t);
-        LpelWorkerDispatcher(t);
-        TaskStart(t);
-      }
-    }
+  if (0 == __sync_lock_test_and_set(&sem->counter, 1)) return;
+
+  /* optional spin phase, for dedicated workers (e.g. SAC barriers) */
+  if (spin_cycles > 0) {
+    unsigned long iter = 0;
+    unsigned long start = Cycles(iter);
+    do {
+      atomic_cpu_relax();
+      if (sem->counter == 0
+          && 0 == __sync_lock_test_and_set(&sem->counter, 1)) return;
+    } while (Cycles(++iter) - start < spin_cycles);
+  }
+
+  t = LpelTaskSelf();
+  assert(t->state == TASK_RUNNING);
+
+  atomic_spin_lock(&sem->lock);
+  /* the semaphore might have been signalled meanwhile */
+  if (0 == __sync_lock_test_and_set(&sem->counter, 1)) {
+    atomic_spin_unlock(&sem->lock);
+    return;
   }
+  /* append to the waiter queue */
+  t->next = NULL;
+  if (sem->tail) sem->tail->next = t;
+  else sem->head = t;
+  sem->tail = t;
+  atomic_spin_unlock(&sem->lock);
+
+  /* the worker runs other tasks, the signalling task hands the semaphore
+   * over to us, i.e. the counter stays non-signalled
+   */
+  LpelTaskBlockStream(t);
 }
 
 /** Signal the semaphore, possibly releasing a waiting task. */
 void LpelBiSemaSignal(lpel_bisema_t *sem)
 {
-  /* This simply writes 0 */
-  __sync_lock_release(&sem->counter);
+  lpel_task_t *w;
+
+  atomic_spin_lock(&sem->lock);
+  w = sem->head;
+  if (w != NULL) {
+    sem->head = w->next;
+    if (sem->head == NULL) sem->tail = NULL;
+  } else {
+    /* no waiter, this simply writes 0 */
+    __sync_lock_release(&sem->counter);
+  }
+  atomic_spin_unlock(&sem->lock);
+
+  /* wake exactly one waiter, which now owns the semaphore;
+   * the signaller need not be a task */
+  if (w != NULL) {
+    w->next = NULL;
+    LpelTaskWakeup(w);
+  }
 }
@@ -1,10 +1,15 @@
 
 #include <stdlib.h>
 #include <assert.h>
+#include <limits.h>
+#include <sched.h>
+#include <pthread.h>
 
-//FIXME check availability
-#include <semaphore.h>
-
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 
 #include "spmdext.h"
 
@@ -13,27 +18,63 @@
 #include "decen_worker.h"
 
 
+/* fan-in of the combining tree for the arrival phase of the barriers */
+#ifndef SPMD_TREE_FANIN
+#define SPMD_TREE_FANIN  4
+#endif
+
+/* number of spins before a waiting worker goes to sleep */
+#ifndef SPMD_SPIN_COUNT
+#define SPMD_SPIN_COUNT  2000
+#endif
+
 /****************************************************************************/
 
 /* internal type definitions */
 
 
+/*
+ * The futex based waiting needs plain ints,
+ * hence the barrier counters are updated with the gcc builtins.
+ */
+typedef struct {
+  /* number of children in the tree arrived, per barrier (start/stop) */
+  volatile int arrived[2];
+  /* owner is (about to go) sleeping on arrived */
+  volatile int sleeping[2];
+  char padding[64-4*sizeof(int)];
+} spmd_node_t;
+
+#define BARRIER_START  0
+#define BARRIER_STOP   1
+
 
 typedef struct {
   workerctx_t *wctx;     /* requesting worker */
   lpel_spmdfunc_t func;
   void *arg;
   lpel_task_t *task; /* requesting task */
+  int size;          /* number of participating workers */
+  int *members;      /* worker ids by virtual id, members[0] is the requester */
+  int *vids;         /* virtual ids by worker id, -1 if not participating */
+  spmd_node_t *nodes;    /* barrier tree nodes by virtual id */
+  volatile int release_sense;    /* incremented to release the start barrier */
+  volatile int release_sleepers;
 } spmdreq_t;
 
 
 
 typedef struct {
-  sem_t sema;
-  spmdreq_t *curreq; /* pointer to local copy of
-                         the current request on the stack */
+  /* requests this worker takes part in, in global order;
+   * a ring of num_workers entries, as each worker has at most
+   * one request pending
+   */
+  spmdreq_t **queue;
+  volatile unsigned int qhead; /* only modified by the owner */
+  volatile unsigned int qtail; /* only modified under submit_lock */
+  spmdreq_t *curreq; /* the request currently executed */
   int pending;
-  int padding[7];
+  char padding[64-sizeof(spmdreq_t**)-2*sizeof(int)-sizeof(spmdreq_t*)-sizeof(int)];
 } spmd_worker_t;
 
 
@@ -47,44 +88,130 @@ static int num_workers = -1;
 /** worker specific data */
 static spmd_worker_t *worker_data = NULL;
 
+/** request slots, one per requesting worker */
+static spmdreq_t *requests = NULL;
 
 /**
- * array for the request queue
- * note that a fixed queue size of num_workers is sufficient
+ * requests are appended to the queues of all their participants atomically,
+ * so that overlapping requests are handled in the same order by all workers
  */
-static spmdreq_t *req_queue = NULL;
-
-static atomic_int qhead = ATOMIC_VAR_INIT(0);
-static atomic_int qtail = ATOMIC_VAR_INIT(0);
+static pthread_mutex_t submit_lock;
 
 
 
 /****************************************************************************/
 
-static inline int GetVId(int self_id, int master_id) {
-  int vid = master_id - self_id;
-  return (vid < 0) ? vid+num_workers : vid;
+static inline int NumChildren(spmdreq_t *req, int vid) {
+  int first = SPMD_TREE_FANIN * vid + 1;
+  if (first >= req->size) return 0;
+  return (req->size - first < SPMD_TREE_FANIN) ?
+    req->size - first : SPMD_TREE_FANIN;
+}
+
+static inline void FutexWait(volatile int *addr, int val)
+{
+#ifdef __linux__
+  (void) syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+#else
+  (void) addr; (void) val;
+  sched_yield();
+#endif
+}
+
+static inline void FutexWake(volatile int *addr, int num)
+{
+#ifdef __linux__
+  (void) syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, num, NULL, NULL, 0);
+#else
+  (void) addr; (void) num;
+#endif
+}
+
+/**
+ * Wait while *addr == val, spin first, then sleep on the futex.
+ * The waker has to call FutexWake if *sleeping is set after changing *addr.
+ */
+static void WaitWhile(volatile int *addr, int val, volatile int *sleeping)
+{
+  int i;
+  for (i=0; i<SPMD_SPIN_COUNT; i++) {
+    if (*addr != val) return;
+    atomic_cpu_relax();
+  }
+  while (*addr == val) {
+    __sync_fetch_and_add(sleeping, 1);
+    /* recheck after announcing, the waker might have missed us otherwise */
+    if (*addr == val) FutexWait(addr, val);
+    __sync_fetch_and_sub(sleeping, 1);
+  }
+}
+
+/**
+ * Arrival phase of a barrier: combine the arrivals of the subtree rooted
+ * at virtual id vid and report them to the parent.
+ * The requester (virtual id 0) is the root of the tree.
+ *
+ * The nodes belong to the request, start and stop barrier count
+ * separately, hence no arrivals of different barriers can get mixed up.
+ *
+ * @return 1 if all workers have arrived (only at the root), 0 otherwise
+ */
+static int BarrierArrive(spmdreq_t *req, int vid, int which)
+{
+  spmd_node_t *self = &req->nodes[vid];
+  int nchild = NumChildren(req, vid);
+  int cnt;
+
+  /* wait for the children */
+  while ((cnt = self->arrived[which]) < nchild) {
+    WaitWhile(&self->arrived[which], cnt, &self->sleeping[which]);
+  }
+  __sync_fetch_and_sub(&self->arrived[which], nchild);
+
+  if (vid == 0) return 1;
+
+  /* report to the parent */
+  spmd_node_t *parent = &req->nodes[(vid-1) / SPMD_TREE_FANIN];
+  __sync_fetch_and_add(&parent->arrived[which], 1);
+  if (parent->sleeping[which]) FutexWake(&parent->arrived[which], 1);
+  return 0;
 }
 
 /****************************************************************************/
 
 int LpelSpmdInit(int numworkers)
 {
-  int i;
+  int i, j;
   assert(numworkers > 0);
   num_workers = numworkers;
 
-  /* allocate request queue */
-  req_queue = malloc(num_workers * sizeof(spmdreq_t));
+  pthread_mutex_init(&submit_lock, NULL);
+
+  /* allocate request slots */
+  requests = malloc(num_workers * sizeof(spmdreq_t));
   for (i=0; i<num_workers; i++) {
-    req_queue[i].wctx = NULL; /* initialize to invalid worker id */
+    spmdreq_t *req = &requests[i];
+    req->wctx = NULL;
+    req->size = 0;
+    req->members = malloc(num_workers * sizeof(int));
+    req->vids = malloc(num_workers * sizeof(int));
+    req->nodes = malloc(num_workers * sizeof(spmd_node_t));
+    for (j=0; j<num_workers; j++) {
+      req->vids[j] = -1;
+      req->nodes[j].arrived[BARRIER_START] = req->nodes[j].arrived[BARRIER_STOP] = 0;
+      req->nodes[j].sleeping[BARRIER_START] = req->nodes[j].sleeping[BARRIER_STOP] = 0;
+    }
+    req->release_sense = 0;
+    req->release_sleepers = 0;
   }
 
   /* allocate private worker data */
   worker_data = malloc(num_workers * sizeof(spmd_worker_t));
   for (i=0; i<num_workers; i++) {
     spmd_worker_t *wd = &worker_data[i];
-    sem_init(&wd->sema, 0, 0);
+    wd->queue = malloc(num_workers * sizeof(spmdreq_t *));
+    wd->qhead = 0;
+    wd->qtail = 0;
     wd->curreq = NULL;
     wd->pending = 0;
   }
@@ -96,139 +223,139 @@ void LpelSpmdCleanup(void)
 {
   int i;
   for (i=0; i<num_workers; i++) {
-    spmd_worker_t *wd = &worker_data[i];
-    sem_destroy(&wd->sema);
+    free(requests[i].members);
+    free(requests[i].vids);
+    free(requests[i].nodes);
+    free(worker_data[i].queue);
   }
-  free(req_queue);
+  free(requests);
   free(worker_data);
+  pthread_mutex_destroy(&submit_lock);
 }
 
 void LpelSpmdHandleRequests(int worker_id)
 {
-	spmdreq_t curreq;
-  spmd_worker_t *master_data, *self_data;
-  int i, head, cur_worker_id;
+  spmdreq_t *req;
+  spmd_worker_t *self_data;
+  int vid, sense;
 
   assert(worker_id >= 0 && worker_id < num_workers);
+  self_data = &worker_data[worker_id];
 
-  while (1) {
-    head = atomic_load(&qhead);
-    /* local copy of current request */
-    curreq = req_queue[head];
-
-    if (curreq.wctx == NULL) {
-      /* all requests handled */
-      break;
-    };
-
-    cur_worker_id = curreq.wctx->wid;
-    assert(cur_worker_id != -1);
-
-    master_data = &worker_data[cur_worker_id];
-    self_data   = &worker_data[worker_id];
+  while (self_data->qhead != self_data->qtail) {
+    __sync_synchronize();
+    req = self_data->queue[self_data->qhead % num_workers];
+    vid = req->vids[worker_id];
+    assert(vid >= 0);
 
     /*
      * "Start-Barrier"
+     * the sense must be read before arriving, the requester
+     * cannot release before all participants have arrived
      */
-    if (cur_worker_id == worker_id) {
-      /* we are the "master" thread */
-
-      /* wait until other threads have entered the spmd */
-      for (i=0; i<num_workers-1; i++) {
-        sem_wait(&master_data->sema);
-      }
-
-      /* now master is the sole thread operating on the queue */
-      { /* CRITICAL SECTION */
-        int tail;
-        /* invalidate the head (current) in req_queue */
-        req_queue[head].wctx = NULL;
-        /* move head */
-        head = (head+1) % num_workers;
-        atomic_store(&qhead, head);
-        /* correct tail */
-        tail = atomic_load(&qtail);
-        if (tail >= num_workers) tail %= num_workers;
-        atomic_store(&qtail, tail);
-      } /* CRITICAL SECTION */
-
-      /* signal the other threads */
-      for (i=0; i<num_workers; i++) {
-        if (i != worker_id) {
-          sem_post(&worker_data[i].sema);
-        }
-      }
+    sense = req->release_sense;
+    if (BarrierArrive(req, vid, BARRIER_START)) {
+      /* we are the "master" thread, all others have entered the spmd */
+      assert(req->wctx->wid == worker_id);
+      __sync_fetch_and_add(&req->release_sense, 1);
+      if (req->release_sleepers) FutexWake(&req->release_sense, INT_MAX);
     } else {
-      /* we are NOT master, signal master, then wait */
-      sem_post(&master_data->sema);
-      sem_wait(&self_data->sema);
+      /* we are NOT master, wait for the release */
+      WaitWhile(&req->release_sense, sense, &req->release_sleepers);
     } /* End "Start-Barrier" */
 
 
-    /* set the pointer to curreq */
-    self_data->curreq = &curreq;
-
     /**********************************/
     /* EXECUTE THE REQUESTED FUNCTION */
-    {
-//      workerctx_t *wc = LpelWorkerGetContext(worker_id);
-//      WORKER_DBGMSG(wc,
-//          "Enter spmd req'd by task %u on worker %d (VId=%d).\n",
-//          curreq.task->uid, cur_worker_id,
-//          GetVId(worker_id, cur_worker_id)
-//          );
-//      curreq.func(curreq.arg);
-//      WORKER_DBGMSG(wc, "Left spmd.\n");
-    }
+    self_data->curreq = req;
+    req->func(req->arg);
+    self_data->curreq = NULL;
     /**********************************/
 
-    /* clear the pointer to curreq */
-    self_data->curreq = NULL;
+    /* done with the request, the slot may be reused after the stop barrier */
+    self_data->qhead++;
 
     /*
      * "Stop-Barrier"
+     * no release needed, only the master has to wait
      */
-    if (cur_worker_id == worker_id) {
-      /* we are the "master" thread */
-      /* wait until other threads have left the spmd */
-      for (i=0; i<num_workers-1; i++) {
-        sem_wait(&master_data->sema);
-      }
+    if (BarrierArrive(req, vid, BARRIER_STOP)) {
+      /* we are the "master" thread, all others have left the spmd */
+      lpel_task_t *task = req->task;
+      int i;
+
+      /* reset the participants for the next request of this worker */
+      for (i=0; i<req->size; i++) req->vids[req->members[i]] = -1;
 
       /* clear pending flag, now it is safe on the current worker
          to handle subsequent requests */
-      assert( 1 == master_data->pending );
-      master_data->pending = 0;
+      assert( 1 == self_data->pending );
+      self_data->pending = 0;
 
       /* now we can wakeup the task */
-      LpelWorkerTaskWakeupLocal( curreq.task->worker_context, curreq.task);
-    } else {
-      /* we are NOT master, signal master before continuing */
-      sem_post(&master_data->sema);
+      LpelWorkerTaskWakeupLocal( task->worker_context, task);
     } /* End "Stop-Barrier" */
 
-  } /* END WHILE(1) */
+  } /* END WHILE */
 }
 
 
-void LpelSpmdRequest(lpel_task_t *task, lpel_spmdfunc_t fun, void *arg)
+/**
+ * Issue a spmd request
+ *
+ * @param task      requesting task
+ * @param workers   ids of the participating workers, NULL for all workers;
+ *                  the worker of the requesting task always participates
+ * @param num       number of entries in workers
+ */
+void LpelSpmdRequest(lpel_task_t *task, lpel_spmdfunc_t fun, void *arg,
+    const int *workers, int num)
 {
-  int tail;
   spmdreq_t *req;
+  workermsg_t msg;
   workerctx_t *wc = task->worker_context;
+  int i, w;
   assert(wc != NULL && wc->wid >= 0 && wc->wid < num_workers);
 
   /* set pending flag */
   assert( 0 == worker_data[wc->wid].pending);
   worker_data[wc->wid].pending = 1;
 
-  /* append */
-  tail = atomic_fetch_add(&qtail, 1) % num_workers;
-  req = &req_queue[tail];
+  req = &requests[wc->wid];
   req->wctx = wc;
   req->func = fun;
   req->arg  = arg;
   req->task = task;
+
+  /* the requester has virtual id 0 */
+  req->size = 0;
+  req->members[req->size] = wc->wid;
+  req->vids[wc->wid] = req->size++;
+  for (i=0; i < (workers ? num : num_workers); i++) {
+    w = workers ? workers[i] : i;
+    assert(w >= 0 && w < num_workers);
+    if (req->vids[w] < 0) {
+      req->members[req->size] = w;
+      req->vids[w] = req->size++;
+    }
+  }
+
+  /* append to the queues of all participants */
+  pthread_mutex_lock(&submit_lock);
+  for (i=0; i<req->size; i++) {
+    spmd_worker_t *wd = &worker_data[req->members[i]];
+    assert(wd->qtail - wd->qhead < (unsigned int) num_workers);
+    wd->queue[wd->qtail % num_workers] = req;
+    __sync_fetch_and_add(&wd->qtail, 1);
+  }
+  pthread_mutex_unlock(&submit_lock);
+
+  /* notify the participants */
+  msg.type = WORKER_MSG_SPMDREQ;
+  msg.body.from_worker = wc->wid;
+  for (i=0; i<req->size; i++) {
+    LpelMailboxSend(LpelWorkerGetContext(req->members[i])->mailbox, &msg);
+  }
 }
 
 
@@ -238,7 +365,7 @@ void LpelSpmdRequest(lpel_task_t *task, lpel_spmdfunc_t fun, void *arg)
  */
 int LpelSpmdVId(void)
 {
-  int self_id, master_id;
+  int self_id;
   spmdreq_t *curreq;
 
   self_id = LpelWorkerSelf()->wid;
@@ -249,11 +376,24 @@ int LpelSpmdVId(void)
   assert(curreq != NULL);
 
   /* the virtual id for the master is 0,
-   * all other worker ids are shifted
-   * by the master id modulo num_workers
+   * all other participants are numbered in the order of the request
    */
-  master_id = curreq->wctx->wid;
-  return GetVId(self_id, master_id);
+  return curreq->vids[self_id];
 }
 
 
+/**
+ * Get the number of workers participating in the current spmd region
+ */
+int LpelSpmdNumWorkers(void)
+{
+  int self_id;
+  spmdreq_t *curreq;
+
+  self_id = LpelWorkerSelf()->wid;
+  assert( self_id >= 0 && self_id < num_workers );
+
+  curreq = worker_data[self_id].curreq;
+  assert(curreq != NULL);
+  return curreq->size;
+}
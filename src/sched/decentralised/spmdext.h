@@ -10,7 +10,8 @@ int  LpelSpmdInit(int num_workers);
 void LpelSpmdCleanup(void);
 
 void LpelSpmdHandleRequests(int worker_id);
-void LpelSpmdRequest(lpel_task_t *task, lpel_spmdfunc_t, void *arg);
+void LpelSpmdRequest(lpel_task_t *task, lpel_spmdfunc_t, void *arg,
+    const int *workers, int num);
 
 
 
@@ -29,6 +29,34 @@ void LpelBufferInit(buffer_t *buf, unsigned int size)
 {
   buf->head = createEntry(NULL);
   buf->tail = buf->head;
+  buf->first = buf->head;
+  buf->elemsize = 0;
+}
+
+/* an entry with room for a value behind it */
+static entry *createValueEntry(unsigned long elemsize) {
+  entry *e = (entry *) malloc(sizeof(entry) + elemsize);
+  e->data = e + 1;
+  e->next = NULL;
+  return e;
+}
+
+/**
+ * Initialize a buffer holding values instead of pointers.
+ *
+ * A value is stored in its entry. Entries are not freed by the reader:
+ * the writer recycles those the reader has passed, from first up to head,
+ * and allocates only if there are none.
+ *
+ * @param buf       pointer to buffer struct
+ * @param elemsize  size of a value in bytes
+ */
+void LpelBufferInitValue(buffer_t *buf, unsigned int elemsize)
+{
+  buf->elemsize = elemsize;
+  buf->head = createValueEntry(elemsize);
+  buf->tail = buf->head;
+  buf->first = buf->head;
 }
 
 /**
@@ -39,7 +67,18 @@ void LpelBufferInit(buffer_t *buf, unsigned int size)
  */
 void  LpelBufferCleanup(buffer_t *buf)
 {
-	 free(buf->head);
+	entry *e;
+
+	if (buf->elemsize == 0) {
+		free(buf->head);
+		return;
+	}
+	/* all entries are still linked, from first */
+	while (buf->first != NULL) {
+		e = buf->first;
+		buf->first = e->next;
+		free(e);
+	}
 }
 
 
@@ -72,6 +111,12 @@ void LpelBufferPop( buffer_t *buf)
 	if (buf->head->next == NULL)
 	    return;
 	  entry *t = buf->head;
+	  if (buf->elemsize > 0) {
+	  	/* the value has been copied out, t is left to the writer */
+	  	WMB();
+	  	buf->head = t->next;
+	  	return;
+	  }
 	  buf->head = t->next;
 	  free(t);
 }
@@ -120,6 +165,34 @@ void LpelBufferPut( buffer_t *buf, void *item)
   buf->tail = buf->tail->next;
 }
 
+/**
+ * Copy a value into the buffer
+ *
+ * @param buf   buffer to write to, initialized with LpelBufferInitValue
+ * @param val   value of elemsize bytes
+ * @pre         no concurrent writes
+ */
+void LpelBufferPutValue( buffer_t *buf, const void *val)
+{
+  entry *e;
+
+  assert( buf->elemsize > 0 );
+
+  /* the entries before head have been read */
+  if (buf->first != *(entry * volatile *) &buf->head) {
+    e = buf->first;
+    buf->first = e->next;
+    e->next = NULL;
+  } else {
+    e = createValueEntry(buf->elemsize);
+  }
+  memcpy(e->data, val, buf->elemsize);
+
+  WMB();
+  buf->tail->next = e;
+  buf->tail = e;
+}
+
 int LpelBufferIsEmpty(buffer_t *buf) {
 	return (buf->head->next == NULL);
 }
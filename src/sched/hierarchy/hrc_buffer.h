@@ -15,16 +15,20 @@ struct entry {
 struct buffer_t{
 	entry *head;
 	entry *tail;
+	entry *first;					/* oldest entry to recycle, for values */
+	unsigned long elemsize;	/* of the values, 0 for pointer items */
 };
 
 
 void  LpelBufferInit(buffer_t *buf, unsigned int size);
+void  LpelBufferInitValue(buffer_t *buf, unsigned int elemsize);
 void  LpelBufferCleanup(buffer_t *buf);
 
 void *LpelBufferTop(buffer_t *buf);
 void  LpelBufferPop(buffer_t *buf);
 int   LpelBufferIsSpace(buffer_t *buf);
 void  LpelBufferPut(buffer_t *buf, void *item);
+void  LpelBufferPutValue(buffer_t *buf, const void *val);
 int LpelBufferIsEmpty(buffer_t *buf);
 
 #endif /* _BUFFER_H_ */
@@ -12,6 +12,7 @@
 #include "hrc_worker.h"
 #include "hrc_stream.h"
 #include "lpel/monitor.h"
+#include "timerwheel.h"
 
 
 //#define _USE_STREAM_DBG__
@@ -23,6 +24,13 @@
 #endif
 
 static atomic_int stream_seq = ATOMIC_VAR_INIT(0);
+static int middle_credit = 0;		/* default credits of middle streams */
+
+/* flow control applies to middle streams with credits only */
+#define STREAM_HAS_CREDIT(s) \
+	((s)->type == LPEL_STREAM_MIDDLE && (s)->credit > 0)
+
+static void InitStream(lpel_stream_t *s, int size);
 
 
 
@@ -46,7 +54,35 @@ lpel_stream_t *LpelStreamCreate(int size)
   }
 
   assert(LpelBufferIsEmpty(&s->buffer));
+  InitStream(s, size);
+  return s;
+}
+
 
+/**
+ * Create a value stream
+ *
+ * Value streams are not kept in the free lists of the workers,
+ * their buffers keep the entries for the values.
+ *
+ * @param size      number of values the stream holds, 0 for the default
+ * @param elemsize  size of a value in bytes
+ * @return pointer to the created stream
+ */
+lpel_stream_t *LpelStreamCreateValue(int size, int elemsize)
+{
+  assert( size >= 0 && elemsize > 0);
+  if (0==size) size = STREAM_BUFFER_SIZE;
+
+  lpel_stream_t *s = (lpel_stream_t *) malloc( sizeof(lpel_stream_t) );
+  LpelBufferInitValue( &s->buffer, elemsize);
+  InitStream(s, size);
+  return s;
+}
+
+
+static void InitStream(lpel_stream_t *s, int size)
+{
   s->uid = atomic_fetch_add( &stream_seq, 1);
   PRODLOCK_INIT( &s->prod_lock );
   atomic_init( &s->n_sem, 0);
@@ -59,7 +95,19 @@ lpel_stream_t *LpelStreamCreate(int size)
   s->next = NULL;
   s->read_cnt = 0;
   s->write_cnt = 0;
-  return s;
+  s->credit = middle_credit;
+  atomic_init( &s->c_sem, middle_credit);
+}
+
+
+/* put a stream no longer used back to the free list of the worker */
+static void PutStream(workerctx_t *wc, lpel_stream_t *s)
+{
+  if (s->buffer.elemsize > 0) {
+  	LpelStreamDestroy(s);
+  } else {
+  	LpelWorkerPutStream(wc, s);
+  }
 }
 
 
@@ -178,7 +226,7 @@ void LpelStreamClose( lpel_stream_desc_t *sd, int destroy_s)
   	s->prod_sd->stream = NULL;			// unset the stream pointer of producer
   	s->prod_sd = NULL;							// unset producer
   	s->cons_sd = NULL;							// unset consumer
-  	LpelWorkerPutStream(wc, s);				// put back to worker's free list
+  	PutStream(wc, s);				// put back to worker's free list
   	sd->stream = NULL;
   }
   LpelTaskRemoveStream(sd->task, sd, sd->mode);
@@ -209,7 +257,7 @@ void LpelStreamReplace( lpel_stream_desc_t *sd, lpel_stream_t *snew)
   s->prod_sd = NULL;
   s->cons_sd = NULL;
   assert(LpelBufferIsEmpty(&s->buffer));
-  LpelWorkerPutStream(wc, s);
+  PutStream(wc, s);
 
   /* assign new stream */
   lpel_stream_desc_t *old_cons = snew->cons_sd;
@@ -254,49 +302,36 @@ void *LpelStreamPeek( lpel_stream_desc_t *sd)
 
 
 /**
- * Blocking, consuming read from a stream
- *
- * If the stream is empty, the task is suspended until
- * a producer writes an item to the stream.
- *
- * @param sd  stream descriptor
- * @return    the next item of the stream
- * @pre       current task is single reader
+ * Take the top item off the stream after P(n_sem) and free its space
  */
-void *LpelStreamRead( lpel_stream_desc_t *sd)
+static void *TakeItem( lpel_stream_desc_t *sd, void *val)
 {
   void *item;
-  lpel_task_t *self = sd->task;
-  assert( sd->mode == 'r');
-
-  /* MONITORING CALLBACK */
-#ifdef USE_TASK_EVENT_LOGGING
-  if (sd->mon && MON_CB(stream_readprepare)) {
-    MON_CB(stream_readprepare)(sd->mon);
-  }
-#endif
-
-  /* quasi P(n_sem) */
-  if ( atomic_fetch_sub( &sd->stream->n_sem, 1) == 0) {
-
-#ifdef USE_TASK_EVENT_LOGGING
-    /* MONITORING CALLBACK */
-    if (sd->mon && MON_CB(stream_blockon)) {
-      MON_CB(stream_blockon)(sd->mon);
-    }
-#endif
-
-    /* wait on stream: */
-    LpelTaskBlockStream( self);
-  }
-
 
   /* read the top element */
   item = LpelBufferTop( &sd->stream->buffer);
   assert( item != NULL);
+  /* a value must be copied out before its entry is given back */
+  if (val != NULL) memcpy( val, item, sd->stream->buffer.elemsize);
   /* pop off the top element */
   LpelBufferPop( &sd->stream->buffer);
 
+  /* give the credit back to a bounded middle stream */
+  if (STREAM_HAS_CREDIT(sd->stream)) {
+  	/* quasi V(c_sem) */
+  	if ( atomic_fetch_add( &sd->stream->c_sem, 1) < 0) {
+  		/* c_sem was -1, producer ran out of credits */
+  		LpelTaskUnblock(sd->stream->prod_sd->task);
+
+  		/* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  		if (sd->mon && MON_CB(stream_wakeup)) {
+  			MON_CB(stream_wakeup)(sd->mon);
+  		}
+#endif	/** USE_TASK_EVENT_LOGGING */
+  	}
+  }
+
   /* only entry stream is bounded */
   if (sd->stream->type == LPEL_STREAM_ENTRY) {
   	/* quasi V(e_sem) */
@@ -328,33 +363,183 @@ void *LpelStreamRead( lpel_stream_desc_t *sd)
 }
 
 
+/**
+ * Blocking read of the next item, copying it to val for a value stream
+ */
+static void *ReadItem( lpel_stream_desc_t *sd, void *val)
+{
+  void *item;
+  lpel_task_t *self = sd->task;
+  assert( sd->mode == 'r');
+
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_readprepare)) {
+    MON_CB(stream_readprepare)(sd->mon);
+  }
+#endif
+
+  /* quasi P(n_sem) */
+  if ( atomic_fetch_sub( &sd->stream->n_sem, 1) == 0) {
+
+#ifdef USE_TASK_EVENT_LOGGING
+    /* MONITORING CALLBACK */
+    if (sd->mon && MON_CB(stream_blockon)) {
+      MON_CB(stream_blockon)(sd->mon);
+    }
+#endif
+
+    /* wait on stream: */
+    LpelTaskBlockStream( self);
+  }
+
+
+  item = TakeItem( sd, val);
+
+  /* time slice used up */
+  if (LpelTaskShouldYield()) LpelTaskYield();
+  return item;
+}
+
+
+/**
+ * Blocking, consuming read from a stream
+ *
+ * If the stream is empty, the task is suspended until
+ * a producer writes an item to the stream.
+ *
+ * @param sd  stream descriptor
+ * @return    the next item of the stream
+ * @pre       current task is single reader
+ */
+void *LpelStreamRead( lpel_stream_desc_t *sd)
+{
+  assert( sd->stream->buffer.elemsize == 0);
+  return ReadItem( sd, NULL);
+}
+
+
+/**
+ * Blocking, consuming read from a value stream
+ *
+ * @param sd  stream descriptor
+ * @param val receives the next value of the stream
+ * @pre       current task is single reader
+ */
+void LpelStreamReadValue( lpel_stream_desc_t *sd, void *val)
+{
+  assert( sd->stream->buffer.elemsize > 0);
+  (void) ReadItem( sd, val);
+}
+
 
 /**
- * Blocking write to a stream
+ * Consuming read for a task which must not block
  *
- * If the stream is full, the task is suspended until the consumer
- * reads items from the stream, freeing space for more items.
+ * Instead of blocking on an empty stream, the task is registered as the
+ * waiting consumer and NULL is returned. The next write wakes the task up,
+ * which then must call again with resume != 0 to take the item.
  *
- * @param sd    stream descriptor
- * @param item  data item (a pointer) to write
- * @pre         current task is single writer
- * @pre         item != NULL
+ * @param sd      stream descriptor
+ * @param resume  the task has been woken up after returning NULL
+ * @return        the next item of the stream, or NULL
+ * @pre           current task is single reader
  */
-void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
+void *LpelStreamReadOrWait( lpel_stream_desc_t *sd, int resume)
 {
-  lpel_task_t *self = sd->task;
-  int poll_wakeup = 0;
+  assert( sd->mode == 'r');
+  assert( sd->stream->buffer.elemsize == 0);
 
-  /* check if opened for writing */
-  assert( sd->mode == 'w' );
-  assert( item != NULL );
+  if (!resume) {
+    /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+    if (sd->mon && MON_CB(stream_readprepare)) {
+      MON_CB(stream_readprepare)(sd->mon);
+    }
+#endif
 
-  /* MONITORING CALLBACK */
+    /* quasi P(n_sem) */
+    if ( atomic_fetch_sub( &sd->stream->n_sem, 1) == 0) {
 #ifdef USE_TASK_EVENT_LOGGING
-  if (sd->mon && MON_CB(stream_writeprepare)) {
-    MON_CB(stream_writeprepare)(sd->mon, item);
+      /* MONITORING CALLBACK */
+      if (sd->mon && MON_CB(stream_blockon)) {
+        MON_CB(stream_blockon)(sd->mon);
+      }
+#endif
+      return NULL;
+    }
   }
+  return TakeItem( sd, NULL);
+}
+
+
+
+/**
+ * Take one unit of the semaphore if it is positive, without blocking
+ *
+ * @return 1 if it was decremented, 0 otherwise
+ */
+static int TryDown( atomic_int *sem)
+{
+  int cnt;
+
+  while ((cnt = atomic_load( sem)) > 0) {
+    if (atomic_test_and_set( sem, cnt, cnt-1)) return 1;
+  }
+  return 0;
+}
+
+
+/**
+ * Instead of blocking on a full entry stream or a middle stream without
+ * credits, the task is registered as the waiting producer and 0 is
+ * returned. The next read wakes the task up, which then must call again
+ * with resume != 0. The space (or credit) is not kept, the item is
+ * written as usual afterwards.
+ *
+ * @param sd      stream descriptor
+ * @param resume  the task has been woken up after 0 was returned
+ * @return        1 if an item can be written, 0 otherwise
+ * @pre           current task is single writer
+ */
+int LpelStreamSpaceOrWait( lpel_stream_desc_t *sd, int resume)
+{
+  atomic_int *sem;
+
+  assert( sd->mode == 'w');
+  if (sd->stream->type == LPEL_STREAM_ENTRY) {
+    sem = &sd->stream->e_sem;
+  } else if (STREAM_HAS_CREDIT(sd->stream)) {
+    sem = &sd->stream->c_sem;
+  } else {
+    return 1;   /* unbounded */
+  }
+
+  if (!resume) {
+    /* quasi P(e_sem) or P(c_sem) */
+    if ( atomic_fetch_sub( sem, 1) == 0) {
+#ifdef USE_TASK_EVENT_LOGGING
+      /* MONITORING CALLBACK */
+      if (sd->mon && MON_CB(stream_blockon)) {
+        MON_CB(stream_blockon)(sd->mon);
+      }
 #endif
+      return 0;
+    }
+  }
+  /* give it back, the sole writer claims it again on writing */
+  atomic_fetch_add( sem, 1);
+  return 1;
+}
+
+
+/**
+ * Claim space for one item, blocking if there is none
+ * (entry streams) or no credit is left (middle streams with credits)
+ */
+static void WaitSpace( lpel_stream_desc_t *sd)
+{
+  lpel_task_t *self = sd->task;
 
   /* only entry stream is bounded */
   if (sd->stream->type == LPEL_STREAM_ENTRY) {
@@ -371,7 +556,31 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
   		/* wait on stream: */
   		LpelTaskBlockStream( self);
   	}
+  } else if (STREAM_HAS_CREDIT(sd->stream)) {
+  	/* quasi P(c_sem), consume one credit */
+  	if ( atomic_fetch_sub( &sd->stream->c_sem, 1) == 0) {
+
+  		/* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  		if (sd->mon && MON_CB(stream_blockon)) {
+  			MON_CB(stream_blockon)(sd->mon);
+  		}
+#endif /** USE_TASK_EVENT_LOGGING */
+
+  		/* no credit left, wait for the consumer */
+  		LpelTaskBlockStream( self);
+  	}
   }
+}
+
+
+/**
+ * Write an item, or the value val if item is NULL, into the claimed space
+ */
+static void PutItem( lpel_stream_desc_t *sd, void *item, const void *val)
+{
+  lpel_task_t *self = sd->task;
+  int poll_wakeup = 0;
 
   /* writing to the buffer and checking if consumer polls must be atomic */
   PRODLOCK_LOCK( &sd->stream->prod_lock);
@@ -379,7 +588,11 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
     /* there must be space now in buffer */
     assert( LpelBufferIsSpace( &sd->stream->buffer) );
     /* put item into buffer */
-    LpelBufferPut( &sd->stream->buffer, item);
+    if (item != NULL) {
+      LpelBufferPut( &sd->stream->buffer, item);
+    } else {
+      LpelBufferPutValue( &sd->stream->buffer, val);
+    }
 
     if ( sd->stream->is_poll) {
       /* get consumer's poll token */
@@ -389,7 +602,9 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
   }
   PRODLOCK_UNLOCK( &sd->stream->prod_lock);
 
-
+  /* count before V(n_sem): the consumer may read the last item and
+   * destroy the stream right after */
+  sd->stream->write_cnt++;
 
   /* quasi V(n_sem) */
   if ( atomic_fetch_add( &sd->stream->n_sem, 1) < 0) {
@@ -426,13 +641,66 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
     MON_CB(stream_writefinish)(sd->mon);
   }
 #endif
-  sd->stream->write_cnt++;
 
 #ifdef USE_LOGGING
   if (sd->mon && MON_CB(rectype_data))
-  	if(MON_CB(rectype_data)(item))
+  	if(MON_CB(rectype_data)((item != NULL) ? item : (void *) val))
 #endif
   	LpelTaskCheckYield(self);
+
+  /* time slice used up, also if the item was not counted as a record */
+  if (LpelTaskShouldYield()) LpelTaskYield();
+}
+
+
+/**
+ * Blocking write of an item, or of the value val if item is NULL
+ */
+static void WriteItem( lpel_stream_desc_t *sd, void *item, const void *val)
+{
+  /* check if opened for writing */
+  assert( sd->mode == 'w' );
+  assert( (item != NULL) == (sd->stream->buffer.elemsize == 0) );
+
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_writeprepare)) {
+    MON_CB(stream_writeprepare)(sd->mon, (item != NULL) ? item : (void *) val);
+  }
+#endif
+
+  WaitSpace( sd);
+  PutItem( sd, item, val);
+}
+
+
+/**
+ * Blocking write to a stream
+ *
+ * If the stream is full, the task is suspended until the consumer
+ * reads items from the stream, freeing space for more items.
+ *
+ * @param sd    stream descriptor
+ * @param item  data item (a pointer) to write
+ * @pre         current task is single writer
+ * @pre         item != NULL
+ */
+void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
+{
+  WriteItem( sd, item, NULL);
+}
+
+
+/**
+ * Blocking write of a value to a value stream
+ *
+ * @param sd    stream descriptor
+ * @param val   the value, elemsize bytes are copied into the stream
+ * @pre         current task is single writer
+ */
+void LpelStreamWriteValue( lpel_stream_desc_t *sd, const void *val)
+{
+  WriteItem( sd, NULL, val);
 }
 
 
@@ -440,6 +708,9 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
 /**
  * Non-blocking write to a stream
  *
+ * Fails if the writer would have to block, i.e. if an entry stream is
+ * full or a middle stream with credits has none left.
+ *
  * @param sd    stream descriptor
  * @param item  data item (a pointer) to write
  * @pre         current task is single writer
@@ -448,29 +719,139 @@ void LpelStreamWrite( lpel_stream_desc_t *sd, void *item)
  */
 int LpelStreamTryWrite( lpel_stream_desc_t *sd, void *item)
 {
-  if (!LpelBufferIsSpace(&sd->stream->buffer)) {
+  lpel_stream_t *s = sd->stream;
+
+  assert( sd->mode == 'w' );
+  assert( item != NULL && s->buffer.elemsize == 0 );
+
+  /* claim the space (or credit) without blocking, a stackless task
+   * remembers the full stream to wait for it */
+  if ((s->type == LPEL_STREAM_ENTRY && !TryDown( &s->e_sem))
+      || (s->type != LPEL_STREAM_ENTRY && STREAM_HAS_CREDIT(s)
+        && !TryDown( &s->c_sem))) {
+    if (TASK_STACKLESS(sd->task)) sd->task->rec_full = sd;
     return -1;
   }
-  LpelStreamWrite( sd, item );
+
+  /* MONITORING CALLBACK */
+#ifdef USE_TASK_EVENT_LOGGING
+  if (sd->mon && MON_CB(stream_writeprepare)) {
+    MON_CB(stream_writeprepare)(sd->mon, item);
+  }
+#endif
+
+  PutItem( sd, item, NULL);
   return 0;
 }
 
+
 /**
- * Poll a set of streams
+ * Non-blocking, consuming read from a stream
  *
- * This is a blocking function called by a consumer which wants to wait
- * for arrival of data on any of a specified set of streams.
- * The consumer task is suspended while there is no new data on all streams.
+ * @param sd  stream descriptor
+ * @return    the next item of the stream, or NULL if the stream is empty
+ * @pre       current task is single reader
+ */
+void *LpelStreamTryRead( lpel_stream_desc_t *sd)
+{
+  assert( sd->mode == 'r');
+  if (LpelBufferTop( &sd->stream->buffer) == NULL) {
+    return NULL;
+  }
+  return LpelStreamRead( sd);
+}
+
+
+/**
+ * Claim the poll token of a task for its timer,
+ * the producers compete for it in LpelStreamWrite()
+ */
+static int ClaimPollToken( lpel_task_t *t)
+{
+  return atomic_exchange( &t->poll_token, 0);
+}
+
+
+/**
+ * Block a task which has placed its poll token until either a producer
+ * or the timer at the deadline wakes it up, whichever claims the token first
  *
- * @param set     a stream descriptor set the task wants to poll
- * @pre           set must not be empty (*set != NULL)
+ * @pre   self->wakeup_sd was reset before placing the token
+ * @return 1 if woken up by a producer, 0 on timeout
+ */
+static int PollBlockTimed( lpel_task_t *self, const struct timespec *deadline)
+{
+  lpel_timer_t *tm = (lpel_timer_t *) LpelTaskWaitRecord( self);
+
+  assert( sizeof(*tm) <= LPEL_TASK_WAITREC_SIZE);
+  if (!LpelTimerWheelAdd( LpelWorkerTimerWheel(), tm, self,
+        ClaimPollToken, deadline)) {
+    /* the deadline has passed already */
+    if (atomic_exchange( &self->poll_token, 0)) return 0;
+    /* a producer has claimed the token, its wakeup is on the way */
+    LpelTaskBlockStream( self);
+    return 1;
+  }
+  LpelTaskBlockStream( self);
+
+  /* woken up by a producer, the timer must not fire anymore */
+  (void) LpelTimerWheelCancel( tm);
+  return (self->wakeup_sd != NULL);
+}
+
+
+/**
+ * Consuming read from a stream, waiting at most usec microseconds
  *
- * @post          The first element when iterating through the set after
- *                LpelStreamPoll() will be the one after the one which
- *                caused the task to wakeup,
- *                i.e., the first stream where data arrived.
+ * @param sd    stream descriptor
+ * @param usec  timeout in microseconds
+ * @return      the next item of the stream, or NULL on timeout
+ * @pre         current task is single reader
  */
-lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
+void *LpelStreamReadTimeout( lpel_stream_desc_t *sd, unsigned long usec)
+{
+  lpel_task_t *self = sd->task;
+  lpel_stream_t *s = sd->stream;
+  struct timespec deadline;
+  int wait = 1;
+
+  assert( sd->mode == 'r');
+
+  /* fast path */
+  if (LpelBufferTop( &s->buffer) != NULL) return LpelStreamRead( sd);
+
+  LpelTimerDeadline( &deadline, usec);
+
+  /* register as polling consumer of the single stream */
+  self->wakeup_sd = NULL;
+  atomic_store( &self->poll_token, 1);
+  PRODLOCK_LOCK( &s->prod_lock);
+  if (LpelBufferTop( &s->buffer) != NULL) {
+    /* the item may have arrived meanwhile */
+    if (atomic_exchange( &self->poll_token, 0)) wait = 0;
+  } else {
+    s->is_poll = 1;
+  }
+  PRODLOCK_UNLOCK( &s->prod_lock);
+
+  if (wait) (void) PollBlockTimed( self, &deadline);
+  assert( atomic_load( &self->poll_token) == 0);
+
+  PRODLOCK_LOCK( &s->prod_lock);
+  s->is_poll = 0;
+  PRODLOCK_UNLOCK( &s->prod_lock);
+
+  /* an item might also have arrived right at the timeout */
+  if (LpelBufferTop( &s->buffer) == NULL) return NULL;
+  return LpelStreamRead( sd);
+}
+
+
+/**
+ * Poll a set of streams until the deadline, NULL = no timeout
+ */
+static lpel_stream_desc_t *PollSet( lpel_streamset_t *set,
+    const struct timespec *deadline)
 {
   lpel_task_t *self;
   lpel_stream_iter_t *iter;
@@ -497,6 +878,7 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
 
 
   /* place a poll token */
+  self->wakeup_sd = NULL;
   atomic_store( &self->poll_token, 1);
 
   /* for each stream in the set */
@@ -540,8 +922,12 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
 
   /* context switch */
   if (do_ctx_switch) {
-    /* set task as blocked */
-    LpelTaskBlockStream( self);
+    if (deadline != NULL) {
+      (void) PollBlockTimed( self, deadline);
+    } else {
+      /* set task as blocked */
+      LpelTaskBlockStream( self);
+    }
   }
   assert( atomic_load( &self->poll_token) == 0);
 
@@ -567,12 +953,54 @@ lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
 
   LpelStreamIterDestroy(iter);
 
+  /* timed out */
+  if (self->wakeup_sd == NULL) return NULL;
+
   /* 'rotate' set to stream descriptor for non-empty buffer */
   *set = self->wakeup_sd;
 
   return self->wakeup_sd;
 }
 
+
+/**
+ * Poll a set of streams
+ *
+ * This is a blocking function called by a consumer which wants to wait
+ * for arrival of data on any of a specified set of streams.
+ * The consumer task is suspended while there is no new data on all streams.
+ *
+ * @param set     a stream descriptor set the task wants to poll
+ * @pre           set must not be empty (*set != NULL)
+ *
+ * @post          The first element when iterating through the set after
+ *                LpelStreamPoll() will be the one after the one which
+ *                caused the task to wakeup,
+ *                i.e., the first stream where data arrived.
+ */
+lpel_stream_desc_t *LpelStreamPoll( lpel_streamset_t *set)
+{
+  return PollSet( set, NULL);
+}
+
+
+/**
+ * Poll a set of streams, waiting at most usec microseconds
+ *
+ * @param set     a stream descriptor set the task wants to poll
+ * @param usec    timeout in microseconds
+ * @pre           set must not be empty (*set != NULL)
+ * @return        as LpelStreamPoll(), or NULL on timeout;
+ *                the set is left unchanged then
+ */
+lpel_stream_desc_t *LpelStreamPollTimeout( lpel_streamset_t *set,
+    unsigned long usec)
+{
+  struct timespec deadline;
+  LpelTimerDeadline( &deadline, usec);
+  return PollSet( set, &deadline);
+}
+
 /*
  * get stream level
  * Assumption: MAX_INT as the maximum value of counter
@@ -584,6 +1012,35 @@ int LpelStreamFillLevel(lpel_stream_t *s) {
 	return (s->write_cnt - s->read_cnt);
 }
 
+/*
+ * a bounded middle stream is congested if its producer has used up all credits
+ */
+int LpelStreamIsCongested(lpel_stream_t *s) {
+	if (s == NULL || !STREAM_HAS_CREDIT(s))
+		return 0;
+	return (LpelStreamFillLevel(s) >= s->credit);
+}
+
+/*
+ * set the default number of credits for middle streams created afterwards
+ * 0 = unbounded
+ */
+void LpelStreamSetMiddleCredit(int credit) {
+	assert(credit >= 0);
+	middle_credit = credit;
+}
+
+/*
+ * set the number of credits of a single stream
+ * @pre	the stream has not been written yet
+ */
+void LpelStreamSetCredit(lpel_stream_t *s, int credit) {
+	assert(credit >= 0);
+	assert(s->write_cnt == 0);
+	s->credit = credit;
+	atomic_store(&s->c_sem, credit);
+}
+
 lpel_task_t *LpelStreamConsumer(lpel_stream_t *s) {
 	if (s == NULL)
 		return NULL;
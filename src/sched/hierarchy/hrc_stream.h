@@ -36,11 +36,20 @@ struct lpel_stream_t {
   lpel_stream_type type;			/* stream type (entry/exit/middle) */
   int read_cnt;								/* read counter, to calculate fill level */
   int write_cnt;							/* write counter, to calculate fill level */
+  int credit;									/* credits of a bounded middle stream, 0 = unbounded */
+  atomic_int c_sem;						/* counter for the remaining credits */
 };
 
 
 int LpelStreamFillLevel(lpel_stream_t *s);
+int LpelStreamIsCongested(lpel_stream_t *s);
 lpel_task_t *LpelStreamConsumer(lpel_stream_t *s);
 lpel_task_t *LpelStreamProducer(lpel_stream_t *s);
 
+/* read of a task that cannot block, for stackless tasks */
+void *LpelStreamReadOrWait( lpel_stream_desc_t *sd, int resume);
+
+/* wait for space of a task that cannot block, for stackless tasks */
+int LpelStreamSpaceOrWait( lpel_stream_desc_t *sd, int resume);
+
 #endif /* _STREAM_H_ */
@@ -10,6 +10,9 @@
 #include "hrc_worker.h"
 #include "lpel/monitor.h"
 #include "taskpriority.h"
+#include "stackmark.h"
+#include "timeslice.h"
+#include "lpel_main.h"
 
 static atomic_int taskseq = ATOMIC_VAR_INIT(0);
 static int neg_demand_lim = 0;
@@ -20,10 +23,16 @@ static void TaskStartup( void *arg);
 
 static void TaskStart( lpel_task_t *t);
 static void TaskStop( lpel_task_t *t);
+static void AdaptRecLimit( lpel_task_t *t);
+static void InitSchedInfo( lpel_task_t *t);
 
 #define TASK_STACK_ALIGN  256
 #define TASK_MINSIZE  4096
 
+/* weight of the last dispatch in the per-record cost estimate */
+#define REC_COST_ALPHA  0.25
+#define REC_LIMIT_MAX   (1<<16)
+
 
 /**
  * Create a task.
@@ -77,6 +86,18 @@ lpel_task_t *LpelTaskCreate( int map, lpel_taskfunc_t func,
 	t->prev = t->next = NULL;
 
 	t->mon = NULL;
+	t->fpstate = 0;
+
+	t->recfunc = NULL;
+	t->rec_stream = NULL;
+	t->rec_in = NULL;
+	t->rec_resume = 0;
+	t->rec_item = NULL;
+	t->rec_full = NULL;
+
+#ifdef USE_STACK_WATERMARK
+	LpelStackPaint( stackaddr, t->size - offset);
+#endif
 
 	/* function, argument (data), stack base address, stacksize */
 	mctx_create( &t->mctx, TaskStartup, (void*)t, stackaddr, t->size - offset);
@@ -84,15 +105,93 @@ lpel_task_t *LpelTaskCreate( int map, lpel_taskfunc_t func,
 	assert(t->mctx != NULL);
 #endif
 
-	// default scheduling info
+	InitSchedInfo(t);
+	return t;
+}
+
+
+/**
+ * Create a stackless task.
+ *
+ * The task consists of a record function called on the stack of a
+ * worker for every item read from the stream in, it has no stack and
+ * no machine context of its own. The function must not block: it may
+ * only use the non-blocking stream calls, the task is suspended between
+ * items only. It is terminated when the function returns != 0, closing
+ * and destroying the input stream.
+ *
+ * @param map     LPEL_MAP_MASTER, stackless tasks cannot run on wrappers
+ * @param func    record function
+ * @param arg     second argument of func
+ * @param in      input stream of the task
+ *
+ * @return the task handle of the created task (pointer to TCB)
+ */
+lpel_task_t *LpelTaskCreateStackless( int map, lpel_recfunc_t func,
+		void *arg, lpel_stream_t *in)
+{
+	lpel_task_t *t;
+
+	/* a wrapper would have to switch to the task */
+	assert( map == LPEL_MAP_MASTER );
+	assert( func != NULL && in != NULL );
+
+	t = (lpel_task_t *) malloc( sizeof(lpel_task_t) );
+	t->size = sizeof(lpel_task_t);
+	t->worker_context = NULL;
+
+	t->uid = atomic_fetch_add( &taskseq, 1);  /* obtain a unique task id */
+	t->func = NULL;
+	t->inarg = arg;
+
+	atomic_init( &t->poll_token, 0);
+
+	t->state = TASK_CREATED;
+	t->wakenup = 0;
+
+	t->prev = t->next = NULL;
+
+	t->mon = NULL;
+	t->fpstate = 0;
+
+	t->recfunc = func;
+	t->rec_stream = in;
+	t->rec_in = NULL;
+	t->rec_resume = 0;
+	t->rec_item = NULL;
+	t->rec_full = NULL;
+
+	InitSchedInfo(t);
+	return t;
+}
+
+
+/**
+ * Create a task on a shared stack.
+ *
+ * Tasks move between the workers with every dispatch, while the frames
+ * of a shared-stack task would have to stay at the addresses of the stack
+ * of one worker. Hence the task gets a default stack of its own.
+ */
+lpel_task_t *LpelTaskCreateShared( int map, lpel_taskfunc_t func,
+		void *inarg)
+{
+	return LpelTaskCreate( map, func, inarg, 0);
+}
+
+
+/* default scheduling info */
+static void InitSchedInfo(lpel_task_t *t)
+{
 	t->sched_info.prior = 0;
 	t->sched_info.rec_cnt = 0;
 	t->sched_info.rec_limit = 0;
 	t->sched_info.rec_limit_factor = -1;
+	t->sched_info.rec_slice = -1;
+	t->sched_info.rec_cost = 0.0;
+	t->sched_info.last_worker = -1;
 	t->sched_info.in_streams = NULL;
 	t->sched_info.out_streams = NULL;
-
-	return t;
 }
 
 
@@ -105,6 +204,15 @@ void LpelTaskDestroy( lpel_task_t *t)
 {
 	assert( t->state == TASK_ZOMBIE);
 
+#ifdef USE_STACK_WATERMARK
+	/* stackless tasks have no stack */
+	if (!TASK_STACKLESS(t)) {
+		int offset = (sizeof(lpel_task_t) + TASK_STACK_ALIGN-1) & ~(TASK_STACK_ALIGN-1);
+		size_t size = t->size - offset;
+		LpelStackRecord( t->mon, LpelStackPeak( (char *) t + offset, size), size);
+	}
+#endif
+
 #ifdef USE_TASK_EVENT_LOGGING
 	/* if task had a monitoring object, destroy it */
 	if (t->mon && MON_CB(task_destroy)) {
@@ -116,7 +224,7 @@ void LpelTaskDestroy( lpel_task_t *t)
 
 	//FIXME
 #ifdef USE_MCTX_PCL
-	co_delete(t->mctx);
+	if (!TASK_STACKLESS(t)) co_delete(t->mctx);
 #endif
 
 
@@ -197,6 +305,9 @@ void LpelTaskYield(void)
 	lpel_task_t *ct = LpelTaskSelf();
 	assert( ct->state == TASK_RUNNING );
 
+	/* stackless tasks yield between records only */
+	if (TASK_STACKLESS(ct)) return;
+
 	ct->state = TASK_READY;
 	TaskStop( ct);
 	LpelWorkerTaskYield(ct);
@@ -213,6 +324,7 @@ void LpelTaskBlockStream(lpel_task_t *t)
 {
 	/* a reference to it is held in the stream */
 	assert( t->state == TASK_RUNNING );
+	assert( !TASK_STACKLESS(t) );
 	t->state = TASK_BLOCKED;
 	TaskStop( t);
 	LpelWorkerTaskBlock(t);
@@ -221,6 +333,30 @@ void LpelTaskBlockStream(lpel_task_t *t)
 }
 
 
+/**
+ * Block a task on a mutex or condition variable
+ */
+void LpelTaskBlock(lpel_task_t *t)
+{
+	LpelTaskBlockStream(t);
+}
+
+
+/**
+ * Wake up a task blocked by LpelTaskBlock()
+ */
+void LpelTaskWakeup(lpel_task_t *t)
+{
+	LpelTaskUnblock(t);
+}
+
+/** wait record of a blocking call of t */
+void *LpelTaskWaitRecord(lpel_task_t *t)
+{
+	return t->waitrec;
+}
+
+
 /**
  * Unblock a task. Called from StreamRead/StreamWrite procedures
  */
@@ -256,6 +392,8 @@ static void TaskStartup( void *data)
 	t = (lpel_task_t *)z;
 #endif
 
+	/* the task may have been switched to directly from another task */
+	LpelWorkerTaskResume( t);
 	TaskStart( t);
 
 	/* call the task function with inarg as parameter */
@@ -270,6 +408,81 @@ static void TaskStartup( void *data)
 }
 
 
+/**
+ * Run a stackless task on the stack of its worker
+ *
+ * Records are processed until the input stream is empty, the record limit
+ * is reached or the time slice is used up, or the record function
+ * terminates the task. The task is left blocked, ready or finished,
+ * respectively, the worker returns it to the master. If the record
+ * function finds an output stream full, the task is left blocked on that
+ * stream instead, and gets the same item again afterwards.
+ *
+ * @param t   the stackless task, the current task of the worker
+ */
+void LpelTaskRunStackless( lpel_task_t *t)
+{
+	void *item;
+	int res;
+
+	TaskStart( t);
+
+	/* the stream is opened within the task */
+	if (t->rec_in == NULL) {
+		t->rec_in = LpelStreamOpen( t->rec_stream, 'r');
+	}
+	if (t->rec_item != NULL) {
+		/* woken up on the full output stream */
+		(void) LpelStreamSpaceOrWait( t->rec_full, 1);
+	}
+
+	while (1) {
+		if (t->rec_item != NULL) {
+			item = t->rec_item;
+			t->rec_item = NULL;
+		} else {
+			item = LpelStreamReadOrWait( t->rec_in, t->rec_resume);
+			t->rec_resume = 0;
+			if (item == NULL) {
+				/* registered on the stream, the writer wakes the task up */
+				t->rec_resume = 1;
+				t->state = TASK_BLOCKED;
+				break;
+			}
+			t->sched_info.rec_cnt++;
+		}
+
+		t->rec_full = NULL;
+		res = t->recfunc( item, t->inarg);
+		if (res == LPEL_REC_RETRY) {
+			assert( t->rec_full != NULL);
+			t->rec_item = item;
+			if (!LpelStreamSpaceOrWait( t->rec_full, 0)) {
+				/* registered on the stream, the reader wakes the task up */
+				t->state = TASK_BLOCKED;
+				break;
+			}
+			continue;		/* space has been freed meanwhile */
+		}
+		if (res) {
+			LpelStreamClose( t->rec_in, 1);
+			t->state = TASK_ZOMBIE;
+			break;
+		}
+
+		/* same limit as for LpelTaskCheckYield() */
+		if (LpelTaskShouldYield()
+				|| (t->sched_info.rec_limit >= 0
+					&& t->sched_info.rec_cnt >= t->sched_info.rec_limit)) {
+			t->state = TASK_READY;
+			break;
+		}
+	}
+
+	TaskStop( t);
+}
+
+
 static void TaskStart( lpel_task_t *t)
 {
 	// TODO reset task scheduling info
@@ -283,12 +496,18 @@ static void TaskStart( lpel_task_t *t)
 #endif
 
 	t->sched_info.rec_cnt = 0;	// reset rec_cnt
+	if (t->sched_info.rec_slice > 0)
+		LpelTimingNow(&t->sched_info.disp_start);
+	LpelTimesliceDispatch();
 	t->state = TASK_RUNNING;
 }
 
 
 static void TaskStop( lpel_task_t *t)
 {
+	if (t->sched_info.rec_slice > 0 && t->state != TASK_ZOMBIE)
+		AdaptRecLimit(t);
+
 	/* MONITORING CALLBACK */
 #ifdef USE_TASK_EVENT_LOGGING
 	if (t->mon && MON_CB(task_stop)) {
@@ -307,11 +526,16 @@ void LpelTaskCheckYield(lpel_task_t *t) {
 
 	assert( t->state == TASK_RUNNING );
 
-	if (t->sched_info.rec_limit < 0) {		//limit < 0 --> no yield
+	/* counted and yielded by LpelTaskRunStackless() */
+	if (TASK_STACKLESS(t)) {
 		return;
 	}
 
-	if (t->sched_info.rec_cnt == t->sched_info.rec_limit) {
+	/* limit < 0 --> no yield on the record count,
+	 * a used up time slice is honoured regardless */
+	if (LpelTaskShouldYield()
+			|| (t->sched_info.rec_limit >= 0
+				&& t->sched_info.rec_cnt >= t->sched_info.rec_limit)) {
 		t->state = TASK_READY;
 		TaskStop( t);
 		LpelWorkerTaskYield(t);
@@ -325,10 +549,85 @@ void LpelTaskSetRecLimit(lpel_task_t *t, int lim) {
 	t->sched_info.rec_limit_factor = lim;
 }
 
+int LpelTaskGetRecLimit(lpel_task_t *t) {
+	return t->sched_info.rec_limit;
+}
+
+/*
+ * in adaptive mode, rec_limit is not derived from rec_limit_factor
+ * but recomputed after every dispatch by AdaptRecLimit()
+ */
+void LpelTaskSetRecLimitAdaptive(lpel_task_t *t, int slice) {
+	if (slice == 0)
+		slice = LPEL_REC_SLICE_DEFAULT;
+	if (slice < 0) {
+		/* back to the fixed limit: rec_limit_factor per output stream */
+		stream_elem_t *out = t->sched_info.out_streams;
+		t->sched_info.rec_limit = 0;
+		while (out != NULL) {
+			t->sched_info.rec_limit += t->sched_info.rec_limit_factor;
+			out = out->next;
+		}
+		t->sched_info.rec_slice = -1;
+		return;
+	}
+	if (t->sched_info.rec_slice <= 0) {
+		/* no estimate yet, yield after the first record to get one */
+		t->sched_info.rec_limit = 1;
+		t->sched_info.rec_cost = 0.0;
+	}
+	t->sched_info.rec_slice = slice;
+}
+
+/*
+ * Recompute the record limit of a task at the end of a dispatch
+ * - the execution time per record is smoothed over the dispatches
+ * - the target slice shrinks with the number of ready tasks waiting
+ *   at the master per worker
+ */
+static void AdaptRecLimit(lpel_task_t *t) {
+	lpel_timing_t now, et;
+	double cost, slice;
+	int lim;
+
+	if (t->sched_info.rec_cnt == 0)		// nothing processed, keep the last estimate
+		return;
+
+	LpelTimingNow(&now);
+	LpelTimingDiff(&et, &t->sched_info.disp_start, &now);
+	cost = LpelTimingToNSec(&et) / t->sched_info.rec_cnt;
+	if (t->sched_info.rec_cost == 0.0)
+		t->sched_info.rec_cost = cost;
+	else
+		t->sched_info.rec_cost = REC_COST_ALPHA * cost
+				+ (1.0 - REC_COST_ALPHA) * t->sched_info.rec_cost;
+	if (t->sched_info.rec_cost < 1.0)
+		t->sched_info.rec_cost = 1.0;
+
+	slice = t->sched_info.rec_slice * 1000.0;
+	slice /= 1.0 + (double) LpelWorkerMasterLoad() / LpelWorkerCount();
+
+	lim = (slice / t->sched_info.rec_cost > REC_LIMIT_MAX) ?
+			REC_LIMIT_MAX : (int) (slice / t->sched_info.rec_cost);
+	t->sched_info.rec_limit = (lim < 1 ? 1 : lim);
+}
+
 void LpelTaskSetPrior(lpel_task_t *t, double p) {
 	t->sched_info.prior = p;
 }
 
+/**
+ * Let a task keep its floating-point control state across context switches
+ * @param t		task, not started yet
+ */
+void LpelTaskSaveFpState(lpel_task_t *t) {
+	assert(t->state == TASK_CREATED);
+	if (t->fpstate) return;
+
+	t->fpstate = 1;
+	if (!TASK_STACKLESS(t)) mctx_init_fp(&t->mctx);
+}
+
 
 void LpelTaskAddStream( lpel_task_t *t, lpel_stream_desc_t *des, char mode) {
 	stream_elem_t **list;
@@ -339,7 +638,8 @@ void LpelTaskAddStream( lpel_task_t *t, lpel_stream_desc_t *des, char mode) {
 		break;
 	case 'w':
 		list = &t->sched_info.out_streams;
-		t->sched_info.rec_limit += t->sched_info.rec_limit_factor;
+		if (t->sched_info.rec_slice <= 0)
+			t->sched_info.rec_limit += t->sched_info.rec_limit_factor;
 		break;
 	}
 	head = *list;
@@ -362,7 +662,8 @@ void LpelTaskRemoveStream( lpel_task_t *t, lpel_stream_desc_t *des, char mode) {
 		break;
 	case 'w':
 		list = &t->sched_info.out_streams;
-		t->sched_info.rec_limit -= t->sched_info.rec_limit_factor;
+		if (t->sched_info.rec_slice <= 0)
+			t->sched_info.rec_limit -= t->sched_info.rec_limit_factor;
 		break;
 	}
 	head = *list;
@@ -387,6 +688,17 @@ void LpelTaskRemoveStream( lpel_task_t *t, lpel_stream_desc_t *des, char mode) {
 
 
 
+/* check if any of the output streams has run out of credits */
+static int isCongested(stream_elem_t *list) {
+	while (list != NULL) {
+		if (LpelStreamIsCongested(list->stream_desc->stream))
+			return 1;
+		list = list->next;
+	}
+	return 0;
+}
+
+
 int countRec(stream_elem_t *list, char inout) {
 	if (list == NULL)
 		return -1;
@@ -418,6 +730,10 @@ double LpelTaskCalPriority(lpel_task_t *t) {
 	/* if t is entry task and already produced too many ouput, set it to LPEL_DBL_MIN and it will not be scheduled */
 	if (in == -1 && out > neg_demand_lim && neg_demand_lim > 0)
 		return LPEL_DBL_MIN;
+
+	/* producer of a congested stream is not scheduled until the consumer gives credits back */
+	if (isCongested(t->sched_info.out_streams))
+		return LPEL_DBL_MIN;
 #endif
 
 	return prior_cal(in, out);
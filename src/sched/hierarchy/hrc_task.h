@@ -7,6 +7,8 @@
 
 
 #include "arch/atomic.h"
+#include <lpel/timing.h>
+#include "lpel_main.h"
 
 #define LPEL_DBL_MIN (0.0 - DBL_MAX)
 
@@ -18,6 +20,18 @@
  */
 #define LPEL_TASK_SIZE_DEFAULT  8192  /* 8k */
 
+/**
+ * Default time slice (usec) targeted by the adaptive record limit,
+ * used if LpelTaskSetRecLimitAdaptive() is called with slice 0
+ */
+#define LPEL_REC_SLICE_DEFAULT  50
+
+/* stackless tasks are run by a call on the stack of the worker */
+#define TASK_STACKLESS(t)  ((t)->recfunc != NULL)
+
+/* flag for mctx_switch_fp() if the task keeps its FP control state */
+#define TASK_FP(t, flag)  ((t)->fpstate ? (flag) : 0)
+
 struct workerctx_t;
 struct mon_task_t;
 
@@ -32,7 +46,11 @@ typedef struct {
 	int rec_cnt;
 	int rec_limit_factor;
 	int rec_limit;
+	int rec_slice;				/* target time slice in usec, <= 0 --> fixed rec_limit */
+	double rec_cost;			/* smoothed execution time per record in nsec */
+	lpel_timing_t disp_start;	/* start time of the current dispatch */
 	double prior;
+	int last_worker;			/* worker the task was executed on last time, -1 if none */
 	stream_elem_t *in_streams;
 	stream_elem_t *out_streams;
 } sched_task_t;
@@ -66,6 +84,18 @@ struct lpel_task_t {
   lpel_taskfunc_t func; /** function of the task */
   void *inarg;          /** input argument  */
   void *outarg;         /** output argument  */
+  int fpstate;          /** FP control state is kept across switches */
+
+  /* STACKLESS TASKS */
+  lpel_recfunc_t recfunc;           /** record function, NULL if stackful */
+  lpel_stream_t *rec_stream;        /** input stream */
+  struct lpel_stream_desc_t *rec_in;  /** opened on the first run */
+  int rec_resume;                   /** woken up on the input stream */
+  void *rec_item;                   /** item to be delivered again, or NULL */
+  struct lpel_stream_desc_t *rec_full;  /** output found full by TryWrite */
+
+  /** see LpelTaskWaitRecord() */
+  void *waitrec[LPEL_TASK_WAITREC_SIZE / sizeof(void *)];
 
   /* info supporting scheduling */
   sched_task_t sched_info;
@@ -76,6 +106,7 @@ void LpelTaskDestroy(lpel_task_t *t);
 void LpelTaskBlockStream(lpel_task_t *ct);
 void LpelTaskUnblock(lpel_task_t *t);
 int LpelTaskIsWrapper(lpel_task_t *);
+void LpelTaskRunStackless(lpel_task_t *t);
 
 /******* DYNAMIC PRIORITY BASED ON THE STREAM FILL LEVEL ***********/
 /**
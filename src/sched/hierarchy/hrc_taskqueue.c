@@ -55,6 +55,28 @@ void downHeap(taskqueue_t *tq, int pos) {
 }
 
 
+/* search the sub-heap at pos for the best scored task with prior >= minprior
+ * children never have a higher priority than their parent, so sub-heaps
+ * below minprior are skipped
+ */
+void searchWithin(taskqueue_t *tq, unsigned int pos, double minprior,
+		int (*score)(lpel_task_t*, void*), void *arg, lpel_task_t **best, int *best_score) {
+	if (pos >= tq->count || *best_score == LPEL_SCORE_MAX)
+		return;
+	lpel_task_t *t = tq->heap[pos];
+	if (t->sched_info.prior < minprior)
+		return;
+
+	int s = score(t, arg);
+	if (s > *best_score
+			|| (s == *best_score && t->sched_info.prior > (*best)->sched_info.prior)) {
+		*best = t;
+		*best_score = s;
+	}
+	searchWithin(tq, 2 * pos, minprior, score, arg, best, best_score);
+	searchWithin(tq, 2 * pos + 1, minprior, score, arg, best, best_score);
+}
+
 int searchItem(taskqueue_t *tq, lpel_task_t *t) {
 	int i;
 	for (i = 1; i < tq->count; i++) {
@@ -127,6 +149,38 @@ lpel_task_t *LpelTaskqueuePop( taskqueue_t *tq) {
 	return t;
 }
 
+/*
+ * Find the task with the highest score among the tasks whose priority
+ * is at least minprior; ties are broken by priority
+ * 	score must return a value in [0, LPEL_SCORE_MAX]
+ * 	return NULL if the queue is empty or no task has a high enough priority
+ */
+lpel_task_t *LpelTaskqueueBestWithin( taskqueue_t *tq, double minprior,
+		int (*score)(lpel_task_t*, void*), void *arg) {
+	lpel_task_t *best = NULL;
+	int best_score = -1;
+	searchWithin(tq, 1, minprior, score, arg, &best, &best_score);
+	return best;
+}
+
+/*
+ * Remove an arbitrary task from the queue
+ */
+void LpelTaskqueueRemove( taskqueue_t *tq, lpel_task_t *t) {
+	int found = searchItem(tq, t);
+	assert(found > 0);
+	unsigned int pos = found;
+	tq->count--;
+	if (pos == tq->count)
+		return;
+	/* fill the gap with the last item and restore the heap */
+	tq->heap[pos] = tq->heap[tq->count];
+	if (pos > 1 && tq->heap[pos]->sched_info.prior > tq->heap[pos / 2]->sched_info.prior)
+		upHeap(tq, pos);
+	else
+		downHeap(tq, pos);
+}
+
 /*
  * Get queue size
  */
@@ -25,4 +25,11 @@ int LpelTaskqueueSize(taskqueue_t *tq);
 
 void LpelTaskqueueUpdatePriority(taskqueue_t *tq, lpel_task_t *t, double np);
 
+/* highest score a task can get in LpelTaskqueueBestWithin, stops the search */
+#define LPEL_SCORE_MAX	3
+
+lpel_task_t *LpelTaskqueueBestWithin( taskqueue_t *tq, double minprior,
+		int (*score)(lpel_task_t*, void*), void *arg);
+void LpelTaskqueueRemove( taskqueue_t *tq, lpel_task_t *t);
+
 #endif /* _HRC_TASKQUEUE_H_ */
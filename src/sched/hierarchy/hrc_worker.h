@@ -7,6 +7,8 @@
 #include "arch/mctx.h"
 #include "hrc_task.h"
 #include "mailbox.h"
+#include "timerwheel.h"
+#include "fdpoll.h"
 #include "hrc_taskqueue.h"
 #include "hrc_stream.h"
 
@@ -16,6 +18,13 @@
 #define  WORKER_MSG_ASSIGN			3
 #define  WORKER_MSG_REQUEST			4		// worker request task
 #define  WORKER_MSG_RETURN			5		// worker return tasks
+#define  WORKER_MSG_REQUEST_AHEAD	6		// busy worker requests its next task
+#define  WORKER_MSG_IDLE				7		// worker which requested ahead is idle now
+
+/* waiting state of a worker at the master */
+#define  WORKER_WAIT_NONE		0
+#define  WORKER_WAIT_IDLE		1
+#define  WORKER_WAIT_AHEAD	2
 
 
 typedef struct workerctx_t {
@@ -24,8 +33,12 @@ typedef struct workerctx_t {
   mctx_t        mctx;
   int           terminate;
   lpel_task_t  *current_task;
+  lpel_task_t  *prev_task;      // left the worker, not yet returned to the master
+  lpel_task_t  *runnext;        // stackless task assigned during a direct switch
   mon_worker_t *mon;
   mailbox_t    *mailbox;
+  timerwheel_t *timers;
+  fdpoll_t     *fds;            /* NULL for wrappers */
   char          padding[64];
   lpel_stream_t *free_stream;
   lpel_stream_desc_t *free_sd;
@@ -56,10 +69,13 @@ void LpelWorkerTaskWakeup( lpel_task_t *whom);
 void LpelWorkerTaskExit(lpel_task_t *t);
 void LpelWorkerTaskYield(lpel_task_t *t);
 void LpelWorkerTaskBlock(lpel_task_t *t);
+void LpelWorkerTaskResume(lpel_task_t *t);
 void LpelWorkerRunTask( lpel_task_t *t);
 
 void LpelWorkerBroadcast(workermsg_t *msg);
 
+/* number of ready tasks queued at the master, as last published by it */
+int LpelWorkerMasterLoad(void);
 
 
 /* put and get free stream */
@@ -71,7 +71,7 @@ void LpelWorkersInit(int size) {
 	/* allocate worker contexts */
 	for (i=0; i<num_workers; i++) {
 		workers[i] = (workerctx_t *) malloc(sizeof(workerctx_t) );
-		master->waitworkers[i] = 0;
+		master->waitworkers[i] = WORKER_WAIT_NONE;
     
 		workers[i]->wid = i;
 
@@ -87,6 +87,10 @@ void LpelWorkersInit(int size) {
 
 	/* mailbox */
 	workers[i]->mailbox = LpelMailboxCreate();
+	workers[i]->timers = LpelTimerWheelCreate();
+	workers[i]->fds = LpelFdPollCreate();
+	workers[i]->prev_task = NULL;
+	workers[i]->runnext = NULL;
 	workers[i]->free_sd = NULL;
 	workers[i]->free_stream = NULL;
 	}
@@ -129,6 +133,8 @@ void LpelWorkersCleanup(void) {
 	for(i=0; i<num_workers; i++) {
 		wc = workers[i];
 		LpelMailboxDestroy(wc->mailbox);
+		LpelTimerWheelDestroy(wc->timers);
+		LpelFdPollDestroy(wc->fds);
 		LpelWorkerDestroyStream(wc);
 		LpelWorkerDestroySd(wc);
 		free(wc);
@@ -182,6 +188,8 @@ static void cleanupMasterMb() {
 		LpelMailboxRecv(master->mailbox, &msg);
 		switch(msg.type) {
 		case WORKER_MSG_REQUEST:
+		case WORKER_MSG_REQUEST_AHEAD:
+		case WORKER_MSG_IDLE:
 			break;
 		case WORKER_MSG_RETURN:
 			t = msg.body.task;
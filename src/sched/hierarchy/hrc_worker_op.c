@@ -30,6 +30,7 @@
 #include "mailbox.h"
 #include "lpel/monitor.h"
 #include "lpel_main.h"
+#include "timeslice.h"
 
 //#define _USE_WORKER_DBG__
 
@@ -44,12 +45,28 @@
 /******************* PRIVATE FUNCTIONS *****************************/
 static void addFreeWrapper(workerctx_t *wp);
 static workerctx_t *getFreeWrapper();
+static int waitMessage(workerctx_t *wc, workermsg_t *msg);
+static void expireTimers(workerctx_t *wc);
+static void wakeupFdWaiters(workerctx_t *wc);
+static void dispatchNext(workerctx_t *wc, lpel_task_t *t);
+static void finishSwitch(workerctx_t *wc);
+static void runTask(workerctx_t *wc, lpel_task_t *t);
+static void becomeIdle(workerctx_t *wc);
 
 /******************************************************************************/
 static int num_workers = -1;
 static mailbox_t *mastermb;
 static mailbox_t **workermbs;
 
+/* size of the master's ready queue, read by tasks without locking */
+static atomic_int master_load = ATOMIC_VAR_INIT(0);
+
+/* direct switches between tasks per worker, read by tasks without locking */
+static atomic_ulong *direct_switches;
+
+/* priority tolerance for dispatching a task to a worker it has affinity to, < 0 = off */
+static double affinity_tol = -1.0;
+
 static workerctx_t *freewrappers;
 static PRODLOCK_TYPE lockwrappers;
 
@@ -73,6 +90,11 @@ void initLocalVar(int size){
   /* mailboxes */
   workermbs = (mailbox_t **) malloc(sizeof(mailbox_t *) * num_workers);
   setupMailbox(&mastermb, workermbs);
+
+  direct_switches = (atomic_ulong *) malloc(sizeof(atomic_ulong) * num_workers);
+  int i;
+  for (i = 0; i < num_workers; i++)
+    atomic_init(&direct_switches[i], 0);
 }
 
 void cleanupLocalVar(){
@@ -86,6 +108,7 @@ void cleanupLocalVar(){
 	while (wp != NULL) {
 		next = wp->next;
 		LpelMailboxDestroy(wp->mailbox);
+		LpelTimerWheelDestroy(wp->timers);
 		LpelWorkerDestroyStream(wp);
 		LpelWorkerDestroySd(wp);
 		free(wp);
@@ -95,6 +118,14 @@ void cleanupLocalVar(){
   
   /* mailboxes */
   free(workermbs);
+  workermbs = NULL;
+  mastermb = NULL;
+
+  int i;
+  for (i = 0; i < num_workers; i++)
+    atomic_destroy(&direct_switches[i]);
+  free(direct_switches);
+  direct_switches = NULL;
 }
 
 
@@ -122,16 +153,25 @@ static void returnTask(lpel_task_t *t) {
 }
 
 
-static void requestTask(workerctx_t *wc) {
-	WORKER_DBG("worker %d: request task\n", wc->wid);
+/* send a request of type WORKER_MSG_REQUEST, WORKER_MSG_REQUEST_AHEAD
+ * or WORKER_MSG_IDLE from worker wc to the master
+ */
+static void requestTask(workerctx_t *wc, workermsg_type_t type) {
+	WORKER_DBG("worker %d: request task (%d)\n", wc->wid, type);
 	workermsg_t msg;
-	msg.type = WORKER_MSG_REQUEST;
+	msg.type = type;
 	msg.body.from_worker = wc->wid;
 	LpelMailboxSend(mastermb, &msg);
+}
+
+/* the worker has nothing to run, it waits for the master's answer */
+static void waitStart(workerctx_t *wc) {
 #ifdef USE_LOGGING
 	if (wc->mon && MON_CB(worker_waitstart)) {
 		MON_CB(worker_waitstart)(wc->mon);
 	}
+#else
+	(void) wc;
 #endif
 }
 
@@ -155,19 +195,92 @@ static void sendWakeup(mailbox_t *mb, lpel_task_t *t)
 /*******************************************************************************
  * MASTER FUNCTION
  ******************************************************************************/
+/* affinity of task t to worker *arg: LPEL_SCORE_MAX for the worker it ran on last,
+ * the topological closeness of both workers otherwise
+ */
+static int affinityScore(lpel_task_t *t, void *arg) {
+	int wid = *(int *) arg;
+	int last = t->sched_info.last_worker;
+	if (last < 0 || t->sched_info.prior == LPEL_DBL_MIN)
+		return 0;
+	if (last == wid)
+		return LPEL_SCORE_MAX;
+	return LpelHwLocCloseness(last + 1, wid + 1);		// 0 is for the master
+}
+
+/* send t to a waiting worker, an idle one rather than one which has
+ * requested ahead and is still busy
+ * return the worker, -1 if no worker is waiting
+ */
 static int servePendingReq(masterctx_t *master, lpel_task_t *t) {
-	int i;
+	int i, s;
+	int wid = -1, best = -1;
 	t->sched_info.prior = LpelTaskCalPriority(t);
 	for (i = 0; i < num_workers; i++){
-		if (master->waitworkers[i] == 1) {
-			master->waitworkers[i] = 0;
-			WORKER_DBG("master: send task %d to worker %d\n", t->uid, i);
+		if (master->waitworkers[i] == WORKER_WAIT_NONE)
+			continue;
+		s = (master->waitworkers[i] == WORKER_WAIT_IDLE) ? LPEL_SCORE_MAX + 1 : 0;
+		if (affinity_tol >= 0.0)
+			s += affinityScore(t, &i);
+		if (s > best) {
+			wid = i;
+			best = s;
+			if (s == 2 * LPEL_SCORE_MAX + 1 || (affinity_tol < 0.0 && s > 0))
+				break;		// idle, and no better worker possible
+		}
+	}
+	if (wid >= 0) {
+		master->waitworkers[wid] = WORKER_WAIT_NONE;
+		WORKER_DBG("master: send task %d to worker %d\n", t->uid, wid);
+		sendTask(wid, t);
+	}
+	return wid;
+}
+
+/* take the next task for worker wid out of the ready queue
+ * prefer a task with affinity to wid if its priority is within the tolerance
+ * return NULL if no task can be scheduled
+ */
+static lpel_task_t *pickTask(masterctx_t *master, int wid) {
+	lpel_task_t *t = LpelTaskqueuePeek(master->ready_tasks);
+	if (t == NULL)
+		return NULL;
+#ifdef _USE_NEG_DEMAND_LIMIT_
+	if (t->sched_info.prior == LPEL_DBL_MIN)		// if not schedule task if it has too low priority
+		return NULL;
+#endif
+	if (affinity_tol >= 0.0 && t->sched_info.last_worker != wid) {
+		t = LpelTaskqueueBestWithin(master->ready_tasks,
+				t->sched_info.prior - affinity_tol, affinityScore, &wid);
+		LpelTaskqueueRemove(master->ready_tasks, t);
+	} else
+		t = LpelTaskqueuePop(master->ready_tasks);
+	return t;
+}
+
+#ifdef _USE_NEG_DEMAND_LIMIT_
+/* tasks held back with LPEL_DBL_MIN may become schedulable again after
+ * their neighbours' priorities were updated, serve the waiting workers then
+ */
+static void serveHeldTasks(masterctx_t *master) {
+	int i, wait;
+	lpel_task_t *t;
+	/* idle workers first */
+	for (wait = WORKER_WAIT_IDLE; wait <= WORKER_WAIT_AHEAD; wait++) {
+		for (i = 0; i < num_workers; i++) {
+			if (master->waitworkers[i] != wait)
+				continue;
+			t = pickTask(master, i);
+			if (t == NULL)
+				return;
+			master->waitworkers[i] = WORKER_WAIT_NONE;
+			t->state = TASK_READY;
+			WORKER_DBG("master: send held task %d to worker %d\n", t->uid, i);
 			sendTask(i, t);
-			return i;
 		}
 	}
-	return -1;
 }
+#endif
 
 static void updatePriorityList(taskqueue_t *tq, stream_elem_t *list, char mode) {
 	double np;
@@ -290,31 +403,36 @@ static void MasterLoop(masterctx_t *master)
 
 
 		case WORKER_MSG_REQUEST:
+		case WORKER_MSG_REQUEST_AHEAD:
 			wid = msg.body.from_worker;
 			WORKER_DBG("master: request task from worker %d\n", wid);
-			t = LpelTaskqueuePeek(master->ready_tasks);
+			t = pickTask(master, wid);
 			if (t == NULL) {
-				master->waitworkers[wid] = 1;
+				master->waitworkers[wid] = (msg.type == WORKER_MSG_REQUEST) ?
+						WORKER_WAIT_IDLE : WORKER_WAIT_AHEAD;
 			} else {
-
-#ifdef _USE_NEG_DEMAND_LIMIT_
-				if (t->sched_info.prior == LPEL_DBL_MIN) {		// if not schedule task if it has too low priority
-					master->waitworkers[wid] = 1;
-					break;
-				}
-#endif
 				t->state = TASK_READY;
 				sendTask(wid, t);
-				t = LpelTaskqueuePop(master->ready_tasks);
 			}
 			break;
 
+		case WORKER_MSG_IDLE:
+			/* ignored if the request has been answered meanwhile */
+			wid = msg.body.from_worker;
+			if (master->waitworkers[wid] == WORKER_WAIT_AHEAD)
+				master->waitworkers[wid] = WORKER_WAIT_IDLE;
+			break;
+
 		case WORKER_MSG_TERMINATE:
 			master->terminate = 1;
 			break;
 		default:
 			assert(0);
 		}
+#ifdef _USE_NEG_DEMAND_LIMIT_
+		serveHeldTasks(master);
+#endif
+		atomic_store(&master_load, LpelTaskqueueSize(master->ready_tasks));
 	} while (!(master->terminate && LpelTaskqueueSize(master->ready_tasks) == 0));
 }
 
@@ -370,13 +488,16 @@ static void WrapperLoop(workerctx_t *wp)
 	workermsg_t msg;
 
 	do {
+		expireTimers(wp);
+		wakeupFdWaiters(wp);
 		t = wp->current_task;
 		if (t != NULL) {
 			/* execute task */
-			mctx_switch(&wp->mctx, &t->mctx);
+			mctx_switch_fp(&wp->mctx, &t->mctx, TASK_FP(t, MCTX_FP_NEW));
 		} else {
 			/* no ready tasks */
-			LpelMailboxRecv(wp->mailbox, &msg);
+			if (!waitMessage(wp, &msg))
+				continue;		// a timer has expired
 			switch(msg.type) {
 			case WORKER_MSG_ASSIGN:
 				t = msg.body.task;
@@ -482,6 +603,10 @@ workerctx_t *LpelCreateWrapperContext(int wid) {
 		wp = (workerctx_t *) malloc(sizeof(workerctx_t));
 		/* mailbox */
 			wp->mailbox = LpelMailboxCreate();
+			wp->timers = LpelTimerWheelCreate();
+			wp->fds = NULL;		// a wrapper blocks on descriptors itself
+			wp->prev_task = NULL;
+			wp->runnext = NULL;
 			wp->free_sd = NULL;
 			wp->free_stream = NULL;
 			wp->next = NULL;
@@ -506,6 +631,37 @@ int LpelWorkerCount(void)
   return num_workers;
 }
 
+int LpelWorkerMasterLoad(void)
+{
+	return atomic_load(&master_load);
+}
+
+/* the workers take a task at a time from the master, they have no queue */
+int LpelWorkerQueueDepth(int wid, int *ready, int *mbox, int *mbox_peak)
+{
+	if (wid == -1) {
+		if (mastermb == NULL) return -1;
+		*ready = atomic_load(&master_load);
+		*mbox = LpelMailboxDepth(mastermb, mbox_peak);
+	} else {
+		if (wid < 0 || wid >= num_workers || workermbs == NULL) return -1;
+		*ready = 0;
+		*mbox = LpelMailboxDepth(workermbs[wid], mbox_peak);
+	}
+	return 0;
+}
+
+void LpelWorkerSetAffinityTol(double tol)
+{
+	affinity_tol = tol;
+}
+
+long LpelWorkerDirectSwitches(int wid)
+{
+	if (wid < 0 || wid >= num_workers || direct_switches == NULL) return -1;
+	return (long) atomic_load(&direct_switches[wid]);
+}
+
 
 /*******************************************************************************
  * WORKER FUNCTION
@@ -530,37 +686,28 @@ static void WorkerLoop(workerctx_t *wc)
 	WORKER_DBG("start worker %d\n", wc->wid);
 
   lpel_task_t *t = NULL;
-  requestTask(wc);		// ask for the first time
+  requestTask(wc, WORKER_MSG_REQUEST);		// ask for the first time
+  waitStart(wc);
 
   workermsg_t msg;
   do {
-  	  LpelMailboxRecv(wc->mailbox, &msg);
+  	  expireTimers(wc);
+  	  wakeupFdWaiters(wc);
+  	  if (wc->runnext != NULL) {
+  	  	// received by a task which left the worker
+  	  	t = wc->runnext;
+  	  	wc->runnext = NULL;
+  	  	runTask(wc, t);
+  	  	continue;
+  	  }
+  	  if (!waitMessage(wc, &msg))
+  	  	continue;		// a timer has expired
 
   	  switch(msg.type) {
   	  case WORKER_MSG_ASSIGN:
   	  	t = msg.body.task;
   	  	WORKER_DBG("worker %d: get task %d\n", wc->wid, t->uid);
-  	  	assert(t->state == TASK_READY);
-  	  	t->worker_context = wc;
-  	  	wc->current_task = t;
-
-#ifdef USE_LOGGING
-  	  	if (wc->mon && MON_CB(worker_waitstop)) {
-  	  		MON_CB(worker_waitstop)(wc->mon);
-  	  	}
-  	  	if (t->mon && MON_CB(task_assign)) {
-  	  		MON_CB(task_assign)(t->mon, wc->mon);
-  	  	}
-#endif
-  	  	mctx_switch(&wc->mctx, &t->mctx);
-  	  	//task return here
-  	  	assert(t->state != TASK_RUNNING);
-//  	  	if (t->state != TASK_ZOMBIE) {
-  	  	wc->current_task = NULL;
-  	  		t->worker_context = NULL;
-  	  		returnTask(t);
-//  	  	} else
-//  	  		LpelTaskDestroy(t);		// if task finish, destroy it and not return to master
+  	  	runTask(wc, t);
   	  	break;
   	  case WORKER_MSG_TERMINATE:
   	  	wc->terminate = 1;
@@ -574,6 +721,37 @@ static void WorkerLoop(workerctx_t *wc)
 }
 
 
+/* execute an assigned task until it leaves the worker */
+static void runTask(workerctx_t *wc, lpel_task_t *t)
+{
+	assert(t->state == TASK_READY);
+	t->worker_context = wc;
+	t->sched_info.last_worker = wc->wid;		// read by the master once t is returned
+	wc->current_task = t;
+	requestTask(wc, WORKER_MSG_REQUEST_AHEAD);
+
+#ifdef USE_LOGGING
+	if (wc->mon && MON_CB(worker_waitstop)) {
+		MON_CB(worker_waitstop)(wc->mon);
+	}
+	if (t->mon && MON_CB(task_assign)) {
+		MON_CB(task_assign)(t->mon, wc->mon);
+	}
+#endif
+	if (TASK_STACKLESS(t)) {
+		/* runs on the stack of the worker, nothing to switch */
+		LpelTaskRunStackless(t);
+		wc->current_task = NULL;
+		wc->prev_task = t;
+		becomeIdle(wc);
+	} else {
+		mctx_switch_fp(&wc->mctx, &t->mctx, TASK_FP(t, MCTX_FP_NEW));
+		//task return here, possibly a different one after direct switches
+	}
+	finishSwitch(wc);
+}
+
+
 void *WorkerThread(void *arg)
 {
   workerctx_t *wc = (workerctx_t *)arg;
@@ -595,7 +773,9 @@ void *WorkerThread(void *arg)
   wc->terminate = 0;
   wc->current_task = NULL;
 	LpelThreadAssign(wc->wid + 1);		// 0 is for the master
+	LpelTimesliceThreadStart();
 	WorkerLoop(wc);
+	LpelTimesliceThreadStop();
 
 #ifdef USE_LOGGING
   /* cleanup monitoring */
@@ -613,6 +793,60 @@ void *WorkerThread(void *arg)
 
 
 
+/* receive a message, but do not wait beyond the next timer
+ * return 0 if the timer has expired or a descriptor has become ready
+ * before a message arrived
+ */
+static int waitMessage(workerctx_t *wc, workermsg_t *msg) {
+	struct timespec deadline;
+	int timed = LpelTimerWheelNext(wc->timers, &deadline);
+
+	if (wc->fds != NULL && LpelFdPollCount(wc->fds) > 0
+			&& LpelMailboxArmNotify(wc->mailbox, LpelFdPollNotifyFd(wc->fds))) {
+		/* tasks wait for descriptors, a message interrupts the poll */
+		LpelFdPollWait(wc->fds, timed ? &deadline : NULL);
+		LpelMailboxDisarmNotify(wc->mailbox);
+		return 0;
+	}
+	if (timed)
+		return LpelMailboxRecvTimed(wc->mailbox, msg, &deadline);
+	LpelMailboxRecv(wc->mailbox, msg);
+	return 1;
+}
+
+/* wake up the tasks whose timers have expired, the wakeups are sent to
+ * the master (or the wrapper itself) like any other unblocking
+ */
+static void expireTimers(workerctx_t *wc) {
+	lpel_task_t *t;
+	while ((t = LpelTimerWheelExpire(wc->timers)) != NULL) {
+		WORKER_DBG("worker %d: timer expired for task %d\n", wc->wid, t->uid);
+		LpelWorkerTaskWakeup(t);
+	}
+}
+
+timerwheel_t *LpelWorkerTimerWheel(void) {
+	workerctx_t *wc = LpelWorkerSelf();
+	return (wc != NULL) ? wc->timers : NULL;
+}
+
+/* wake up the tasks whose descriptors have become ready */
+static void wakeupFdWaiters(workerctx_t *wc) {
+	lpel_task_t *t;
+	if (wc->fds == NULL)
+		return;
+	while ((t = LpelFdPollReady(wc->fds)) != NULL) {
+		WORKER_DBG("worker %d: descriptor ready for task %d\n", wc->wid, t->uid);
+		LpelWorkerTaskWakeup(t);
+	}
+}
+
+fdpoll_t *LpelWorkerFdPoll(void) {
+	workerctx_t *wc = LpelWorkerSelf();
+	return (wc != NULL) ? wc->fds : NULL;
+}
+
+
 workerctx_t *LpelWorkerSelf(void){
 #ifdef HAVE___THREAD
   return workerctx_cur;
@@ -640,41 +874,127 @@ void LpelWorkerTaskExit(lpel_task_t *t) {
 	workerctx_t *wc = t->worker_context;
 	WORKER_DBG("worker %d: task %d exit\n", wc->wid, t->uid);
 	if (wc->wid >= 0) {
-		requestTask(wc);	// FIXME: should have requested before
-		wc->current_task = NULL;
-	}
-	else
+		dispatchNext(wc, t);
+	} else {
 		wc->terminate = 1;		// wrapper: terminate
-
-	mctx_switch(&t->mctx, &wc->mctx);		// switch back to the worker
+		mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD));		// switch back to the wrapper
+	}
 }
 
 
 void LpelWorkerTaskBlock(lpel_task_t *t){
 	workerctx_t *wc = t->worker_context;
 	if (wc->wid < 0) {	//wrapper
-			wc->current_task = NULL;
+		wc->current_task = NULL;
+		mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD));		// switch back to the wrapper
 	} else {
 		WORKER_DBG("worker %d: block task %d\n", wc->wid, t->uid);
 		//sendUpdatePrior(t);		//update prior for neighbor
-		requestTask(wc);
+		dispatchNext(wc, t);
 	}
-	wc->current_task = NULL;
-	mctx_switch(&t->mctx, &wc->mctx);		// switch back to the worker/wrapper
 }
 
 void LpelWorkerTaskYield(lpel_task_t *t){
 	workerctx_t *wc = t->worker_context;
 	if (wc->wid < 0) {	//wrapper
-			WORKER_DBG("wrapper: task %d yields\n", t->uid);
+		WORKER_DBG("wrapper: task %d yields\n", t->uid);
+		mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD));		// switch back to the wrapper
 	}
 	else {
 		//sendUpdatePrior(t);		//update prior for neighbor
-		requestTask(wc);
 		WORKER_DBG("worker %d: return task %d\n", wc->wid, t->uid);
+		dispatchNext(wc, t);
+	}
+}
+
+/*
+ * Called by a task when it starts running, it may have been switched to
+ * directly from the task which left the worker before
+ */
+void LpelWorkerTaskResume(lpel_task_t *t) {
+	finishSwitch(t->worker_context);
+}
+
+
+/* the worker returns to its loop without a task to run; unless the master
+ * has answered the request ahead already, tell it that the worker is idle
+ */
+static void becomeIdle(workerctx_t *wc) {
+	if (!LpelMailboxHasIncoming(wc->mailbox))
+		requestTask(wc, WORKER_MSG_IDLE);
+	waitStart(wc);
+}
+
+
+/*
+ * Leave the worker with task t
+ *
+ * The worker has requested its next task when t started. If the master
+ * has answered by the time, the assigned task is switched to directly
+ * from t, saving the switch to the worker and back. Otherwise execution
+ * returns to the worker loop, which waits for it.
+ * Either way, t is returned to the master only after its context has been
+ * saved, by finishSwitch() of the context switched to.
+ */
+static void dispatchNext(workerctx_t *wc, lpel_task_t *t) {
+	lpel_task_t *next = NULL;
+	workermsg_t msg;
+
+	/* the worker loop is bypassed by direct switches */
+	expireTimers(wc);
+	wakeupFdWaiters(wc);
+
+	if (LpelMailboxHasIncoming(wc->mailbox)) {
+		LpelMailboxRecv(wc->mailbox, &msg);
+		if (msg.type == WORKER_MSG_ASSIGN) {
+			next = msg.body.task;
+		} else {
+			assert(msg.type == WORKER_MSG_TERMINATE);
+			wc->terminate = 1;
+		}
+	}
+
+	wc->prev_task = t;
+	if (next != NULL && !TASK_STACKLESS(next)) {
+		WORKER_DBG("worker %d: switch from task %d to task %d\n", wc->wid, t->uid, next->uid);
+		assert(next->state == TASK_READY);
+		next->worker_context = wc;
+		next->sched_info.last_worker = wc->wid;
+		wc->current_task = next;
+		requestTask(wc, WORKER_MSG_REQUEST_AHEAD);
+		atomic_store(&direct_switches[wc->wid], atomic_load(&direct_switches[wc->wid]) + 1);
+#ifdef USE_LOGGING
+		if (next->mon && MON_CB(task_assign)) {
+			MON_CB(task_assign)(next->mon, wc->mon);
+		}
+#endif
+		mctx_switch_fp(&t->mctx, &next->mctx,
+				TASK_FP(t, MCTX_FP_OLD) | TASK_FP(next, MCTX_FP_NEW));
+	} else {
+		/* a stackless task is run by the worker loop */
+		wc->runnext = next;
 		wc->current_task = NULL;
+		if (next == NULL)
+			becomeIdle(wc);
+		else
+			waitStart(wc);
+		mctx_switch_fp(&t->mctx, &wc->mctx, TASK_FP(t, MCTX_FP_OLD));		// switch back to the worker
 	}
-	mctx_switch(&t->mctx, &wc->mctx);		// switch back to the worker/wrapper
+
+	/* t is resumed, maybe on another worker */
+	finishSwitch(t->worker_context);
+}
+
+
+/* return the task which has left the worker to the master */
+static void finishSwitch(workerctx_t *wc) {
+	lpel_task_t *t = wc->prev_task;
+	if (t == NULL)
+		return;
+	assert(t->state != TASK_RUNNING);
+	wc->prev_task = NULL;
+	t->worker_context = NULL;
+	returnTask(t);
 }
 
 void LpelWorkerTaskWakeup(lpel_task_t *t) {
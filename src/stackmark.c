@@ -0,0 +1,97 @@
+/**
+ * Stack high-water marks of the tasks
+ *
+ * Tasks are sized for the worst case, since their actual stack use is not
+ * known. With USE_STACK_WATERMARK, the schedulers paint the stack of a task
+ * with a canary pattern before its context is created and look for the
+ * lowest overwritten word when it is destroyed. The peaks are collected in
+ * a histogram with power-of-two buckets, which tells how far the stack
+ * size can be cut safely.
+ *
+ * A task which happens to write the canary itself at its lowest position is
+ * measured too low by that word; the pattern makes this unlikely.
+ */
+
+#include <stdint.h>
+
+#include <lpel_common.h>
+#include <lpel/monitor.h>
+#include "lpelcfg.h"
+#include "stackmark.h"
+
+
+#define CANARY  ((uintptr_t) 0xa5c3f00dd00fc3a5ULL)
+
+/* bucket 0 holds the peaks below 1 << HIST_SHIFT bytes */
+#define HIST_SHIFT  9
+
+static unsigned long peak_hist[LPEL_STACK_HIST_BUCKETS];
+static unsigned long peak_tasks = 0;
+static unsigned long peak_max = 0;
+
+
+void LpelStackPaint(char *stack, size_t size)
+{
+  uintptr_t *w = (uintptr_t *) stack;
+  size_t i, n = size / sizeof(uintptr_t);
+
+  for (i = 0; i < n; i++) w[i] = CANARY;
+}
+
+
+size_t LpelStackPeak(const char *stack, size_t size)
+{
+  const uintptr_t *w = (const uintptr_t *) stack;
+  size_t i, n = size / sizeof(uintptr_t);
+
+  for (i = 0; i < n && w[i] == CANARY; i++) ;
+  return size - i * sizeof(uintptr_t);
+}
+
+
+void LpelStackRecord(mon_task_t *mt, size_t peak, size_t size)
+{
+  unsigned long max;
+  int b = 0;
+
+  while (b < LPEL_STACK_HIST_BUCKETS-1
+      && peak >= ((size_t) 1 << (HIST_SHIFT + b))) b++;
+  __sync_fetch_and_add(&peak_hist[b], 1);
+  __sync_fetch_and_add(&peak_tasks, 1);
+  do {
+    max = peak_max;
+  } while (peak > max && !__sync_bool_compare_and_swap(&peak_max, max, peak));
+
+#ifdef USE_TASK_EVENT_LOGGING
+  if (mt && MON_CB(task_stack)) {
+    MON_CB(task_stack)(mt, peak, size);
+  }
+#else
+  (void) mt; (void) size;
+#endif
+}
+
+
+/**
+ * Get the histogram of the peak stack use of the tasks destroyed so far
+ *
+ * hist[i] counts the tasks which used less than 512 << i bytes of their
+ * stack (and at least 512 << (i-1) bytes), the last bucket counts all the
+ * larger ones. The histogram stays empty unless the library is built with
+ * USE_STACK_WATERMARK.
+ *
+ * @param hist     LPEL_STACK_HIST_BUCKETS counters, may be NULL
+ * @param maxpeak  the largest peak in bytes, may be NULL
+ * @return the number of tasks recorded
+ */
+unsigned long LpelTaskStackHistogram(unsigned long *hist,
+    unsigned long *maxpeak)
+{
+  int i;
+
+  if (hist != NULL) {
+    for (i = 0; i < LPEL_STACK_HIST_BUCKETS; i++) hist[i] = peak_hist[i];
+  }
+  if (maxpeak != NULL) *maxpeak = peak_max;
+  return peak_tasks;
+}
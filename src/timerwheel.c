@@ -0,0 +1,373 @@
+/**
+ * Hierarchical timer wheel and task sleep
+ *
+ * Every worker owns a wheel of TW_LEVELS levels with TW_SIZE slots each.
+ * Level 0 holds the timers expiring within the next TW_SIZE ticks, one slot
+ * per tick; a slot of level L covers TW_SIZE^L ticks and is cascaded into
+ * the lower levels when the wheel reaches it. Adding and cancelling a timer
+ * is O(1), expiring costs O(1) per elapsed tick.
+ *
+ * The wheel is advanced lazily by its worker, whenever it dispatches a task
+ * or returns from waiting on its mailbox. An idle worker waits on the mailbox
+ * only until the deadline reported by LpelTimerWheelNext().
+ */
+
+#include <stdlib.h>
+#include <assert.h>
+
+#include <lpel_common.h>
+#include <lpel/timing.h>
+#include "lpel_main.h"
+#include "timerwheel.h"
+#include "arch/atomic.h"
+
+
+#define TW_BITS     6
+#define TW_SIZE     (1 << TW_BITS)
+#define TW_MASK     (TW_SIZE - 1)
+#define TW_LEVELS   4
+#define TW_RANGE    (1ULL << (TW_BITS * TW_LEVELS))
+
+/* resolution of the timers */
+#ifndef LPEL_TIMER_TICK_NSEC
+#define LPEL_TIMER_TICK_NSEC  1000000L
+#endif
+
+#define TW_BILLION  1000000000L
+
+
+struct timerwheel_t {
+  volatile int lock;              /* protects all of the wheel */
+  volatile unsigned int count;    /* number of pending timers */
+  unsigned long long now;         /* ticks up to now have been expired */
+  lpel_timer_t *due;              /* expired timers, not yet popped */
+  lpel_timer_t *slots[TW_LEVELS][TW_SIZE];
+};
+
+
+
+static inline unsigned long long TicksFloor(const struct timespec *ts)
+{
+  return ((unsigned long long) ts->tv_sec * TW_BILLION + ts->tv_nsec)
+    / LPEL_TIMER_TICK_NSEC;
+}
+
+static inline unsigned long long TicksCeil(const struct timespec *ts)
+{
+  return ((unsigned long long) ts->tv_sec * TW_BILLION + ts->tv_nsec
+      + LPEL_TIMER_TICK_NSEC - 1) / LPEL_TIMER_TICK_NSEC;
+}
+
+static inline unsigned long long CurrentTick(void)
+{
+  struct timespec ts;
+  LpelTimerNow(&ts);
+  return TicksFloor(&ts);
+}
+
+
+static inline void ListPush(lpel_timer_t **head, lpel_timer_t *tm)
+{
+  tm->next = *head;
+  if (tm->next) tm->next->pprev = &tm->next;
+  tm->pprev = head;
+  *head = tm;
+}
+
+static inline void ListUnlink(lpel_timer_t *tm)
+{
+  *tm->pprev = tm->next;
+  if (tm->next) tm->next->pprev = tm->pprev;
+  tm->next = NULL;
+  tm->pprev = NULL;
+}
+
+
+/**
+ * Put a timer into the slot according to its distance from tw->now
+ */
+static void Insert(timerwheel_t *tw, lpel_timer_t *tm)
+{
+  unsigned long long expire = tm->expire;
+  unsigned long long delta = (expire > tw->now) ? expire - tw->now : 0;
+  int lvl;
+
+  if (delta >= TW_RANGE) {
+    /* out of range, re-inserted when the top level slot is cascaded */
+    expire = tw->now + TW_RANGE - 1;
+    delta = TW_RANGE - 1;
+  }
+  for (lvl = 0; lvl < TW_LEVELS-1; lvl++) {
+    if (delta < (1ULL << (TW_BITS * (lvl+1)))) break;
+  }
+  ListPush(&tw->slots[lvl][(expire >> (TW_BITS * lvl)) & TW_MASK], tm);
+}
+
+
+static void Cascade(timerwheel_t *tw, int lvl, int idx)
+{
+  lpel_timer_t *tm = tw->slots[lvl][idx];
+  lpel_timer_t *next;
+
+  tw->slots[lvl][idx] = NULL;
+  while (tm != NULL) {
+    next = tm->next;
+    Insert(tw, tm);
+    tm = next;
+  }
+}
+
+
+/**
+ * Advance the wheel up to tick cur, moving the expired timers to tw->due
+ *
+ * @pre wheel is locked
+ */
+static void Advance(timerwheel_t *tw, unsigned long long cur)
+{
+  lpel_timer_t *tm, *next;
+  int lvl;
+
+  while (tw->now < cur) {
+    tw->now++;
+    for (lvl = TW_LEVELS-1; lvl > 0; lvl--) {
+      if (0 == (tw->now & ((1ULL << (TW_BITS * lvl)) - 1))) {
+        Cascade(tw, lvl, (tw->now >> (TW_BITS * lvl)) & TW_MASK);
+      }
+    }
+    tm = tw->slots[0][tw->now & TW_MASK];
+    tw->slots[0][tw->now & TW_MASK] = NULL;
+    while (tm != NULL) {
+      next = tm->next;
+      ListPush(&tw->due, tm);
+      tm = next;
+    }
+  }
+}
+
+
+/******************************************************************************/
+/*  WHEEL FUNCTIONS                                                           */
+/******************************************************************************/
+
+timerwheel_t *LpelTimerWheelCreate(void)
+{
+  timerwheel_t *tw = (timerwheel_t *) calloc(1, sizeof(timerwheel_t));
+  tw->now = CurrentTick();
+  atomic_spin_unlock(&tw->lock);
+  return tw;
+}
+
+/** Destroy a wheel, timers still pending are dropped */
+void LpelTimerWheelDestroy(timerwheel_t *tw)
+{
+  free(tw);
+}
+
+
+void LpelTimerNow(struct timespec *ts)
+{
+  (void) clock_gettime(LPEL_TIMER_CLOCK, ts);
+}
+
+void LpelTimerDeadline(struct timespec *deadline, unsigned long usec)
+{
+  LpelTimerNow(deadline);
+  deadline->tv_sec  += usec / 1000000;
+  deadline->tv_nsec += (usec % 1000000) * 1000;
+  if (deadline->tv_nsec >= TW_BILLION) {
+    deadline->tv_sec++;
+    deadline->tv_nsec -= TW_BILLION;
+  }
+}
+
+
+/**
+ * Add a timer waking task t at the deadline
+ *
+ * Has to be called by the thread owning the wheel.
+ * The timer must stay valid until it has expired or has been cancelled.
+ * If the task can be woken up by others as well, claim arbitrates:
+ * it is called on expiry, with the wheel locked, and the task is only
+ * woken up if it returns != 0.
+ *
+ * @return 1 if the timer has been added, 0 if the deadline has passed
+ */
+int LpelTimerWheelAdd(timerwheel_t *tw, lpel_timer_t *tm, lpel_task_t *t,
+    int (*claim)(lpel_task_t *), const struct timespec *deadline)
+{
+  unsigned long long cur = CurrentTick();
+
+  tm->expire = TicksCeil(deadline);
+  if (tm->expire <= cur) return 0;
+  tm->task = t;
+  tm->claim = claim;
+
+  atomic_spin_lock(&tw->lock);
+  /* an empty wheel simply skips the elapsed ticks */
+  if (tw->count == 0 && tw->now < cur) tw->now = cur;
+  tm->wheel = tw;
+  Insert(tw, tm);
+  tw->count++;
+  atomic_spin_unlock(&tw->lock);
+  return 1;
+}
+
+
+/**
+ * Cancel a timer, may be called by any thread
+ *
+ * @return 1 if the timer was pending, i.e. it will not wake up its task,
+ *         0 if it has expired already (and its claim has been evaluated)
+ */
+int LpelTimerWheelCancel(lpel_timer_t *tm)
+{
+  timerwheel_t *tw = tm->wheel;
+  int res = 0;
+
+  if (tw == NULL) return 0;
+
+  atomic_spin_lock(&tw->lock);
+  /* the owner might have expired it meanwhile */
+  if (tm->wheel == tw) {
+    ListUnlink(tm);
+    tm->wheel = NULL;
+    tw->count--;
+    res = 1;
+  }
+  atomic_spin_unlock(&tw->lock);
+  return res;
+}
+
+
+/**
+ * Return the task of the next expired timer
+ *
+ * Has to be called by the thread owning the wheel, repeatedly until
+ * NULL is returned.
+ */
+lpel_task_t *LpelTimerWheelExpire(timerwheel_t *tw)
+{
+  lpel_timer_t *tm;
+  lpel_task_t *t = NULL;
+
+  /* cheap check, there are no timers most of the time */
+  if (tw->count == 0) return NULL;
+
+  atomic_spin_lock(&tw->lock);
+  if (tw->due == NULL) Advance(tw, CurrentTick());
+  while (t == NULL && (tm = tw->due) != NULL) {
+    ListUnlink(tm);
+    tw->count--;
+    /* the timer must not be accessed after unlocking */
+    if (tm->claim == NULL || tm->claim(tm->task)) t = tm->task;
+    /* a cancelling task may return once it sees the timer expired */
+    __sync_synchronize();
+    tm->wheel = NULL;
+  }
+  atomic_spin_unlock(&tw->lock);
+  return t;
+}
+
+
+/**
+ * Get the earliest time at which LpelTimerWheelExpire() has to be called
+ *
+ * This is the exact deadline for timers on level 0 and the time of the next
+ * cascade for the timers further away.
+ *
+ * @return 0 if there are no timers, 1 otherwise
+ */
+int LpelTimerWheelNext(timerwheel_t *tw, struct timespec *deadline)
+{
+  unsigned long long best = ~0ULL, base, ns;
+  int lvl, i;
+
+  if (tw->count == 0) return 0;
+
+  atomic_spin_lock(&tw->lock);
+  if (tw->due != NULL) {
+    best = tw->now;
+  } else {
+    for (lvl = 0; lvl < TW_LEVELS; lvl++) {
+      base = tw->now >> (TW_BITS * lvl);
+      for (i = 1; i <= TW_SIZE; i++) {
+        if (tw->slots[lvl][(base + i) & TW_MASK] != NULL) {
+          if (((base + i) << (TW_BITS * lvl)) < best) {
+            best = (base + i) << (TW_BITS * lvl);
+          }
+          break;
+        }
+      }
+    }
+  }
+  atomic_spin_unlock(&tw->lock);
+
+  if (best == ~0ULL) return 0;
+  ns = best * LPEL_TIMER_TICK_NSEC;
+  deadline->tv_sec = ns / TW_BILLION;
+  deadline->tv_nsec = ns % TW_BILLION;
+  return 1;
+}
+
+
+/******************************************************************************/
+/*  TASK FUNCTIONS                                                            */
+/******************************************************************************/
+
+/**
+ * Block the current task until the deadline of the monotonic clock
+ */
+static void TaskWait(const struct timespec *deadline)
+{
+  lpel_task_t *t = LpelTaskSelf();
+  timerwheel_t *tw = LpelWorkerTimerWheel();
+  lpel_timer_t *tm;
+
+  assert(t != NULL && tw != NULL);
+
+  /* the timer lives in the TCB of the blocked task */
+  tm = (lpel_timer_t *) LpelTaskWaitRecord(t);
+  assert(sizeof(*tm) <= LPEL_TASK_WAITREC_SIZE);
+  if (LpelTimerWheelAdd(tw, tm, t, NULL, deadline)) {
+    LpelTaskBlock(t);
+  }
+}
+
+
+/**
+ * Suspend the current task for at least usec microseconds,
+ * the worker executes other tasks meanwhile
+ *
+ * @pre This call must be made from within a LPEL task!
+ */
+void LpelTaskSleep(unsigned long usec)
+{
+  struct timespec deadline;
+
+  LpelTimerDeadline(&deadline, usec);
+  TaskWait(&deadline);
+}
+
+
+/**
+ * Suspend the current task until the absolute time abstime,
+ * given w.r.t. LpelTimingNow(); returns at once if it has passed already
+ *
+ * @pre This call must be made from within a LPEL task!
+ */
+void LpelTaskWaitUntil(const struct timespec *abstime)
+{
+  lpel_timing_t now, remaining;
+  struct timespec deadline;
+
+  LpelTimingNow(&now);
+  if (abstime->tv_sec < now.tv_sec || (abstime->tv_sec == now.tv_sec
+        && abstime->tv_nsec <= now.tv_nsec)) return;
+
+  /* the deadline is taken relative to the monotonic clock */
+  LpelTimingDiff(&remaining, &now, abstime);
+  LpelTimerNow(&deadline);
+  LpelTimingAdd(&deadline, &remaining);
+  TaskWait(&deadline);
+}
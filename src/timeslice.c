@@ -0,0 +1,233 @@
+/**
+ * Timer driven preemption hints
+ *
+ * LPEL scheduling is cooperative. To be able to time-slice long running
+ * tasks, every worker thread can own a periodic POSIX timer measuring its
+ * thread CPU time. The timer signal is delivered to the worker thread itself
+ * and raises a should-yield flag if the same dispatch has survived a full
+ * slice. Tasks poll the flag cheaply via LpelTaskShouldYield(); stream
+ * operations poll it as well and yield on behalf of the task.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include <lpel_common.h>
+#include "timeslice.h"
+
+
+#if defined(HAVE_TIMER_CREATE) && defined(SIGEV_THREAD_ID) \
+  && defined(SYS_gettid)
+#define TIMESLICE_AVAILABLE
+#endif
+
+/* signal used for the timer notification */
+#ifndef LPEL_TIMESLICE_SIGNAL
+#define LPEL_TIMESLICE_SIGNAL   (SIGRTMIN+3)
+#endif
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id  _sigev_un._tid
+#endif
+
+
+typedef struct {
+  volatile sig_atomic_t should_yield;
+  volatile unsigned long disp_seq;   /* incremented on each dispatch */
+  unsigned long seen_seq;            /* dispatch seen at the last tick */
+#ifdef TIMESLICE_AVAILABLE
+  timer_t timer;
+#endif
+} timeslice_t;
+
+
+/* slice in usec, <= 0: preemption hints disabled */
+static int slice_usec = 0;
+
+#ifdef TIMESLICE_AVAILABLE
+static struct sigaction old_action;
+static int installed = 0;
+#endif
+
+#ifdef HAVE___THREAD
+static TLSSPEC timeslice_t *timeslice_cur;
+#else /* HAVE___THREAD */
+static pthread_key_t timeslice_key;
+#endif /* HAVE___THREAD */
+
+
+static inline timeslice_t *GetTimeslice(void)
+{
+#ifdef HAVE___THREAD
+  return timeslice_cur;
+#else /* HAVE___THREAD */
+  return (timeslice_t *) pthread_getspecific(timeslice_key);
+#endif /* HAVE___THREAD */
+}
+
+
+#ifdef TIMESLICE_AVAILABLE
+/**
+ * Signal handler, executed by the worker thread the timer belongs to
+ */
+static void TimesliceHandler(int sig, siginfo_t *si, void *ctx)
+{
+  timeslice_t *ts = (timeslice_t *) si->si_value.sival_ptr;
+  (void) sig; (void) ctx;
+
+  if (si->si_code != SI_TIMER || ts == NULL) return;
+
+  if (ts->seen_seq == ts->disp_seq) {
+    /* the current dispatch has been running for a whole slice */
+    ts->should_yield = 1;
+  } else {
+    ts->seen_seq = ts->disp_seq;
+  }
+}
+#endif /* TIMESLICE_AVAILABLE */
+
+
+/**
+ * Set the time slice of workers in usec; 0 disables the preemption hints.
+ * Has to be called before LpelStart().
+ */
+void LpelWorkerSetTimeSlice(int usec)
+{
+  slice_usec = (usec > 0) ? usec : 0;
+}
+
+
+/**
+ * Install the signal handler, if time slicing is enabled
+ */
+void LpelTimesliceInit(void)
+{
+#ifndef HAVE___THREAD
+  pthread_key_create(&timeslice_key, NULL);
+#endif /* HAVE___THREAD */
+
+#ifdef TIMESLICE_AVAILABLE
+  if (slice_usec > 0 && !installed) {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = TimesliceHandler;
+    sa.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    if (0 == sigaction(LPEL_TIMESLICE_SIGNAL, &sa, &old_action)) {
+      installed = 1;
+    }
+  }
+#endif /* TIMESLICE_AVAILABLE */
+}
+
+
+void LpelTimesliceCleanup(void)
+{
+#ifdef TIMESLICE_AVAILABLE
+  if (installed) {
+    (void) sigaction(LPEL_TIMESLICE_SIGNAL, &old_action, NULL);
+    installed = 0;
+  }
+#endif /* TIMESLICE_AVAILABLE */
+
+#ifndef HAVE___THREAD
+  pthread_key_delete(timeslice_key);
+#endif /* HAVE___THREAD */
+}
+
+
+/**
+ * Create and arm the timer of the calling worker thread
+ */
+void LpelTimesliceThreadStart(void)
+{
+#ifdef TIMESLICE_AVAILABLE
+  timeslice_t *ts;
+  struct sigevent sev;
+  struct itimerspec its;
+
+  if (!installed) return;
+
+  ts = (timeslice_t *) malloc(sizeof(timeslice_t));
+  ts->should_yield = 0;
+  ts->disp_seq = 0;
+  ts->seen_seq = 0;
+
+  memset(&sev, 0, sizeof(sev));
+  sev.sigev_notify = SIGEV_THREAD_ID;
+  sev.sigev_signo = LPEL_TIMESLICE_SIGNAL;
+  sev.sigev_value.sival_ptr = ts;
+  sev.sigev_notify_thread_id = syscall(SYS_gettid);
+
+  /* the thread CPU clock does not advance while the worker is idle */
+  if (0 != timer_create(CLOCK_THREAD_CPUTIME_ID, &sev, &ts->timer)) {
+    free(ts);
+    return;
+  }
+
+  its.it_value.tv_sec = slice_usec / 1000000;
+  its.it_value.tv_nsec = (slice_usec % 1000000) * 1000;
+  its.it_interval = its.it_value;
+  (void) timer_settime(ts->timer, 0, &its, NULL);
+
+#ifdef HAVE___THREAD
+  timeslice_cur = ts;
+#else /* HAVE___THREAD */
+  pthread_setspecific(timeslice_key, ts);
+#endif /* HAVE___THREAD */
+#endif /* TIMESLICE_AVAILABLE */
+}
+
+
+void LpelTimesliceThreadStop(void)
+{
+#ifdef TIMESLICE_AVAILABLE
+  timeslice_t *ts = GetTimeslice();
+  sigset_t set;
+  if (ts == NULL) return;
+
+  /* a still pending notification must not reach the handler anymore */
+  sigemptyset(&set);
+  sigaddset(&set, LPEL_TIMESLICE_SIGNAL);
+  (void) pthread_sigmask(SIG_BLOCK, &set, NULL);
+  (void) timer_delete(ts->timer);
+#ifdef HAVE___THREAD
+  timeslice_cur = NULL;
+#else /* HAVE___THREAD */
+  pthread_setspecific(timeslice_key, NULL);
+#endif /* HAVE___THREAD */
+  free(ts);
+#endif /* TIMESLICE_AVAILABLE */
+}
+
+
+/**
+ * A new dispatch starts on the current thread: reset the flag
+ */
+void LpelTimesliceDispatch(void)
+{
+  timeslice_t *ts = GetTimeslice();
+  if (ts != NULL) {
+    ts->disp_seq++;
+    ts->should_yield = 0;
+  }
+}
+
+
+/**
+ * Check if the current task has exceeded its time slice
+ *
+ * @return 1 if the task should yield, 0 otherwise
+ *         (always 0 if time slicing is disabled or not on a worker)
+ */
+int LpelTaskShouldYield(void)
+{
+  timeslice_t *ts = GetTimeslice();
+  return (ts != NULL && ts->should_yield);
+}
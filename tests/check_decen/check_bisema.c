@@ -0,0 +1,154 @@
+/*
+ * Binary semaphore.
+ *
+ * NUM_CONTENDERS tasks, on both workers and on a wrapper, take a single
+ * semaphore ROUNDS times and yield while they hold it, so that the
+ * others queue up behind it and get it handed over on the signal. Each
+ * checks that nobody else holds it at the same time. From halfway on,
+ * waiting tasks spin for a while before they block.
+ *
+ * A plain thread, not a task, signals a second semaphore NUM_SIGNALS
+ * times, each time a task waits on it again. The task has to be woken
+ * up for every signal.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lpel.h"
+
+#define NUM_CONTENDERS  8
+#define ROUNDS          2000
+#define SPIN_CYCLES     20000
+#define NUM_SIGNALS     200
+
+#define NUM_TASKS       (NUM_CONTENDERS + 1)
+
+static lpel_bisema_t sem, gate;
+static long counter = 0;
+static int owner = -1;
+
+static volatile int halfway = 0;
+static volatile int passed = -1;
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == NUM_TASKS) LpelStop();
+}
+
+
+static void *Contender(void *arg)
+{
+  int id = (int)(long) arg;
+  int i;
+
+  for (i=0; i<ROUNDS; i++) {
+    if (i == ROUNDS / 2
+        && __sync_add_and_fetch(&halfway, 1) == NUM_CONTENDERS) {
+      LpelBiSemaSetSpin(SPIN_CYCLES);
+    }
+    LpelBiSemaWait(&sem);
+    if (owner != -1) {
+      printf("Contender %d: semaphore held by %d\n", id, owner);
+      __sync_fetch_and_add(&failures, 1);
+    }
+    owner = id;
+    counter++;
+    if (i % 3 == 0) LpelTaskYield();
+    if (owner != id) {
+      printf("Contender %d: semaphore taken by %d\n", id, owner);
+      __sync_fetch_and_add(&failures, 1);
+    }
+    owner = -1;
+    LpelBiSemaSignal(&sem);
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Waiter(void *arg)
+{
+  int k;
+
+  /* take the initial signal, then wait for the thread */
+  LpelBiSemaWait(&gate);
+  passed = 0;
+  for (k=1; k<=NUM_SIGNALS; k++) {
+    LpelBiSemaWait(&gate);
+    passed = k;
+  }
+  TaskDone();
+  return arg;
+}
+
+
+static void *Signaller(void *arg)
+{
+  int k;
+
+  for (k=1; k<=NUM_SIGNALS; k++) {
+    /* a binary semaphore does not count, wait until it has been taken */
+    while (passed < k-1) usleep(100);
+    /* most of the time, the task is blocked by now */
+    if (k % 2 == 0) usleep(500);
+    LpelBiSemaSignal(&gate);
+  }
+  return arg;
+}
+
+
+static void testBiSema(void)
+{
+  lpel_config_t cfg;
+  pthread_t thread;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  LpelBiSemaInit(&sem);
+  LpelBiSemaInit(&gate);
+  for (i=0; i<NUM_CONTENDERS; i++) {
+    LpelTaskStart(LpelTaskCreate(i == 0 ? LPEL_MAP_OTHERS : (int) (i % 2),
+          Contender, (void *) i, 8192));
+  }
+  LpelTaskStart(LpelTaskCreate(1, Waiter, NULL, 8192));
+  pthread_create(&thread, NULL, Signaller, NULL);
+
+  LpelCleanup();
+  pthread_join(thread, NULL);
+  LpelBiSemaDestroy(&sem);
+  LpelBiSemaDestroy(&gate);
+
+  if (counter != NUM_CONTENDERS * ROUNDS) {
+    printf("Counter is %ld, expected %d\n", counter, NUM_CONTENDERS * ROUNDS);
+    failures++;
+  }
+  if (passed != NUM_SIGNALS) {
+    printf("Waiter passed %d of %d signals\n", passed, NUM_SIGNALS);
+    failures++;
+  }
+}
+
+
+int main(void)
+{
+  testBiSema();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,232 @@
+/*
+ * Waiting for file descriptors.
+ *
+ * Pipe: the writer fills a non-blocking pipe and waits with LpelTaskWaitFd
+ * until the reader, on the other worker, has drained it; PIPE_BYTES have
+ * to arrive. Socket pairs: NUM_PAIRS readers wait for a byte from their
+ * writer, which sleeps before each write, so most readers are suspended
+ * on the poller at any time. Finally two tasks wait on the same socket,
+ * one for reading and one for writing, and both have to be woken.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include "lpel.h"
+
+#define PIPE_BYTES   (1L << 22)
+#define NUM_PAIRS    100
+#define NUM_BYTES    20
+
+#define NUM_TASKS    (2 + 2 * NUM_PAIRS + 3)
+
+static int pp[2];
+static int sv[NUM_PAIRS][2];
+static int both[2];
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == NUM_TASKS) LpelStop();
+}
+
+
+static void Fail(const char *msg)
+{
+  printf("%s\n", msg);
+  __sync_fetch_and_add(&failures, 1);
+}
+
+
+static void *PipeWriter(void *arg)
+{
+  char buf[4096];
+  long total = 0;
+  ssize_t n;
+
+  memset(buf, 0, sizeof(buf));
+  while (total < PIPE_BYTES) {
+    n = write(pp[1], buf, sizeof(buf));
+    if (n < 0) {
+      if (LpelTaskWaitFd(pp[1], LPEL_FD_WRITE) != LPEL_FD_WRITE) {
+        Fail("pipe writer: wait failed");
+      }
+      continue;
+    }
+    total += n;
+  }
+  close(pp[1]);
+  TaskDone();
+  return NULL;
+}
+
+
+static void *PipeReader(void *arg)
+{
+  char buf[1000];
+  long total = 0;
+  ssize_t n;
+
+  for (;;) {
+    n = read(pp[0], buf, sizeof(buf));
+    if (n == 0) break;
+    if (n < 0) {
+      if (LpelTaskWaitFd(pp[0], LPEL_FD_READ) != LPEL_FD_READ) {
+        Fail("pipe reader: wait failed");
+      }
+      continue;
+    }
+    total += n;
+  }
+  close(pp[0]);
+  printf("Read %ld bytes from the pipe\n", total);
+  if (total != PIPE_BYTES) Fail("pipe reader: bytes lost");
+  TaskDone();
+  return NULL;
+}
+
+
+static void *SocketReader(void *arg)
+{
+  long id = (long) arg;
+  int k;
+  char c;
+
+  for (k=0; k<NUM_BYTES; k++) {
+    if (LpelTaskWaitFd(sv[id][0], LPEL_FD_READ) != LPEL_FD_READ) {
+      Fail("socket reader: wait failed");
+    }
+    if (read(sv[id][0], &c, 1) != 1 || c != (char) k) {
+      Fail("socket reader: wrong byte");
+    }
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *SocketWriter(void *arg)
+{
+  long id = (long) arg;
+  int k;
+  char c;
+
+  for (k=0; k<NUM_BYTES; k++) {
+    LpelTaskSleep(((id * 7 + k * 13) % 50) * 100);
+    if (LpelTaskWaitFd(sv[id][1], LPEL_FD_WRITE) != LPEL_FD_WRITE) {
+      Fail("socket writer: wait failed");
+    }
+    c = (char) k;
+    if (write(sv[id][1], &c, 1) != 1) Fail("socket writer: write failed");
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+/* reads from both[0], after the writer below has slept a while */
+static void *BothReader(void *arg)
+{
+  char c;
+
+  if (LpelTaskWaitFd(both[0], LPEL_FD_READ) != LPEL_FD_READ) {
+    Fail("reader on a shared socket: wait failed");
+  }
+  if (read(both[0], &c, 1) != 1) Fail("reader on a shared socket: no byte");
+  TaskDone();
+  return NULL;
+}
+
+
+/* waits for both[0] to be writable, while the reader above waits on it */
+static void *BothWaiter(void *arg)
+{
+  if (LpelTaskWaitFd(both[0], LPEL_FD_WRITE) != LPEL_FD_WRITE) {
+    Fail("writer on a shared socket: wait failed");
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *BothWriter(void *arg)
+{
+  char c = 'x';
+
+  LpelTaskSleep(20000);
+  if (write(both[1], &c, 1) != 1) Fail("write to a shared socket failed");
+  TaskDone();
+  return NULL;
+}
+
+
+static void testWaitFd(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  if (pipe(pp) != 0) {
+    perror("pipe");
+    exit(EXIT_FAILURE);
+  }
+  fcntl(pp[0], F_SETFL, O_NONBLOCK);
+  fcntl(pp[1], F_SETFL, O_NONBLOCK);
+  for (i=0; i<NUM_PAIRS; i++) {
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv[i]) != 0) {
+      perror("socketpair");
+      exit(EXIT_FAILURE);
+    }
+    fcntl(sv[i][0], F_SETFL, O_NONBLOCK);
+  }
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, both) != 0) {
+    perror("socketpair");
+    exit(EXIT_FAILURE);
+  }
+
+  LpelTaskStart(LpelTaskCreate(0, PipeWriter, NULL, 16384));
+  LpelTaskStart(LpelTaskCreate(1, PipeReader, NULL, 16384));
+  for (i=0; i<NUM_PAIRS; i++) {
+    LpelTaskStart(LpelTaskCreate(i == 0 ? LPEL_MAP_OTHERS : (int) (i % 2),
+          SocketReader, (void *) i, 8192));
+    LpelTaskStart(LpelTaskCreate((int) ((i+1) % 2),
+          SocketWriter, (void *) i, 8192));
+  }
+  LpelTaskStart(LpelTaskCreate(0, BothReader, NULL, 8192));
+  LpelTaskStart(LpelTaskCreate(0, BothWaiter, NULL, 8192));
+  LpelTaskStart(LpelTaskCreate(1, BothWriter, NULL, 8192));
+
+  LpelCleanup();
+
+  for (i=0; i<NUM_PAIRS; i++) {
+    close(sv[i][0]);
+    close(sv[i][1]);
+  }
+  close(both[0]);
+  close(both[1]);
+}
+
+
+int main(void)
+{
+  testWaitFd();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * FP control state across task switches.
+ *
+ * One task sets the rounding mode to FE_UPWARD and yields repeatedly,
+ * it opted in with LpelTaskSaveFpState() and has to find its mode again
+ * every time it resumes. Two plain tasks on the same worker have to keep
+ * running with the default mode FE_TONEAREST.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fenv.h>
+#include "lpel.h"
+
+#define NUM_YIELDS  20000
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == 3) LpelStop();
+}
+
+
+static void *Upward(void *arg)
+{
+  int i, lost = 0;
+
+  fesetround(FE_UPWARD);
+  for (i=0; i<NUM_YIELDS; i++) {
+    LpelTaskYield();
+    if (fegetround() != FE_UPWARD) {
+      lost++;
+      fesetround(FE_UPWARD);
+    }
+  }
+  printf("Upward task lost its rounding mode %d times\n", lost);
+  if (lost > 0) __sync_fetch_and_add(&failures, 1);
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Plain(void *arg)
+{
+  int i, leaked = 0;
+
+  for (i=0; i<NUM_YIELDS; i++) {
+    LpelTaskYield();
+    if (fegetround() != FE_TONEAREST) leaked++;
+  }
+  printf("Plain task saw a foreign rounding mode %d times\n", leaked);
+  if (leaked > 0) __sync_fetch_and_add(&failures, 1);
+  TaskDone();
+  return NULL;
+}
+
+
+static void testFpState(void)
+{
+  lpel_config_t cfg;
+  lpel_task_t *t;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 1;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  /* all tasks on the same worker */
+  t = LpelTaskCreate(0, Upward, NULL, 8192);
+  LpelTaskSaveFpState(t);
+  LpelTaskStart(t);
+  LpelTaskStart(LpelTaskCreate(0, Plain, NULL, 8192));
+  LpelTaskStart(LpelTaskCreate(0, Plain, NULL, 8192));
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testFpState();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
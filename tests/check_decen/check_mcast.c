@@ -0,0 +1,130 @@
+/*
+ * Multicast stream with readers coming and going.
+ *
+ * A writer sends NUM_ITEMS items to NUM_READERS readers over a small
+ * multicast stream, blocking and non-blocking writes mixed. The odd
+ * readers read without blocking. Two readers open the stream late,
+ * when the writer has long been waiting for them, and have to get all
+ * items from the first one on; two others dawdle and close it early,
+ * when the writer is waiting for them only, and must not be waited for
+ * anymore. Every reader checks that it gets the items in order, without
+ * gaps.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpel.h"
+
+#define NUM_READERS  8
+#define NUM_ITEMS    50000L
+#define STREAM_SIZE  4
+
+#define END  ((void *) -1L)
+
+static lpel_stream_t *mcast;
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == NUM_READERS + 1) LpelStop();
+}
+
+
+static void *Writer(void *arg)
+{
+  lpel_stream_desc_t *out = LpelStreamOpen(mcast, 'w');
+  long i;
+
+  for (i=1; i<=NUM_ITEMS; i++) {
+    if (i % 3 == 0) {
+      while (LpelStreamTryWrite(out, (void *) i) != 0) LpelTaskYield();
+    } else {
+      LpelStreamWrite(out, (void *) i);
+    }
+  }
+  LpelStreamWrite(out, END);
+  LpelStreamClose(out, 0);
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Reader(void *arg)
+{
+  long id = (long) arg;
+  long expected = 1, last = NUM_ITEMS;
+  lpel_stream_desc_t *in;
+  void *item;
+
+  /* the late ones */
+  if (id == 4 || id == 5) LpelTaskSleep(20000);
+  /* the early ones */
+  if (id == 6) last = NUM_ITEMS / 3;
+  if (id == 7) last = NUM_ITEMS / 5;
+
+  in = LpelStreamOpen(mcast, 'r');
+  while (expected <= last) {
+    if (id % 2 == 1) {
+      while ((item = LpelStreamTryRead(in)) == NULL) LpelTaskYield();
+    } else {
+      item = LpelStreamRead(in);
+    }
+    if (item == END) break;
+    if ((long) item != expected) {
+      printf("Reader %ld: got item %ld, expected %ld\n",
+          id, (long) item, expected);
+      __sync_fetch_and_add(&failures, 1);
+    }
+    expected = (long) item + 1;
+  }
+  if (expected != last + 1) {
+    printf("Reader %ld: stopped at item %ld\n", id, expected);
+    __sync_fetch_and_add(&failures, 1);
+  }
+  /* the others catch up, the items left are held for this one only */
+  if (last < NUM_ITEMS) LpelTaskSleep(id * 2000);
+  /* the readers which read to the end destroy the stream when all left */
+  LpelStreamClose(in, last == NUM_ITEMS);
+  TaskDone();
+  return NULL;
+}
+
+
+static void testMulticast(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  mcast = LpelStreamCreateMulticast(STREAM_SIZE, NUM_READERS);
+  for (i=0; i<NUM_READERS; i++) {
+    LpelTaskStart(LpelTaskCreate(i == 0 ? LPEL_MAP_OTHERS : (int) (i % 2),
+          Reader, (void *) i, 8192));
+  }
+  LpelTaskStart(LpelTaskCreate(1, Writer, NULL, 8192));
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testMulticast();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,137 @@
+/*
+ * Multi-producer stream with more writers than slots.
+ *
+ * NUM_WRITERS tasks write to a stream of STREAM_SIZE slots, so most of
+ * them block in the list of waiting writers most of the time. Half of
+ * the writers are shared-stack tasks writing from different depths of
+ * their stack, every fifth one runs on a wrapper, and every fourth one
+ * tries a non-blocking write first. The single reader checks that the
+ * items of each writer arrive complete and in order.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "lpel.h"
+
+#define NUM_WRITERS  16
+#define STREAM_SIZE  4
+#define NUM_ITEMS    20000L
+#define FRAME_SIZE   128
+
+static lpel_stream_t *mpsc;
+static volatile int failures = 0;
+
+
+static void *ItemCreate(long id, long seq)
+{
+  return (void *) ((id << 32) | (seq + 1));
+}
+
+
+/* writes from a stack depth of its own, checking its frames afterwards */
+static void Put(lpel_stream_desc_t *out, long id, long seq, int depth)
+{
+  volatile char frame[FRAME_SIZE];
+  void *item = ItemCreate(id, seq);
+  int i;
+
+  memset((char *) frame, (int) (id + depth) & 0xff, FRAME_SIZE);
+  if (depth > 0) {
+    Put(out, id, seq, depth-1);
+  } else if (id % 4 == 1) {
+    if (LpelStreamTryWrite(out, item) != 0) LpelStreamWrite(out, item);
+  } else {
+    LpelStreamWrite(out, item);
+  }
+  for (i=0; i<FRAME_SIZE; i++) {
+    if (frame[i] != (char) ((id + depth) & 0xff)) {
+      fprintf(stderr, "Writer %ld: frame %d corrupted\n", id, depth);
+      abort();
+    }
+  }
+}
+
+
+static void *Writer(void *arg)
+{
+  long id = (long) arg;
+  long seq;
+  lpel_stream_desc_t *out = LpelStreamOpen(mpsc, 'w');
+
+  for (seq=0; seq<NUM_ITEMS; seq++) {
+    Put(out, id, seq, (int) (id % 3));
+  }
+  LpelStreamClose(out, 0);
+  return NULL;
+}
+
+
+static void *Reader(void *arg)
+{
+  lpel_stream_desc_t *in = LpelStreamOpen(mpsc, 'r');
+  long next[NUM_WRITERS];
+  long n, item, id, seq;
+
+  memset(next, 0, sizeof(next));
+  for (n=0; n<NUM_WRITERS * NUM_ITEMS; n++) {
+    item = (long) LpelStreamRead(in);
+    id = item >> 32;
+    seq = (item & 0xffffffffL) - 1;
+    assert( id >= 0 && id < NUM_WRITERS );
+    if (seq != next[id]) {
+      fprintf(stderr, "Writer %ld: got item %ld, expected %ld\n",
+          id, seq, next[id]);
+      failures++;
+    }
+    next[id] = seq + 1;
+  }
+  LpelStreamClose(in, 1);
+  printf("Read %ld items of %d writers\n", n, NUM_WRITERS);
+  LpelStop();
+  return NULL;
+}
+
+
+static void testMultiProducer(void)
+{
+  lpel_config_t cfg;
+  lpel_task_t *t;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  mpsc = LpelStreamCreateMultiProducer(STREAM_SIZE);
+  LpelTaskStart(LpelTaskCreate(0, Reader, NULL, 8192));
+  for (i=0; i<NUM_WRITERS; i++) {
+    if (i % 5 == 4) {
+      t = LpelTaskCreate(LPEL_MAP_OTHERS, Writer, (void *) i, 8192);
+    } else if (i % 2 == 0) {
+      t = LpelTaskCreateShared((int) (i % 2), Writer, (void *) i);
+    } else {
+      t = LpelTaskCreate((int) (i % 2), Writer, (void *) i, 8192);
+    }
+    LpelTaskStart(t);
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testMultiProducer();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
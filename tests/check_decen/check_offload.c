@@ -0,0 +1,102 @@
+/*
+ * Blocking calls offloaded to helper threads.
+ *
+ * NUM_CALLERS tasks, on both workers and on a wrapper, offload a few
+ * blocking calls each and check their results. A ticker on worker 0
+ * yields all the time; every caller on worker 0 has to see it make
+ * progress during its calls, as the worker must not block on them.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "lpel.h"
+
+#define NUM_CALLERS  40
+#define NUM_CALLS    3
+#define NUM_THREADS  8
+
+static volatile int done = 0;
+static volatile int failures = 0;
+static volatile long ticks = 0;
+
+
+static void *Blocking(void *arg)
+{
+  usleep(20000);
+  return (void *) ((long) arg * 2);
+}
+
+
+static void *Caller(void *arg)
+{
+  long id = (long) arg;
+  long before, val, result;
+  int k;
+
+  for (k=0; k<NUM_CALLS; k++) {
+    val = id * 100 + k;
+    before = ticks;
+    result = (long) LpelTaskOffload(Blocking, (void *) val);
+    if (result != 2 * val) {
+      printf("Caller %ld: got %ld, expected %ld\n", id, result, 2 * val);
+      __sync_fetch_and_add(&failures, 1);
+    }
+    if (id % 2 == 0 && ticks == before) {
+      printf("Caller %ld: worker blocked during the call\n", id);
+      __sync_fetch_and_add(&failures, 1);
+    }
+  }
+  __sync_fetch_and_add(&done, 1);
+  return NULL;
+}
+
+
+static void *Ticker(void *arg)
+{
+  while (done < NUM_CALLERS) {
+    ticks++;
+    LpelTaskYield();
+  }
+  printf("Ticker ran %ld times\n", ticks);
+  LpelStop();
+  return NULL;
+}
+
+
+static void testOffload(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelWorkerSetOffloadThreads(NUM_THREADS);
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  LpelTaskStart(LpelTaskCreate(0, Ticker, NULL, 8192));
+  /* odd callers on worker 1, the first odd one on a wrapper */
+  for (i=0; i<NUM_CALLERS; i++) {
+    LpelTaskStart(LpelTaskCreate(i == 1 ? LPEL_MAP_OTHERS : (int) (i % 2),
+          Caller, (void *) i, 8192));
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testOffload();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * In-place access to value streams.
+ *
+ * NUM_PAIRS producers pass NUM_VALUES values to their consumers over
+ * value streams of different sizes. The producers reserve a random
+ * number of values and commit all, some or none of them, or write a
+ * value with LpelStreamWriteValue now and then; the consumers acquire
+ * a random number of values and release all, some or none of them, or
+ * read a single value. Space or values not committed resp. released
+ * must be handed out again, starting at the same address: if any were
+ * lost, the single-value stream would stall. Every value has to arrive
+ * once and in order.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpel.h"
+
+#define NUM_PAIRS   3
+#define NUM_VALUES  200000L
+
+typedef struct {
+  long seq;
+  char pad[20];
+} value_t;
+
+static lpel_stream_t *streams[NUM_PAIRS];
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == 2 * NUM_PAIRS) LpelStop();
+}
+
+
+static void Fail(const char *msg, long id, long seq)
+{
+  printf("Pair %ld: %s at value %ld\n", id, msg, seq);
+  __sync_fetch_and_add(&failures, 1);
+}
+
+
+static unsigned int Random(unsigned int *r)
+{
+  *r = *r * 1103515245 + 12345;
+  return (*r >> 8);
+}
+
+
+static void *Producer(void *arg)
+{
+  long id = (long) arg;
+  lpel_stream_desc_t *out = LpelStreamOpen(streams[id], 'w');
+  unsigned int r = (unsigned int) id + 1;
+  long seq = 0;
+  value_t *first, *again, v;
+  int want, n, c, i;
+
+  while (seq < NUM_VALUES) {
+    if (Random(&r) % 16 == 0) {
+      v.seq = seq++;
+      LpelStreamWriteValue(out, &v);
+      continue;
+    }
+    want = Random(&r) % 9 + 1;
+    n = want;
+    first = (value_t *) LpelStreamReserve(out, &n);
+    if (n < 1 || n > want) Fail("reserved a wrong number", id, seq);
+
+    switch (Random(&r) % 4) {
+      case 0:
+        /* none: the same space has to be reserved again */
+        LpelStreamCommit(out, 0);
+        n = 1;
+        again = (value_t *) LpelStreamReserve(out, &n);
+        if (again != first) Fail("space not reserved again", id, seq);
+        c = 1;
+        break;
+      case 1:
+        c = n / 2 + (n == 1);
+        break;
+      default:
+        c = n;
+        break;
+    }
+    if (c > NUM_VALUES - seq) c = (int) (NUM_VALUES - seq);
+    for (i=0; i<c; i++) first[i].seq = seq++;
+    LpelStreamCommit(out, c);
+  }
+  LpelStreamClose(out, 0);
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Consumer(void *arg)
+{
+  long id = (long) arg;
+  lpel_stream_desc_t *in = LpelStreamOpen(streams[id], 'r');
+  unsigned int r = (unsigned int) id + 7;
+  long seq = 0;
+  value_t *first, *again, v;
+  int want, n, c, i;
+
+  while (seq < NUM_VALUES) {
+    if (Random(&r) % 16 == 0) {
+      LpelStreamReadValue(in, &v);
+      if (v.seq != seq) Fail("read a wrong value", id, seq);
+      seq++;
+      continue;
+    }
+    want = Random(&r) % 7 + 1;
+    n = want;
+    first = (value_t *) LpelStreamAcquire(in, &n);
+    if (n < 1 || n > want) Fail("acquired a wrong number", id, seq);
+
+    switch (Random(&r) % 4) {
+      case 0:
+        /* none: the same values have to be acquired again */
+        LpelStreamRelease(in, 0);
+        n = 1;
+        again = (value_t *) LpelStreamAcquire(in, &n);
+        if (again != first) Fail("values not acquired again", id, seq);
+        c = 1;
+        break;
+      case 1:
+        c = n / 2 + (n == 1);
+        break;
+      default:
+        c = n;
+        break;
+    }
+    for (i=0; i<c; i++) {
+      if (first[i].seq != seq) Fail("acquired a wrong value", id, seq);
+      seq++;
+    }
+    LpelStreamRelease(in, c);
+  }
+  LpelStreamClose(in, 1);
+  TaskDone();
+  return NULL;
+}
+
+
+static void testReserve(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  /* single, 5 and 10 values */
+  for (i=0; i<NUM_PAIRS; i++) {
+    streams[i] = LpelStreamCreateValue(i == 0 ? 1 : (int) (i * 5),
+        sizeof(value_t));
+    LpelTaskStart(LpelTaskCreate((int) (i % 2), Consumer, (void *) i, 8192));
+    LpelTaskStart(LpelTaskCreate(i == 2 ? LPEL_MAP_OTHERS : (int) ((i+1) % 2),
+          Producer, (void *) i, 8192));
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testReserve();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
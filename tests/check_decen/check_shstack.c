@@ -0,0 +1,155 @@
+/*
+ * Ring of shared-stack tasks, with wait-proportion task migration.
+ *
+ * The monitoring callbacks below claim that every task waits too much,
+ * so the scheduler tries to migrate every task on every wakeup. Tasks
+ * with a shared stack (and every third task has one of its own) must
+ * stay on their worker nonetheless: their frames may still be on the
+ * shared stack of that worker. Each task checks its frames after
+ * every hop of the token.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "lpel.h"
+
+#define NUM_WORKERS  3
+#define NUM_TASKS    300
+#define ROUNDS       20
+#define FRAME_SIZE   256
+
+
+/* dummy monitoring objects, the callbacks only need them to be non-NULL */
+static char dummy_mon[NUM_TASKS];
+static volatile int next_worker = 0;
+
+
+static void MonTaskDummy(mon_task_t *mt) { (void) mt; }
+static void MonTaskAssign(mon_task_t *mt, mon_worker_t *mw)
+{ (void) mt; (void) mw; }
+static void MonTaskStop(mon_task_t *mt, lpel_taskstate_t state)
+{ (void) mt; (void) state; }
+static double MonTaskWait(mon_task_t *mt) { (void) mt; return 1.0; }
+static double MonWorkerWait(mon_task_t *mt) { (void) mt; return 0.5; }
+static double MonGlobalWait(void) { return 0.0; }
+
+/* a different worker every time */
+static int MonMostWait(void)
+{
+  return __sync_fetch_and_add(&next_worker, 1) % NUM_WORKERS;
+}
+
+
+static lpel_stream_t *ring[NUM_TASKS];
+
+
+/* puts a frame of its own on the stack for every level,
+ * passes the token on at the bottom and checks the frames on the way up */
+static void Hop(int id, int depth, lpel_stream_desc_t *in,
+    lpel_stream_desc_t *out, int last)
+{
+  volatile char frame[FRAME_SIZE];
+  int i;
+
+  memset((char *) frame, (id + depth) & 0xff, FRAME_SIZE);
+  if (depth > 0) {
+    Hop(id, depth-1, in, out, last);
+  } else {
+    void *token = LpelStreamRead(in);
+    assert( token != NULL );
+    if (!last) LpelStreamWrite(out, token);
+  }
+  for (i=0; i<FRAME_SIZE; i++) {
+    if (frame[i] != (char) ((id + depth) & 0xff)) {
+      fprintf(stderr, "Task %d: frame %d corrupted\n", id, depth);
+      abort();
+    }
+  }
+}
+
+
+static void *Node(void *arg)
+{
+  int id = (int)(long) arg;
+  int r;
+  lpel_stream_desc_t *in, *out;
+
+  in = LpelStreamOpen(ring[id], 'r');
+  out = LpelStreamOpen(ring[(id+1) % NUM_TASKS], 'w');
+
+  if (id == 0) LpelStreamWrite(out, ring);
+  for (r=0; r<ROUNDS; r++) {
+    Hop(id, id % 4, in, out, id == 0 && r == ROUNDS-1);
+  }
+  LpelStreamClose(in, 1);
+  LpelStreamClose(out, 0);
+
+  if (id == 0) {
+    printf("Token passed %d rounds\n", ROUNDS);
+    LpelStop();
+  }
+  return NULL;
+}
+
+
+static void testSharedRing(void)
+{
+  lpel_config_t cfg;
+  lpel_tm_config_t tm;
+  lpel_task_t *t;
+  long nproc;
+  int i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = NUM_WORKERS;
+  nproc = sysconf(_SC_NPROCESSORS_ONLN);
+  cfg.proc_workers = (nproc > 0 && nproc < NUM_WORKERS) ?
+    (int) nproc : NUM_WORKERS;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.mon.task_destroy = MonTaskDummy;
+  cfg.mon.task_assign = MonTaskAssign;
+  cfg.mon.task_start = MonTaskDummy;
+  cfg.mon.task_stop = MonTaskStop;
+  cfg.mon.get_task_wait_prop = MonTaskWait;
+  cfg.mon.get_worker_wait_prop = MonWorkerWait;
+  cfg.mon.get_global_wait_prop = MonGlobalWait;
+  cfg.mon.worker_most_wait_prop = MonMostWait;
+
+  LpelInit(&cfg);
+  if (LpelStart(&cfg) != 0) {
+    fprintf(stderr, "LpelStart failed\n");
+    exit(EXIT_FAILURE);
+  }
+
+  /* after LpelStart, which installs the monitoring callbacks */
+  tm.threshold = 0.0;
+  tm.num_workers = NUM_WORKERS;
+  tm.mechanism = LPEL_MIG_WAIT_PROP;
+  LpelTaskMigrationInit(&tm);
+
+  for (i=0; i<NUM_TASKS; i++) {
+    ring[i] = LpelStreamCreate(0);
+  }
+  for (i=0; i<NUM_TASKS; i++) {
+    if (i % 3 == 0) {
+      t = LpelTaskCreate(i % NUM_WORKERS, Node, (void *)(long) i, 16384);
+    } else {
+      t = LpelTaskCreateShared(i % NUM_WORKERS, Node, (void *)(long) i);
+    }
+    LpelTaskMonitor(t, (mon_task_t *) &dummy_mon[i]);
+    LpelTaskStart(t);
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testSharedRing();
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Task sleep on the timer wheels of the workers.
+ *
+ * Sleepers on both workers and on a wrapper sleep for durations within
+ * the first and the second level of the wheel, one waits for an absolute
+ * time. None of them may wake up early. A ticker on worker 0 yields all
+ * the time, it has to keep running while its neighbours sleep.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpel.h"
+#include <lpel/timing.h>
+
+#define NUM_SLEEPERS  20
+#define NUM_TASKS     (NUM_SLEEPERS + 1)
+
+static volatile int sleeping = NUM_TASKS;
+static volatile int failures = 0;
+static volatile long ticks = 0;
+
+
+static double ElapsedUsec(const lpel_timing_t *start)
+{
+  lpel_timing_t end, diff;
+
+  LpelTimingNow(&end);
+  LpelTimingDiff(&diff, start, &end);
+  return LpelTimingToNSec(&diff) / 1000.0;
+}
+
+
+static void TaskDone(void)
+{
+  __sync_fetch_and_sub(&sleeping, 1);
+}
+
+
+static void *Sleeper(void *arg)
+{
+  unsigned long usec = (unsigned long) arg;
+  lpel_timing_t start;
+  double elapsed;
+
+  LpelTimingNow(&start);
+  LpelTaskSleep(usec);
+  elapsed = ElapsedUsec(&start);
+  if (elapsed < usec) {
+    printf("Sleeper woke up after %.0f of %lu usec\n", elapsed, usec);
+    __sync_fetch_and_add(&failures, 1);
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Waiter(void *arg)
+{
+  lpel_timing_t start, until;
+  double elapsed;
+
+  LpelTimingNow(&start);
+  until = start;
+  until.tv_nsec += 50000000L;
+  if (until.tv_nsec >= 1000000000L) {
+    until.tv_sec++;
+    until.tv_nsec -= 1000000000L;
+  }
+  LpelTaskWaitUntil(&until);
+  elapsed = ElapsedUsec(&start);
+  if (elapsed < 50000.0) {
+    printf("Waiter woke up after %.0f usec\n", elapsed);
+    __sync_fetch_and_add(&failures, 1);
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Ticker(void *arg)
+{
+  while (sleeping > 0) {
+    ticks++;
+    LpelTaskYield();
+  }
+  printf("Ticker ran %ld times\n", ticks);
+  LpelStop();
+  return NULL;
+}
+
+
+static void testSleep(void)
+{
+  lpel_config_t cfg;
+  unsigned long usec;
+  int i, map;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  LpelTaskStart(LpelTaskCreate(0, Ticker, NULL, 8192));
+  for (i=0; i<NUM_SLEEPERS; i++) {
+    /* 1 to 121 msec, and 300 msec on the second level */
+    usec = (i == 0) ? 300000 : (i % 5) * 30000 + 1000;
+    map = (i % 4 == 3) ? LPEL_MAP_OTHERS : i % 2;
+    LpelTaskStart(LpelTaskCreate(map, Sleeper, (void *) usec, 8192));
+  }
+  LpelTaskStart(LpelTaskCreate(1, Waiter, NULL, 8192));
+
+  LpelCleanup();
+  if (ticks == 0) failures++;
+}
+
+
+int main(void)
+{
+  testSleep();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
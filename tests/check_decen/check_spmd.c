@@ -0,0 +1,205 @@
+/*
+ * SPMD regions on subsets of the workers.
+ *
+ * Two requesters enter regions on the disjoint subsets {0,1} and {2,3}.
+ * First each region waits for the other one to be entered as well, so
+ * they have to run at the same time. Then both requesters and a third
+ * one, which enters regions on all workers, repeat their requests
+ * ROUNDS times. Each participant checks LpelSpmdNumWorkers() and its
+ * virtual id, and logs the regions it runs on its worker. Overlapping
+ * regions have to run one after the other, in the same order on all
+ * the workers they share.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpel.h"
+#include <lpel/timing.h>
+
+#define NUM_WORKERS     4
+#define NUM_REQUESTERS  3
+#define ROUNDS          200
+#define MEET_USEC       2000000.0
+
+typedef struct {
+  int owner;
+  int round;
+  int size;
+  int members[NUM_WORKERS];   /* worker ids by virtual id */
+  volatile int entered;
+} region_t;
+
+static const int subsets[NUM_REQUESTERS][NUM_WORKERS] = {
+  { 0, 1 }, { 2, 3 }, { 0, 1, 2, 3 }
+};
+static const int subset_size[NUM_REQUESTERS] = { 2, 2, NUM_WORKERS };
+static const int requester_worker[NUM_REQUESTERS] = { 0, 2, 1 };
+
+/* the regions run on each worker, written by that worker only */
+static int logs[NUM_WORKERS][NUM_REQUESTERS * (ROUNDS + 1)];
+static int log_len[NUM_WORKERS];
+
+static volatile int inside[NUM_REQUESTERS];
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void Fail(const char *msg, int owner, int round)
+{
+  printf("Region %d/%d: %s\n", owner, round, msg);
+  __sync_fetch_and_add(&failures, 1);
+}
+
+
+static double ElapsedUsec(const lpel_timing_t *start)
+{
+  lpel_timing_t end, diff;
+
+  LpelTimingNow(&end);
+  LpelTimingDiff(&diff, start, &end);
+  return LpelTimingToNSec(&diff) / 1000.0;
+}
+
+
+static void Region(void *arg)
+{
+  region_t *r = (region_t *) arg;
+  int vid = LpelSpmdVId();
+  int wid, other;
+  lpel_timing_t start;
+
+  if (LpelSpmdNumWorkers() != r->size) {
+    Fail("wrong number of workers", r->owner, r->round);
+  }
+  if (vid < 0 || vid >= r->size) {
+    Fail("wrong virtual id", r->owner, r->round);
+    return;
+  }
+  __sync_fetch_and_or(&r->entered, 1 << vid);
+  wid = r->members[vid];
+  logs[wid][log_len[wid]++] = r->owner * (ROUNDS + 1) + r->round;
+
+  if (r->round == 0 && vid == 0) {
+    /* the disjoint region has to be entered while this one runs */
+    other = 1 - r->owner;
+    inside[r->owner] = 1;
+    LpelTimingNow(&start);
+    while (!inside[other] && ElapsedUsec(&start) < MEET_USEC) ;
+    if (!inside[other]) {
+      Fail("disjoint region did not run concurrently", r->owner, r->round);
+    }
+  }
+}
+
+
+static void Enter(int owner, int round)
+{
+  region_t r;
+  int i, self = LpelTaskGetWorkerId(LpelTaskSelf());
+
+  r.owner = owner;
+  r.round = round;
+  r.size = 0;
+  r.entered = 0;
+  /* the requester has virtual id 0, the others follow in order */
+  r.members[r.size++] = self;
+  for (i=0; i<subset_size[owner]; i++) {
+    if (subsets[owner][i] != self) r.members[r.size++] = subsets[owner][i];
+  }
+  LpelTaskEnterSPMDSet(Region, &r, subsets[owner], subset_size[owner]);
+  if (r.entered != (1 << r.size) - 1) Fail("not entered by all", owner, round);
+}
+
+
+static void *Requester(void *arg)
+{
+  long id = (long) arg;
+  int k;
+
+  if (id < 2) {
+    Enter(id, 0);
+    /* both have met, the third one may start */
+    if (__sync_add_and_fetch(&done, 1) == 2) {
+      LpelTaskStart(LpelTaskCreate(requester_worker[2], Requester,
+            (void *) 2L, 8192));
+    }
+  }
+  for (k=1; k<=ROUNDS; k++) Enter(id, k);
+
+  if (__sync_add_and_fetch(&done, 1) == 2 + NUM_REQUESTERS) LpelStop();
+  return NULL;
+}
+
+
+/* the regions of a and b on a worker, in the order they ran there */
+static int Order(int wid, int a, int b, int *order)
+{
+  int i, n = 0;
+
+  for (i=0; i<log_len[wid]; i++) {
+    int owner = logs[wid][i] / (ROUNDS + 1);
+    if (owner == a || owner == b) order[n++] = logs[wid][i];
+  }
+  return n;
+}
+
+
+static void CheckOrder(void)
+{
+  static int first[NUM_REQUESTERS * (ROUNDS + 1)];
+  static int order[NUM_REQUESTERS * (ROUNDS + 1)];
+  int a, w, n, m, common;
+
+  /* the full set overlaps with both subsets, on two workers each */
+  for (a=0; a<2; a++) {
+    common = -1;
+    for (w=0; w<subset_size[a]; w++) {
+      if (common < 0) {
+        common = subsets[a][w];
+        n = Order(common, a, 2, first);
+        if (n != 2 * ROUNDS + 1) Fail("regions missing", a, n);
+      } else {
+        m = Order(subsets[a][w], a, 2, order);
+        if (m != n || memcmp(first, order, n * sizeof(int)) != 0) {
+          Fail("overlapping regions ran in a different order", a, -1);
+        }
+      }
+    }
+  }
+}
+
+
+static void testSpmd(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = NUM_WORKERS;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  for (i=0; i<2; i++) {
+    LpelTaskStart(LpelTaskCreate(requester_worker[i], Requester,
+          (void *) i, 8192));
+  }
+
+  LpelCleanup();
+  CheckOrder();
+}
+
+
+int main(void)
+{
+  testSpmd();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
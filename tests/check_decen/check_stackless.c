@@ -0,0 +1,149 @@
+/*
+ * Pipeline of stackless tasks.
+ *
+ * A producer writes NUM_ITEMS items into a small stream, so it blocks
+ * on the first stackless filter most of the time; it also sleeps now
+ * and then, so that the filters run dry and wait for their input. Each
+ * of the NUM_FILTERS filters, spread over both workers, increments the
+ * items and passes them on with LpelStreamTryWrite to a small stream.
+ * If it is full, the filter returns LPEL_REC_RETRY, waits for space and
+ * gets the item again. On the end marker a filter terminates. The
+ * consumer checks that every item has passed every filter, in order, and
+ * that the filters had to wait for space.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpel.h"
+
+#define NUM_FILTERS  8
+#define NUM_ITEMS    100000L
+#define IN_SIZE      16
+#define OUT_SIZE     4
+
+#define END  ((void *) -1L)
+
+typedef struct {
+  int id;
+  long cnt;
+  long retries;
+  lpel_stream_desc_t *out;
+} filter_t;
+
+static lpel_stream_t *pipe_s[NUM_FILTERS + 1];
+static filter_t filters[NUM_FILTERS];
+static volatile int failures = 0;
+
+
+static int Filter(void *item, void *arg)
+{
+  filter_t *f = (filter_t *) arg;
+  void *next = item;
+
+  /* the output is opened within the task as well */
+  if (f->out == NULL) f->out = LpelStreamOpen(pipe_s[f->id+1], 'w');
+
+  if (item != END) next = (void *) ((long) item + 1);
+  if (LpelStreamTryWrite(f->out, next) != 0) {
+    /* the output is full, the same item comes again */
+    f->retries++;
+    return LPEL_REC_RETRY;
+  }
+  if (item == END) {
+    LpelStreamClose(f->out, 0);
+    return 1;
+  }
+  f->cnt++;
+  return 0;
+}
+
+
+static void *Producer(void *arg)
+{
+  lpel_stream_desc_t *out = LpelStreamOpen(pipe_s[0], 'w');
+  long i;
+
+  for (i=1; i<=NUM_ITEMS; i++) {
+    LpelStreamWrite(out, (void *) i);
+    if (i % 5000 == 0) LpelTaskSleep(1000);
+  }
+  LpelStreamWrite(out, END);
+  LpelStreamClose(out, 0);
+  return NULL;
+}
+
+
+static void *Consumer(void *arg)
+{
+  lpel_stream_desc_t *in = LpelStreamOpen(pipe_s[NUM_FILTERS], 'r');
+  long expected = 1 + NUM_FILTERS, retries = 0;
+  void *item;
+  int i;
+
+  while ((item = LpelStreamRead(in)) != END) {
+    if ((long) item != expected) {
+      printf("Got item %ld, expected %ld\n", (long) item, expected);
+      failures++;
+    }
+    expected = (long) item + 1;
+  }
+  LpelStreamClose(in, 1);
+
+  for (i=0; i<NUM_FILTERS; i++) {
+    if (filters[i].cnt != NUM_ITEMS) {
+      printf("Filter %d passed %ld items\n", i, filters[i].cnt);
+      failures++;
+    }
+    retries += filters[i].retries;
+  }
+  if (retries == 0) {
+    printf("The outputs of the filters were never full\n");
+    failures++;
+  }
+  printf("Passed %ld items through %d filters, %ld retries\n",
+      expected - 1 - NUM_FILTERS, NUM_FILTERS, retries);
+  LpelStop();
+  return NULL;
+}
+
+
+static void testStackless(void)
+{
+  lpel_config_t cfg;
+  int i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  pipe_s[0] = LpelStreamCreate(IN_SIZE);
+  for (i=1; i<=NUM_FILTERS; i++) {
+    pipe_s[i] = LpelStreamCreate(OUT_SIZE);
+  }
+  for (i=0; i<NUM_FILTERS; i++) {
+    filters[i].id = i;
+    LpelTaskStart(LpelTaskCreateStackless(i % 2, Filter, &filters[i],
+          pipe_s[i]));
+  }
+  LpelTaskStart(LpelTaskCreate(1, Consumer, NULL, 8192));
+  LpelTaskStart(LpelTaskCreate(0, Producer, NULL, 8192));
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testStackless();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
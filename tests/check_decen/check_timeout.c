@@ -0,0 +1,182 @@
+/*
+ * Stream reads with a timeout.
+ *
+ * Each consumer, one on a worker and one on a wrapper, first waits on
+ * empty streams and has to time out no earlier than requested. Then a
+ * producer writes NUM_ITEMS items to each of its two streams, sleeping
+ * and yielding in between, so that reads with short timeouts race the
+ * writes: the consumer mixes LpelStreamTryRead and LpelStreamReadTimeout
+ * on the first stream and polls the second with LpelStreamPollTimeout.
+ * Every item has to arrive exactly once and in order.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "lpel.h"
+#include <lpel/timing.h>
+
+#define NUM_CONSUMERS  2
+#define NUM_ITEMS      3000L
+#define EXPIRE_USEC    20000
+
+static lpel_stream_t *first[NUM_CONSUMERS], *second[NUM_CONSUMERS];
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void Fail(const char *msg, long id, long val)
+{
+  printf("Consumer %ld: %s (%ld)\n", id, msg, val);
+  __sync_fetch_and_add(&failures, 1);
+}
+
+
+static double ElapsedUsec(const lpel_timing_t *start)
+{
+  lpel_timing_t end, diff;
+
+  LpelTimingNow(&end);
+  LpelTimingDiff(&diff, start, &end);
+  return LpelTimingToNSec(&diff) / 1000.0;
+}
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == NUM_CONSUMERS) LpelStop();
+}
+
+
+static void Produce(lpel_stream_t *s)
+{
+  lpel_stream_desc_t *out = LpelStreamOpen(s, 'w');
+  long i;
+
+  for (i=1; i<=NUM_ITEMS; i++) {
+    LpelStreamWrite(out, (void *) i);
+    if (i % 7 == 0) {
+      LpelTaskSleep((i * 37) % 1500);
+    } else if (i % 3 == 0) {
+      LpelTaskYield();
+    }
+  }
+  LpelStreamClose(out, 0);
+}
+
+
+static void *Producer(void *arg)
+{
+  long id = (long) arg;
+
+  Produce(first[id]);
+  Produce(second[id]);
+  return NULL;
+}
+
+
+static void *Consumer(void *arg)
+{
+  long id = (long) arg;
+  lpel_stream_desc_t *in1, *in2, *sd;
+  lpel_streamset_t set = NULL;
+  lpel_timing_t start;
+  long expected, timeouts = 0;
+  void *item;
+
+  in1 = LpelStreamOpen(first[id], 'r');
+  in2 = LpelStreamOpen(second[id], 'r');
+  LpelStreamsetPut(&set, in2);
+
+  /* the producer has not been started yet, both have to expire */
+  LpelTimingNow(&start);
+  if (LpelStreamReadTimeout(in1, EXPIRE_USEC) != NULL) {
+    Fail("read from an empty stream", id, 0);
+  }
+  if (ElapsedUsec(&start) < EXPIRE_USEC) Fail("read timed out early", id, 0);
+  LpelTimingNow(&start);
+  if (LpelStreamPollTimeout(&set, EXPIRE_USEC) != NULL) {
+    Fail("polled an empty stream", id, 0);
+  }
+  if (ElapsedUsec(&start) < EXPIRE_USEC) Fail("poll timed out early", id, 0);
+
+  LpelTaskStart(LpelTaskCreate(id == 0 ? 1 : LPEL_MAP_OTHERS,
+        Producer, (void *) id, 8192));
+
+  expected = 1;
+  while (expected <= NUM_ITEMS) {
+    if (expected % 3 == 0) {
+      item = LpelStreamTryRead(in1);
+      if (item == NULL) {
+        LpelTaskYield();
+        continue;
+      }
+    } else {
+      item = LpelStreamReadTimeout(in1, 300);
+      if (item == NULL) {
+        timeouts++;
+        continue;
+      }
+    }
+    if ((long) item != expected) Fail("read out of order", id, (long) item);
+    expected = (long) item + 1;
+  }
+
+  expected = 1;
+  while (expected <= NUM_ITEMS) {
+    sd = LpelStreamPollTimeout(&set, 200);
+    if (sd == NULL) {
+      timeouts++;
+      continue;
+    }
+    item = LpelStreamRead(sd);
+    if ((long) item != expected) Fail("polled out of order", id, (long) item);
+    expected = (long) item + 1;
+  }
+
+  /* all items consumed, nothing may show up any more */
+  if (LpelStreamReadTimeout(in1, 2000) != NULL) Fail("extra item", id, 0);
+
+  printf("Consumer %ld: %ld timeouts\n", id, timeouts);
+  LpelStreamClose(in1, 1);
+  LpelStreamClose(in2, 1);
+  TaskDone();
+  return NULL;
+}
+
+
+static void testTimeout(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  for (i=0; i<NUM_CONSUMERS; i++) {
+    first[i] = LpelStreamCreate(4);
+    second[i] = LpelStreamCreate(4);
+    LpelTaskStart(LpelTaskCreate(i == 0 ? 0 : LPEL_MAP_OTHERS,
+          Consumer, (void *) i, 8192));
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testTimeout();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
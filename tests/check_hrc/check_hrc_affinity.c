@@ -0,0 +1,86 @@
+/*
+ * Worker affinity.
+ *
+ * NUM_TASKS tasks of equal priority share two workers and yield ROUNDS
+ * times each. With an affinity tolerance, the master dispatches a task
+ * back to the worker it ran on last whenever that worker asks for one, so
+ * the tasks have to stay on their workers for almost all of the yields.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "hrc_lpel.h"
+
+#define NUM_TASKS      8
+#define ROUNDS         200
+#define WORK_USEC      100
+#define AFFINITY_TOL   1.0
+
+static volatile int migrations = 0;
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void *Yielder(void *arg)
+{
+  lpel_task_t *self = LpelTaskSelf();
+  int i, wid, last = LpelTaskGetWorkerId(self);
+
+  for (i=0; i<ROUNDS; i++) {
+    /* blocks the worker thread, not the task: the master gets to run */
+    usleep(WORK_USEC);
+    LpelTaskYield();
+    wid = LpelTaskGetWorkerId(self);
+    if (wid != last) {
+      __sync_fetch_and_add(&migrations, 1);
+      last = wid;
+    }
+  }
+
+  if (__sync_add_and_fetch(&done, 1) == NUM_TASKS) LpelStop();
+  return arg;
+}
+
+
+static void testAffinity(void)
+{
+  lpel_config_t cfg;
+  int i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and two workers */
+  cfg.num_workers = 3;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelWorkerSetAffinityTol(AFFINITY_TOL);
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  for (i=0; i<NUM_TASKS; i++) {
+    LpelTaskStart(LpelTaskCreate(0, Yielder, NULL, 8192));
+  }
+
+  LpelCleanup();
+
+  printf("%d migrations in %d yields\n", migrations, NUM_TASKS * ROUNDS);
+  if (migrations > NUM_TASKS * ROUNDS / 10) {
+    printf("Tasks did not stay on their workers\n");
+    failures++;
+  }
+}
+
+
+int main(void)
+{
+  testAffinity();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
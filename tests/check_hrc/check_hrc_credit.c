@@ -0,0 +1,120 @@
+/*
+ * Credit-bounded middle stream.
+ *
+ * A producer writes NUM_ITEMS items over a middle stream with a single
+ * credit to a slow consumer, which sleeps now and then. In the first
+ * half the producer yields after every write: having used up its
+ * credit, it has to be held back by the master until the consumer has
+ * taken the item, so it must never be dispatched while the consumer is
+ * still behind. In the second half it writes back to back and blocks
+ * on the missing credit instead. The producer may never be more than
+ * CREDIT items ahead, and the consumer checks the order.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hrc_lpel.h"
+
+#define NUM_ITEMS  2000L
+#define CREDIT     1
+
+static lpel_stream_t *middle;
+static volatile long consumed = 0;
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == 2) LpelStop();
+}
+
+
+static void *Producer(void *arg)
+{
+  lpel_stream_desc_t *out = LpelStreamOpen(middle, 'w');
+  long i, held = 0;
+
+  for (i=1; i<=NUM_ITEMS; i++) {
+    LpelStreamWrite(out, (void *) i);
+    if (i - consumed > CREDIT) {
+      printf("Producer: wrote item %ld with %ld consumed\n", i, consumed);
+      failures++;
+    }
+    if (i > NUM_ITEMS / 2) continue;
+
+    if (i - consumed == CREDIT) {
+      /* out of credits, held until the consumer has taken an item */
+      held++;
+      LpelTaskYield();
+      if (i - consumed >= CREDIT) {
+        printf("Producer: dispatched without credit at item %ld\n", i);
+        failures++;
+      }
+    } else {
+      LpelTaskYield();
+    }
+  }
+  LpelStreamClose(out, 0);
+
+  printf("Producer: held %ld times\n", held);
+  if (held == 0) failures++;
+  TaskDone();
+  return arg;
+}
+
+
+static void *Consumer(void *arg)
+{
+  lpel_stream_desc_t *in = LpelStreamOpen(middle, 'r');
+  long i, item;
+
+  for (i=1; i<=NUM_ITEMS; i++) {
+    if (i % 10 == 0) LpelTaskSleep(500);
+    item = (long) LpelStreamRead(in);
+    if (item != i) {
+      printf("Consumer: got item %ld, expected %ld\n", item, i);
+      failures++;
+    }
+    consumed = i;
+  }
+  LpelStreamClose(in, 1);
+  TaskDone();
+  return arg;
+}
+
+
+static void testCredit(void)
+{
+  lpel_config_t cfg;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and a worker */
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  middle = LpelStreamCreate(0);
+  LpelStreamSetCredit(middle, CREDIT);
+  LpelTaskStart(LpelTaskCreate(0, Consumer, NULL, 8192));
+  LpelTaskStart(LpelTaskCreate(0, Producer, NULL, 8192));
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testCredit();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
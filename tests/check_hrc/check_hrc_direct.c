@@ -0,0 +1,84 @@
+/*
+ * Direct switches between tasks.
+ *
+ * Two tasks share the only worker and yield to each other ROUNDS times.
+ * Before each yield, a task keeps the worker thread busy for a while, in
+ * which the master can answer the worker's request for the next task.
+ * When the task yields, the other one has been assigned already, and the
+ * worker has to switch to it directly for most of the yields.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "hrc_lpel.h"
+
+#define ROUNDS      200
+#define WORK_USEC   200
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void *Yielder(void *arg)
+{
+  int i;
+  long n;
+
+  for (i=0; i<ROUNDS; i++) {
+    /* blocks the worker thread, not the task: the master gets to run */
+    usleep(WORK_USEC);
+    LpelTaskYield();
+  }
+
+  if (__sync_add_and_fetch(&done, 1) == 2) {
+    n = LpelWorkerDirectSwitches(0);
+    printf("%ld direct switches in %d yields\n", n, 2 * ROUNDS);
+    if (n < ROUNDS || n > 2 * ROUNDS) {
+      printf("The next task was not switched to directly\n");
+      failures++;
+    }
+    if (LpelWorkerDirectSwitches(1) != -1) {
+      printf("Direct switches counted for an unknown worker\n");
+      failures++;
+    }
+    LpelStop();
+  }
+  return arg;
+}
+
+
+static void testDirect(void)
+{
+  lpel_config_t cfg;
+  int i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and a worker */
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  for (i=0; i<2; i++) {
+    LpelTaskStart(LpelTaskCreate(0, Yielder, NULL, 8192));
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testDirect();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
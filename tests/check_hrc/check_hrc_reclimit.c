@@ -0,0 +1,166 @@
+/*
+ * Adaptive record limit.
+ *
+ * A producer with an adaptive record limit spends a fixed time on each
+ * of the NUM_ITEMS records it writes to a consumer, first CHEAP_USEC,
+ * then ten times as long. The record limit has to follow the cost per
+ * record: after each phase it has to be close to the slice divided by
+ * the cost, and it has to drop by about the factor the cost went up.
+ *
+ * Records are counted only if the monitoring tells them from control
+ * items; a minimal monitoring does this here, as S-Net would.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hrc_lpel.h"
+#include <lpel/timing.h>
+
+#define NUM_ITEMS   6000L
+#define SLICE_USEC  2000
+#define CHEAP_USEC  10
+#define DEAR_USEC   100
+
+static lpel_stream_t *items;
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == 2) LpelStop();
+}
+
+
+/* every item written by a monitored task is a data record */
+static mon_stream_t *StreamOpen(mon_task_t *mt, unsigned int sid, char mode)
+{
+  (void) sid;
+  (void) mode;
+  return (mon_stream_t *) mt;
+}
+
+
+static int IsData(void *item)
+{
+  (void) item;
+  return 1;
+}
+
+
+static void Spend(long usec)
+{
+  lpel_timing_t start, now, diff;
+
+  LpelTimingNow(&start);
+  do {
+    LpelTimingNow(&now);
+    LpelTimingDiff(&diff, &start, &now);
+  } while (LpelTimingToNSec(&diff) < usec * 1000.0);
+}
+
+
+static void *Consumer(void *arg)
+{
+  lpel_stream_desc_t *in = LpelStreamOpen(items, 'r');
+  long i, item;
+
+  for (i=1; i<=NUM_ITEMS; i++) {
+    item = (long) LpelStreamRead(in);
+    if (item != i) {
+      printf("Got item %ld, expected %ld\n", item, i);
+      failures++;
+    }
+  }
+  LpelStreamClose(in, 1);
+  TaskDone();
+  return arg;
+}
+
+
+static void CheckLimit(int lim, long usec)
+{
+  int expected = SLICE_USEC / usec;
+
+  printf("Record limit %d at %ld usec per record, expected %d\n",
+      lim, usec, expected);
+  /* the slice shrinks with the tasks waiting at the master, and the
+   * measured cost includes the writes */
+  if (lim < expected / 8 || lim > expected) {
+    printf("Record limit does not follow the cost per record\n");
+    failures++;
+  }
+}
+
+
+static void *Producer(void *arg)
+{
+  lpel_stream_desc_t *out = LpelStreamOpen(items, 'w');
+  lpel_task_t *self = LpelTaskSelf();
+  int cheap = 0, dear = 0;
+  long i;
+
+  /* the limit is recomputed at the end of every dispatch */
+  for (i=1; i<=NUM_ITEMS; i++) {
+    if (i <= NUM_ITEMS / 2) {
+      Spend(CHEAP_USEC);
+      if (i == NUM_ITEMS / 2) cheap = LpelTaskGetRecLimit(self);
+    } else {
+      Spend(DEAR_USEC);
+    }
+    LpelStreamWrite(out, (void *) i);
+  }
+  dear = LpelTaskGetRecLimit(self);
+  LpelStreamClose(out, 0);
+
+  CheckLimit(cheap, CHEAP_USEC);
+  CheckLimit(dear, DEAR_USEC);
+  if (cheap < 4 * dear) {
+    printf("Record limit dropped from %d to %d only\n", cheap, dear);
+    failures++;
+  }
+  TaskDone();
+  return arg;
+}
+
+
+static void testRecLimit(void)
+{
+  lpel_config_t cfg;
+  lpel_task_t *t;
+  static char tag;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and a worker */
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+  cfg.mon.stream_open = StreamOpen;
+  cfg.mon.rectype_data = IsData;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  items = LpelStreamCreate(0);
+  t = LpelTaskCreate(0, Producer, NULL, 8192);
+  LpelTaskMonitor(t, (mon_task_t *) &tag);
+  LpelTaskSetRecLimitAdaptive(t, SLICE_USEC);
+  LpelTaskStart(t);
+  LpelTaskStart(LpelTaskCreate(0, Consumer, NULL, 8192));
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testRecLimit();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,104 @@
+/*
+ * Time slice hints for long running tasks.
+ *
+ * Two spinners run on the same worker and never block. They yield only
+ * when LpelTaskShouldYield() tells them that the time slice is used up,
+ * so the second one gets to run only if the hint is raised. Each spinner
+ * counts the handovers, i.e. the yields after which the other one has
+ * made progress; both have to see ROUNDS of them before the deadline.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hrc_lpel.h"
+#include <lpel/timing.h>
+
+#define SLICE_USEC     2000
+#define ROUNDS         50
+#define DEADLINE_USEC  10000000.0
+
+static volatile long spins[2];
+static volatile int finished[2];
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static double ElapsedUsec(const lpel_timing_t *start)
+{
+  lpel_timing_t end, diff;
+
+  LpelTimingNow(&end);
+  LpelTimingDiff(&diff, start, &end);
+  return LpelTimingToNSec(&diff) / 1000.0;
+}
+
+
+static void *Spinner(void *arg)
+{
+  long id = (long) arg;
+  long other_before;
+  int hints = 0, handovers = 0;
+  lpel_timing_t start;
+
+  LpelTimingNow(&start);
+  /* the other one stops when it has seen enough, or gives up */
+  while (handovers < ROUNDS && !finished[1-id]) {
+    spins[id]++;
+    if (!LpelTaskShouldYield()) {
+      if ((spins[id] & 0xfff) == 0 && ElapsedUsec(&start) > DEADLINE_USEC) {
+        break;
+      }
+      continue;
+    }
+    hints++;
+    other_before = spins[1-id];
+    LpelTaskYield();
+    if (spins[1-id] != other_before) handovers++;
+  }
+  finished[id] = 1;
+
+  printf("Spinner %ld: %d hints, %d handovers\n", id, hints, handovers);
+  if (hints == 0 || handovers == 0 || (handovers < ROUNDS && !finished[1-id])) {
+    printf("Spinner %ld: the worker was not shared\n", id);
+    __sync_fetch_and_add(&failures, 1);
+  }
+  if (__sync_add_and_fetch(&done, 1) == 2) LpelStop();
+  return NULL;
+}
+
+
+static void testSlice(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and a worker */
+  cfg.num_workers = 2;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelWorkerSetTimeSlice(SLICE_USEC);
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  for (i=0; i<2; i++) {
+    LpelTaskStart(LpelTaskCreate(0, Spinner, (void *) i, 8192));
+  }
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testSlice();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * Pipeline of stackless tasks.
+ *
+ * A producer writes NUM_ITEMS items into a stream with IN_CREDIT credits,
+ * so it waits for the first stackless filter to give credits back most
+ * of the time; it also sleeps now and then, so that the filters run dry
+ * and wait for their input. Each of the NUM_FILTERS filters increments
+ * the items and passes them on with LpelStreamTryWrite to a stream with
+ * OUT_CREDIT credits, every other one with a record limit. Without
+ * credits left, the filter returns LPEL_REC_RETRY, waits for them and gets
+ * the item again. On the end marker a filter terminates. The consumer
+ * checks that every item has passed every filter, in order, and that the
+ * filters had to wait for credits.
+ *
+ * Before, the producer checks that LpelStreamTryWrite fails on a stream
+ * without credits left, and that a blocking write goes through once the
+ * consumer has read.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hrc_lpel.h"
+
+#define NUM_FILTERS  8
+#define NUM_ITEMS    100000L
+#define IN_CREDIT    16
+#define OUT_CREDIT   4
+#define REC_LIMIT    50
+
+#define END  ((void *) -1L)
+
+typedef struct {
+  int id;
+  long cnt;
+  long retries;
+  lpel_stream_desc_t *out;
+} filter_t;
+
+static lpel_stream_t *pipe_s[NUM_FILTERS + 1];
+static lpel_stream_t *credit_s;
+static volatile int tried = 0;
+static filter_t filters[NUM_FILTERS];
+static volatile int failures = 0;
+
+
+static int Filter(void *item, void *arg)
+{
+  filter_t *f = (filter_t *) arg;
+  void *next = item;
+
+  /* the output is opened within the task as well */
+  if (f->out == NULL) f->out = LpelStreamOpen(pipe_s[f->id+1], 'w');
+
+  if (item != END) next = (void *) ((long) item + 1);
+  if (LpelStreamTryWrite(f->out, next) != 0) {
+    /* the output is full, the same item comes again */
+    f->retries++;
+    return LPEL_REC_RETRY;
+  }
+  if (item == END) {
+    LpelStreamClose(f->out, 0);
+    return 1;
+  }
+  f->cnt++;
+  return 0;
+}
+
+
+static void *Producer(void *arg)
+{
+  lpel_stream_desc_t *out;
+  long i;
+
+  /* two credits: the third write must fail, until the consumer reads */
+  out = LpelStreamOpen(credit_s, 'w');
+  if (LpelStreamTryWrite(out, (void *) 1L) != 0
+      || LpelStreamTryWrite(out, (void *) 2L) != 0) {
+    printf("TryWrite failed with credits left\n");
+    __sync_fetch_and_add(&failures, 1);
+  }
+  if (LpelStreamTryWrite(out, (void *) 3L) == 0) {
+    printf("TryWrite succeeded without credits\n");
+    __sync_fetch_and_add(&failures, 1);
+    tried = 1;
+  } else {
+    tried = 1;
+    LpelStreamWrite(out, (void *) 3L);
+  }
+  LpelStreamClose(out, 0);
+
+  out = LpelStreamOpen(pipe_s[0], 'w');
+  for (i=1; i<=NUM_ITEMS; i++) {
+    LpelStreamWrite(out, (void *) i);
+    if (i % 5000 == 0) LpelTaskSleep(1000);
+  }
+  LpelStreamWrite(out, END);
+  LpelStreamClose(out, 0);
+  return NULL;
+}
+
+
+static void *Consumer(void *arg)
+{
+  lpel_stream_desc_t *in;
+  long expected, retries = 0;
+  void *item;
+  int i;
+
+  /* not before the producer has run out of credits */
+  while (!tried) LpelTaskYield();
+  in = LpelStreamOpen(credit_s, 'r');
+  for (i=1; i<=3; i++) {
+    if ((long) LpelStreamRead(in) != i) {
+      printf("Lost an item on the stream with credits\n");
+      failures++;
+    }
+  }
+  LpelStreamClose(in, 1);
+
+  in = LpelStreamOpen(pipe_s[NUM_FILTERS], 'r');
+  expected = 1 + NUM_FILTERS;
+  while ((item = LpelStreamRead(in)) != END) {
+    if ((long) item != expected) {
+      printf("Got item %ld, expected %ld\n", (long) item, expected);
+      failures++;
+    }
+    expected = (long) item + 1;
+  }
+  LpelStreamClose(in, 1);
+
+  for (i=0; i<NUM_FILTERS; i++) {
+    if (filters[i].cnt != NUM_ITEMS) {
+      printf("Filter %d passed %ld items\n", i, filters[i].cnt);
+      failures++;
+    }
+    retries += filters[i].retries;
+  }
+  if (retries == 0) {
+    printf("The outputs of the filters were never full\n");
+    failures++;
+  }
+  printf("Passed %ld items through %d filters, %ld retries\n",
+      expected - 1 - NUM_FILTERS, NUM_FILTERS, retries);
+  LpelStop();
+  return NULL;
+}
+
+
+static void testStackless(void)
+{
+  lpel_config_t cfg;
+  lpel_task_t *t;
+  int i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and two workers */
+  cfg.num_workers = 3;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  credit_s = LpelStreamCreate(0);
+  LpelStreamSetCredit(credit_s, 2);
+  for (i=0; i<=NUM_FILTERS; i++) {
+    pipe_s[i] = LpelStreamCreate(0);
+  }
+  LpelStreamSetCredit(pipe_s[0], IN_CREDIT);
+  for (i=1; i<=NUM_FILTERS; i++) {
+    LpelStreamSetCredit(pipe_s[i], OUT_CREDIT);
+  }
+  for (i=0; i<NUM_FILTERS; i++) {
+    filters[i].id = i;
+    t = LpelTaskCreateStackless(LPEL_MAP_MASTER, Filter, &filters[i],
+        pipe_s[i]);
+    if (i % 2 == 0) LpelTaskSetRecLimit(t, REC_LIMIT);
+    LpelTaskStart(t);
+  }
+  LpelTaskStart(LpelTaskCreate(0, Consumer, NULL, 8192));
+  LpelTaskStart(LpelTaskCreate(0, Producer, NULL, 8192));
+
+  LpelCleanup();
+}
+
+
+int main(void)
+{
+  testStackless();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
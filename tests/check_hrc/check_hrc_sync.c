@@ -0,0 +1,151 @@
+/*
+ * Task-level mutex and condition variable.
+ *
+ * Mutex: NUM_LOCKERS tasks, on the workers and on a wrapper, increment
+ * a counter in a critical section and yield inside it, so that the mutex
+ * is handed over to blocked tasks most of the time. Each task checks
+ * that nobody else entered while it held the mutex.
+ *
+ * Condition variable: NUM_WAITERS tasks wait for a broadcast, ROUNDS
+ * times; the broadcaster waits on a second condition until all of them
+ * are waiting. Every waiter has to be woken in every round.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hrc_lpel.h"
+
+#define NUM_LOCKERS  8
+#define NUM_ENTRIES  2000
+#define NUM_WAITERS  8
+#define ROUNDS       500
+
+#define NUM_TASKS    (NUM_LOCKERS + NUM_WAITERS + 1)
+
+static lpel_mutex_t mx;
+static long counter = 0;
+static int owner = -1;
+
+static lpel_mutex_t cmx;
+static lpel_cond_t go, all_waiting;
+static int waiting = 0;
+static int generation = 0;
+static int woken = 0;
+
+static volatile int done = 0;
+static volatile int failures = 0;
+
+
+static void TaskDone(void)
+{
+  if (__sync_add_and_fetch(&done, 1) == NUM_TASKS) LpelStop();
+}
+
+
+static void *Locker(void *arg)
+{
+  int id = (int)(long) arg;
+  int i;
+
+  for (i=0; i<NUM_ENTRIES; i++) {
+    if (i % 10 != 0 || !LpelMutexTryEnter(&mx)) LpelMutexEnter(&mx);
+    if (owner != -1) __sync_fetch_and_add(&failures, 1);
+    owner = id;
+    counter++;
+    LpelTaskYield();
+    if (owner != id) __sync_fetch_and_add(&failures, 1);
+    owner = -1;
+    LpelMutexLeave(&mx);
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Waiter(void *arg)
+{
+  int r, gen;
+
+  for (r=0; r<ROUNDS; r++) {
+    LpelMutexEnter(&cmx);
+    if (++waiting == NUM_WAITERS) LpelCondSignal(&all_waiting);
+    gen = generation;
+    while (generation == gen) LpelCondWait(&go, &cmx);
+    woken++;
+    LpelMutexLeave(&cmx);
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void *Broadcaster(void *arg)
+{
+  int r;
+
+  for (r=0; r<ROUNDS; r++) {
+    LpelMutexEnter(&cmx);
+    while (waiting < NUM_WAITERS) LpelCondWait(&all_waiting, &cmx);
+    waiting = 0;
+    generation++;
+    LpelCondBroadcast(&go);
+    LpelMutexLeave(&cmx);
+  }
+  TaskDone();
+  return NULL;
+}
+
+
+static void testSync(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and two workers */
+  cfg.num_workers = 3;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  LpelMutexInit(&mx);
+  LpelMutexInit(&cmx);
+  LpelCondInit(&go);
+  LpelCondInit(&all_waiting);
+
+  for (i=0; i<NUM_LOCKERS; i++) {
+    LpelTaskStart(LpelTaskCreate(i == 0 ? LPEL_MAP_OTHERS : 0,
+          Locker, (void *) i, 8192));
+  }
+  for (i=0; i<NUM_WAITERS; i++) {
+    LpelTaskStart(LpelTaskCreate(0, Waiter, NULL, 8192));
+  }
+  LpelTaskStart(LpelTaskCreate(0, Broadcaster, NULL, 8192));
+
+  LpelCleanup();
+
+  LpelCondDestroy(&all_waiting);
+  LpelCondDestroy(&go);
+  LpelMutexDestroy(&cmx);
+  LpelMutexDestroy(&mx);
+
+  printf("Counter %ld, %d wakeups\n", counter, woken);
+  if (counter != NUM_LOCKERS * NUM_ENTRIES) failures++;
+  if (woken != NUM_WAITERS * ROUNDS) failures++;
+}
+
+
+int main(void)
+{
+  testSync();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Value streams.
+ *
+ * A record is passed ROUNDS times around a ring of NUM_NODES tasks over
+ * value streams of different sizes, one of the nodes on a wrapper. The
+ * writer modifies its copy right after writing, which must not change
+ * the value in the stream. The odd nodes poll their input and peek at
+ * the next value before reading it; the peeked and the read value have
+ * to agree, and the record has to arrive intact with the expected hop
+ * count.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "hrc_lpel.h"
+
+#define NUM_NODES  20
+#define ROUNDS     20000
+
+typedef struct {
+  long hop;
+  double payload[5];
+  long check;
+} record_t;
+
+static lpel_stream_t *ring[NUM_NODES];
+static volatile int failures = 0;
+
+
+static long Checksum(const record_t *r)
+{
+  long sum = r->hop;
+  int i;
+
+  for (i=0; i<5; i++) sum = sum * 31 + (long) r->payload[i];
+  return sum;
+}
+
+
+static void Fail(const char *msg, long id, long hop)
+{
+  printf("Node %ld: %s at hop %ld\n", id, msg, hop);
+  __sync_fetch_and_add(&failures, 1);
+}
+
+
+static void Send(lpel_stream_desc_t *out, record_t *r)
+{
+  r->check = Checksum(r);
+  LpelStreamWriteValue(out, r);
+  /* the stream keeps its own copy */
+  memset(r, 0xff, sizeof(record_t));
+}
+
+
+static void *Node(void *arg)
+{
+  long id = (long) arg;
+  lpel_stream_desc_t *in, *out;
+  lpel_streamset_t set = NULL;
+  record_t r, *peeked;
+  long k, expected, peek_hop;
+  int i;
+
+  in = LpelStreamOpen(ring[id], 'r');
+  out = LpelStreamOpen(ring[(id+1) % NUM_NODES], 'w');
+  LpelStreamsetPut(&set, in);
+
+  if (id == 0) {
+    r.hop = 0;
+    for (i=0; i<5; i++) r.payload[i] = i + 0.5;
+    Send(out, &r);
+  }
+  for (k=0; k<ROUNDS; k++) {
+    expected = k * NUM_NODES + (id + NUM_NODES - 1) % NUM_NODES;
+    peek_hop = expected;
+    if (id % 2 == 1) {
+      /* the value stays in place until it is read */
+      LpelStreamPoll(&set);
+      peeked = (record_t *) LpelStreamPeek(in);
+      if (peeked == NULL) {
+        Fail("peeked at nothing after a poll", id, k);
+      } else {
+        peek_hop = peeked->hop;
+      }
+    }
+    LpelStreamReadValue(in, &r);
+    if (r.hop != expected || r.check != Checksum(&r)) {
+      Fail("got a wrong value", id, k);
+    }
+    if (r.hop != peek_hop) Fail("read a value other than peeked", id, k);
+    if (id == 0 && k == ROUNDS-1) break;
+    r.hop++;
+    Send(out, &r);
+  }
+  LpelStreamClose(in, 0);
+  LpelStreamClose(out, 0);
+
+  if (id == 0) {
+    printf("Record passed %d rounds\n", ROUNDS);
+    LpelStop();
+  }
+  return NULL;
+}
+
+
+static void testValue(void)
+{
+  lpel_config_t cfg;
+  long i;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  /* the master and two workers */
+  cfg.num_workers = 3;
+  cfg.proc_workers = 1;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = HRC_LPEL;
+
+  LpelInit(&cfg);
+  LpelStart(&cfg);
+
+  /* the default size, and single and double buffering */
+  for (i=0; i<NUM_NODES; i++) {
+    ring[i] = LpelStreamCreateValue((int) (i % 3), sizeof(record_t));
+  }
+  for (i=0; i<NUM_NODES; i++) {
+    LpelTaskStart(LpelTaskCreate(i == 5 ? LPEL_MAP_OTHERS : 0,
+          Node, (void *) i, 8192));
+  }
+
+  LpelCleanup();
+
+  for (i=0; i<NUM_NODES; i++) {
+    LpelStreamDestroy(ring[i]);
+  }
+}
+
+
+int main(void)
+{
+  testValue();
+  if (failures > 0) {
+    printf("test failed\n");
+    return EXIT_FAILURE;
+  }
+  printf("test finished\n");
+  return 0;
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+# sweep of lpelbench over topologies, sizes and message sizes,
+# with pointer, value and in-place streams, on both schedulers; one CSV file
+
+WORKERS=`grep ^processor /proc/cpuinfo | wc -l`
+ROUNDS=100000
+
+F_OUT=results_all.csv
+
+./lpelbench -t ring -n 2 -r 1 -w 1 | head -1 > $F_OUT.tmp
+for b in ./lpelbench ./lpelbench_hrc
+do
+  for t in ring pipe fanout merge
+  do
+    for n in `./space.py log 1 3 7`
+    do
+      for m in 0 1024
+      do
+        for v in "" -V -Z
+        do
+          # in-place streams and merge are DECEN only, merge is by pointer
+          [ $b = ./lpelbench_hrc -a "$v" = -Z ] && continue
+          [ $t = merge ] && [ $b = ./lpelbench_hrc -o -n "$v" ] && continue
+          $b -H -t $t -n $n -r $ROUNDS -m $m -w $WORKERS $v >> $F_OUT.tmp
+        done
+      done
+    done
+  done
+done
+mv $F_OUT.tmp $F_OUT
@@ -0,0 +1,18 @@
+#!/bin/bash
+# spmd entry/exit latency (ns) vs. number of workers
+
+NUM_CPUS=`grep ^processor /proc/cpuinfo | wc -l`
+
+F_LPEL=results_spmd_lpel
+
+make spmdtest "CFLAGS=-O2 -DBENCHMARK" >/dev/null
+
+rm -f $F_LPEL.tmp
+w=1
+while [ $w -le $NUM_CPUS ]
+do
+  ./spmdtest $w >> $F_LPEL.tmp
+  w=`expr $w \* 2`
+done
+
+mv $F_LPEL.tmp $F_LPEL
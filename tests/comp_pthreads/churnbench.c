@@ -0,0 +1,289 @@
+/*
+ * Task churn benchmark
+ *
+ * One binary per scheduler: churnbench is linked with liblpel (DECEN),
+ * churnbench_hrc with liblpel_hrc (HRC).
+ *
+ * A spawner task per worker creates and starts its share of short-lived
+ * tasks in batches of fanout tasks and waits for a batch to finish before
+ * it creates the next one. With streams > 0, every child gets that many
+ * streams of its own and writes one item to each, which the spawner
+ * reads. Then the children count themselves done and exit. Every
+ * wrapper-th child runs on a wrapper instead of a worker.
+ *
+ * A sampling thread polls the queue depths of the workers (and of the
+ * master with HRC) every millisecond.
+ *
+ * Reported, as CSV with a header line or as a JSON object: the rate of
+ * LpelTaskCreate/LpelTaskStart, the rate of complete task lifecycles
+ * (until the task is destroyed by the runtime), peak RSS, the largest
+ * sampled ready queue and the peak mailbox depth.
+ *
+ * usage: churnbench [-n tasks] [-f fanout] [-s streams] [-W wrapper]
+ *                   [-w workers] [-S stacksize] [-j] [-H]
+ *   -j  JSON output, -H  omit the CSV header line
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#ifdef HRC
+#include <hrc_lpel.h>
+#define BACKEND  "hrc"
+#else
+#include <lpel.h>
+#define BACKEND  "decen"
+#endif
+
+
+static long num_tasks = 1000000;
+static int fanout = 64;
+static int num_streams = 0;
+static int wrapper = 0;
+static int num_workers = 2;
+static int stacksize = 8192;
+static int json = 0;
+static int header = 1;
+
+/* tasks created by the spawners; ns spent in LpelTaskCreate/Start */
+static volatile long created = 0;
+static volatile unsigned long long create_ns = 0;
+static volatile int spawners_left;
+
+static unsigned long long t_begin, t_end;
+
+/* maxima of the sampled queue depths */
+static volatile int sampling = 1;
+static int max_ready = 0, max_mbox = 0, master_ready = 0, master_mbox = 0;
+
+
+typedef struct {
+  volatile int *pending;      /* children of the batch not done */
+  lpel_stream_t **streams;
+} child_arg_t;
+
+
+static unsigned long long NowNs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+
+static void *Child(void *arg)
+{
+  child_arg_t *ca = (child_arg_t *) arg;
+  lpel_stream_desc_t *out;
+  int i;
+
+  for (i = 0; i < num_streams; i++) {
+    out = LpelStreamOpen(ca->streams[i], 'w');
+    LpelStreamWrite(out, ca);
+    LpelStreamClose(out, 0);
+  }
+  __sync_fetch_and_sub(ca->pending, 1);
+  return NULL;
+}
+
+
+static void *Spawner(void *arg)
+{
+  int id = (int)(long) arg;
+  long share = num_tasks / num_workers + (id < num_tasks % num_workers);
+  child_arg_t *args = malloc(fanout * sizeof(child_arg_t));
+  lpel_stream_t **streams = malloc(fanout * (num_streams + 1)
+      * sizeof(lpel_stream_t *));
+  lpel_stream_desc_t *in;
+  lpel_task_t *t;
+  volatile int pending;
+  unsigned long long start, spent = 0;
+  long n, seq = (long) id * share;
+  int batch, i, j, wid;
+
+  for (n = 0; n < share; n += batch) {
+    batch = (share - n < fanout) ? (int) (share - n) : fanout;
+    pending = batch;
+
+    for (i = 0; i < batch; i++) {
+      args[i].pending = &pending;
+      args[i].streams = &streams[i * num_streams];
+      for (j = 0; j < num_streams; j++) {
+        args[i].streams[j] = LpelStreamCreate(0);
+      }
+    }
+
+    start = NowNs();
+    for (i = 0; i < batch; i++, seq++) {
+      if (wrapper > 0 && seq % wrapper == wrapper - 1) {
+        wid = LPEL_MAP_OTHERS;
+      } else {
+#ifdef HRC
+        wid = 0;
+#else
+        wid = (int) (seq % num_workers);
+#endif
+      }
+      t = LpelTaskCreate(wid, Child, &args[i], stacksize);
+      LpelTaskStart(t);
+    }
+    spent += NowNs() - start;
+
+    /* join the batch */
+    for (i = 0; i < batch; i++) {
+      for (j = 0; j < num_streams; j++) {
+        in = LpelStreamOpen(args[i].streams[j], 'r');
+        (void) LpelStreamRead(in);
+        LpelStreamClose(in, 1);
+      }
+    }
+    while (pending > 0) LpelTaskYield();
+  }
+
+  __sync_fetch_and_add(&created, share);
+  __sync_fetch_and_add(&create_ns, spent);
+  free(streams);
+  free(args);
+
+  /* tasks are still created on workers which may have run out of tasks,
+   * so the runtime is stopped only when the last spawner is done */
+  if (__sync_sub_and_fetch(&spawners_left, 1) == 0) {
+    t_end = NowNs();
+    LpelStop();
+  }
+  return NULL;
+}
+
+
+static void *Sampler(void *arg)
+{
+  struct timespec ms = { 0, 1000000 };
+  int wid, ready, mbox, peak;
+
+  (void) arg;
+  while (sampling) {
+#ifdef HRC
+    if (LpelWorkerQueueDepth(-1, &ready, &mbox, &peak) == 0) {
+      if (ready > master_ready) master_ready = ready;
+      if (peak > master_mbox) master_mbox = peak;
+    }
+#endif
+    for (wid = 0; wid < num_workers; wid++) {
+      if (LpelWorkerQueueDepth(wid, &ready, &mbox, &peak) != 0) continue;
+      if (ready > max_ready) max_ready = ready;
+      if (peak > max_mbox) max_mbox = peak;
+    }
+    nanosleep(&ms, NULL);
+  }
+  return NULL;
+}
+
+
+static void Report(void)
+{
+  struct rusage ru;
+  double elapsed = (t_end - t_begin) * 1e-9;
+  double create_rate = created / (create_ns * 1e-9);
+  double life_rate = created / elapsed;
+
+  getrusage(RUSAGE_SELF, &ru);
+
+  if (json) {
+    printf("{\"backend\":\"%s\",\"tasks\":%ld,\"fanout\":%d,"
+        "\"streams\":%d,\"wrapper\":%d,\"workers\":%d,\"stacksize\":%d,"
+        "\"elapsed_s\":%.6f,\"create_per_s\":%.1f,\"lifecycle_per_s\":%.1f,"
+        "\"maxrss_kb\":%ld,\"max_ready\":%d,\"max_mailbox\":%d,"
+        "\"master_ready\":%d,\"master_mailbox\":%d}\n",
+        BACKEND, (long) created, fanout, num_streams, wrapper, num_workers,
+        stacksize, elapsed, create_rate, life_rate, ru.ru_maxrss,
+        max_ready, max_mbox, master_ready, master_mbox);
+    return;
+  }
+  if (header) {
+    printf("backend,tasks,fanout,streams,wrapper,workers,stacksize,"
+        "elapsed_s,create_per_s,lifecycle_per_s,maxrss_kb,max_ready,"
+        "max_mailbox,master_ready,master_mailbox\n");
+  }
+  printf("%s,%ld,%d,%d,%d,%d,%d,%.6f,%.1f,%.1f,%ld,%d,%d,%d,%d\n",
+      BACKEND, (long) created, fanout, num_streams, wrapper, num_workers,
+      stacksize, elapsed, create_rate, life_rate, ru.ru_maxrss,
+      max_ready, max_mbox, master_ready, master_mbox);
+}
+
+
+static void Usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-n tasks] [-f fanout] [-s streams]"
+      " [-W wrapper] [-w workers] [-S stacksize] [-j] [-H]\n", prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  lpel_config_t cfg;
+  pthread_t sampler;
+  long nproc;
+  int opt, i;
+
+  while ((opt = getopt(argc, argv, "n:f:s:W:w:S:jH")) != -1) {
+    switch (opt) {
+    case 'n': num_tasks = atol(optarg); break;
+    case 'f': fanout = atoi(optarg); break;
+    case 's': num_streams = atoi(optarg); break;
+    case 'W': wrapper = atoi(optarg); break;
+    case 'w': num_workers = atoi(optarg); break;
+    case 'S': stacksize = atoi(optarg); break;
+    case 'j': json = 1; break;
+    case 'H': header = 0; break;
+    default: Usage(argv[0]);
+    }
+  }
+  if (num_tasks < 1 || fanout < 1 || num_streams < 0 || wrapper < 0
+      || num_workers < 1 || stacksize < 4096) {
+    Usage(argv[0]);
+  }
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+#ifdef HRC
+  /* the master is a worker of its own */
+  cfg.num_workers = num_workers + 1;
+  cfg.type = HRC_LPEL;
+#else
+  cfg.num_workers = num_workers;
+#endif
+  nproc = sysconf(_SC_NPROCESSORS_ONLN);
+  cfg.proc_workers = (nproc > 0 && nproc < cfg.num_workers) ?
+    (int) nproc : cfg.num_workers;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+
+  LpelInit(&cfg);
+  if (LpelStart(&cfg) != 0) {
+    fprintf(stderr, "LpelStart failed\n");
+    return EXIT_FAILURE;
+  }
+  (void) pthread_create(&sampler, NULL, Sampler, NULL);
+
+  spawners_left = num_workers;
+  t_begin = NowNs();
+  for (i = 0; i < num_workers; i++) {
+#ifdef HRC
+    LpelTaskStart(LpelTaskCreate(0, Spawner, (void *)(long) i, 16*1024));
+#else
+    LpelTaskStart(LpelTaskCreate(i, Spawner, (void *)(long) i, 16*1024));
+#endif
+  }
+  /* wait for the runtime to finish before its queues go away */
+  while (spawners_left > 0) usleep(1000);
+  sampling = 0;
+  (void) pthread_join(sampler, NULL);
+  LpelCleanup();
+
+  Report();
+  return EXIT_SUCCESS;
+}
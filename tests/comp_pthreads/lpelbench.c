@@ -0,0 +1,605 @@
+/*
+ * Parameterised benchmark of stream topologies
+ *
+ * One binary per scheduler: lpelbench is linked with liblpel (DECEN),
+ * lpelbench_hrc with liblpel_hrc (HRC). Topologies:
+ *
+ *   ring    size tasks in a ring pass one message around, rounds times;
+ *           the latency is the time of one round
+ *   pipe    source -> size relays -> sink, rounds messages;
+ *           the latency is the time from source to sink
+ *   fanout  source -> size branches (round robin) -> sink, rounds messages;
+ *           the sink polls the branches, latency as for pipe
+ *   merge   as fanout, but the branches write to a single multi-producer
+ *           stream, which the sink reads (DECEN only, pointer streams)
+ *
+ * Every task reads the payload of the messages it passes on. With -V the
+ * messages are copied through value streams instead of being passed as
+ * pointers, so no message is allocated per send. With -Z (DECEN only)
+ * they are built and read in place in the values of the streams, and
+ * copied only from the input to the output of a relay. One line of
+ * results is written as CSV (with a header line) or as a JSON object:
+ * throughput, latency percentiles, the CPU time of the process per worker
+ * and interval (cpu_util), and, if the library reports worker waits to the
+ * monitoring callbacks (USE_LOGGING), the utilisation of every worker,
+ * i.e. the share of the measured interval it was not waiting for work.
+ *
+ * usage: lpelbench [-t ring|pipe|fanout|merge] [-n size] [-r rounds]
+ *                  [-m msgsize] [-w workers] [-f csv|json] [-V|-Z] [-H]
+ *   -V  value streams, -Z  in place, -H  omit the CSV header line
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HRC
+#include <hrc_lpel.h>
+#define BACKEND  "hrc"
+#else
+#include <lpel.h>
+#define BACKEND  "decen"
+#endif
+
+
+#define STACK_SIZE (16*1024) /* 16k */
+
+typedef enum { TOPO_RING, TOPO_PIPE, TOPO_FANOUT, TOPO_MERGE } topo_t;
+
+static const char *topo_names[] = { "ring", "pipe", "fanout", "merge" };
+
+#ifdef HRC
+#define NUM_TOPOS  3
+#else
+#define NUM_TOPOS  4
+#endif
+
+static topo_t topo = TOPO_PIPE;
+static int size = 16;
+static long rounds = 100000;
+static size_t msgsize = 0;
+static int num_workers = 2;
+static int by_value = 0;
+static int in_place = 0;
+static int json = 0;
+static int header = 1;
+
+
+typedef struct {
+  long seq;
+  unsigned long long stamp;   /* ns, when sent */
+  int term;
+  size_t size;
+  unsigned char payload[];
+} msg_t;
+
+/* latency samples in ns, one per round or message */
+static unsigned long long *lat;
+static long lat_cnt = 0;
+
+/* measured interval, and the CPU time of the process at its ends */
+static volatile unsigned long long t_begin = 0, t_end = 0;
+static unsigned long long cpu_begin = 0, cpu_end = 0;
+
+static lpel_stream_t **streams;
+static volatile unsigned long touched;
+
+
+static unsigned long long ClockNs(clockid_t clk)
+{
+  struct timespec ts;
+  clock_gettime(clk, &ts);
+  return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+#define NowNs()  ClockNs(CLOCK_MONOTONIC)
+
+static void Begin(void)
+{
+  cpu_begin = ClockNs(CLOCK_PROCESS_CPUTIME_ID);
+  t_begin = NowNs();
+}
+
+/* with HRC, the last task stops the runtime, as the master does not
+ * wait for blocked tasks */
+static void End(void)
+{
+  t_end = NowNs();
+  cpu_end = ClockNs(CLOCK_PROCESS_CPUTIME_ID);
+#ifdef HRC
+  LpelStop();
+#endif
+}
+
+
+/* with value streams, a task builds its messages in a buffer of its own
+ * and receives into it; otherwise every message is allocated */
+static msg_t *MsgBuffer(void)
+{
+  return by_value ? malloc(sizeof(msg_t) + msgsize) : NULL;
+}
+
+static msg_t *MsgAlloc(lpel_stream_desc_t *out, msg_t *buf)
+{
+#ifndef HRC
+  int one = 1;
+  if (in_place) return LpelStreamReserve(out, &one);
+#else
+  (void) out;
+#endif
+  return by_value ? buf : malloc(sizeof(msg_t) + msgsize);
+}
+
+/* to be sent to out */
+static msg_t *MsgCreate(long seq, lpel_stream_desc_t *out, msg_t *buf)
+{
+  msg_t *msg = MsgAlloc(out, buf);
+  msg->seq = seq;
+  msg->term = 0;
+  msg->size = msgsize;
+  memset(msg->payload, (int) seq, msgsize);
+  msg->stamp = NowNs();
+  return msg;
+}
+
+/* msg was received from in */
+static void MsgFree(lpel_stream_desc_t *in, msg_t *msg)
+{
+#ifndef HRC
+  if (in_place) {
+    LpelStreamRelease(in, 1);
+    return;
+  }
+#else
+  (void) in;
+#endif
+  if (!by_value) free(msg);
+}
+
+/* msg was created for out */
+static void Send(lpel_stream_desc_t *out, msg_t *msg)
+{
+#ifndef HRC
+  if (in_place) {
+    LpelStreamCommit(out, 1);
+    return;
+  }
+#endif
+  if (by_value) {
+    LpelStreamWriteValue(out, msg);
+  } else {
+    LpelStreamWrite(out, msg);
+  }
+}
+
+static msg_t *Recv(lpel_stream_desc_t *in, msg_t *buf)
+{
+#ifndef HRC
+  int one = 1;
+  if (in_place) return LpelStreamAcquire(in, &one);
+#endif
+  if (by_value) {
+    LpelStreamReadValue(in, buf);
+    return buf;
+  }
+  return LpelStreamRead(in);
+}
+
+/* pass on msg, received from in, to out */
+static void Forward(lpel_stream_desc_t *in, lpel_stream_desc_t *out,
+    msg_t *msg)
+{
+#ifndef HRC
+  if (in_place) {
+    memcpy(MsgAlloc(out, NULL), msg, sizeof(msg_t) + msgsize);
+    LpelStreamCommit(out, 1);
+    LpelStreamRelease(in, 1);
+    return;
+  }
+#else
+  (void) in;
+#endif
+  Send(out, msg);
+}
+
+/* read the payload, as a task working on the message would */
+static void MsgTouch(msg_t *msg)
+{
+  unsigned long sum = 0;
+  size_t i;
+
+  for (i = 0; i < msg->size; i += 64) sum += msg->payload[i];
+  touched += sum;
+}
+
+static int Place(int id)
+{
+#ifdef HRC
+  (void) id;
+  return 0;
+#else
+  return id % num_workers;
+#endif
+}
+
+
+/******************************************************************************/
+/*  WORKER UTILISATION                                                        */
+/******************************************************************************/
+
+struct mon_worker_t {
+  int wid;
+  unsigned long long since;   /* start of the current wait, 0 if running */
+  unsigned long long wait;    /* ns waited within the measured interval */
+};
+
+static mon_worker_t **mon_workers;
+
+/* add the part of [from,to] within the measured interval */
+static void AddWait(mon_worker_t *mw, unsigned long long from,
+    unsigned long long to)
+{
+  unsigned long long b = t_begin, e = t_end;
+
+  if (b == 0) return;
+  if (from < b) from = b;
+  if (e != 0 && to > e) to = e;
+  if (to > from) mw->wait += to - from;
+}
+
+static mon_worker_t *MonWorkerCreate(int wid)
+{
+  mon_worker_t *mw = calloc(1, sizeof(mon_worker_t));
+  mw->wid = wid;
+  if (wid >= 0 && wid < num_workers) mon_workers[wid] = mw;
+  return mw;
+}
+
+static void MonWorkerWaitStart(mon_worker_t *mw)
+{
+  mw->since = NowNs();
+}
+
+static void MonWorkerWaitStop(mon_worker_t *mw)
+{
+  if (mw->since != 0) AddWait(mw, mw->since, NowNs());
+  mw->since = 0;
+}
+
+static void MonWorkerDestroy(mon_worker_t *mw)
+{
+  /* freed after reporting */
+  MonWorkerWaitStop(mw);
+}
+
+
+/******************************************************************************/
+/*  TOPOLOGIES                                                                */
+/******************************************************************************/
+
+static void *RingProcess(void *arg)
+{
+  int id = (int)(long) arg;
+  lpel_stream_desc_t *in, *out;
+  msg_t *msg, *buf = MsgBuffer();
+  int term = 0;
+  long round = 0;
+  unsigned long long now;
+
+  out = LpelStreamOpen(streams[id], 'w');
+  in = LpelStreamOpen(streams[(id + size - 1) % size], 'r');
+
+  if (id == 0) {
+    Begin();
+    Send(out, MsgCreate(0, out, buf));
+  }
+
+  while (!term) {
+    msg = Recv(in, buf);
+    MsgTouch(msg);
+    if (id == 0) {
+      now = NowNs();
+      lat[lat_cnt++] = now - msg->stamp;
+      msg->stamp = now;
+      if (++round == rounds) msg->term = 1;
+    }
+    if (msg->term) term = 1;
+    Forward(in, out, msg);
+  }
+
+  /* the terminating message comes round a last time */
+  if (id == 0) {
+    msg = Recv(in, buf);
+    End();
+    MsgFree(in, msg);
+  }
+  free(buf);
+
+  LpelStreamClose(in, 1);
+  LpelStreamClose(out, 0);
+  return NULL;
+}
+
+
+static void *Source(void *arg)
+{
+  lpel_stream_desc_t **outs;
+  msg_t *msg, *buf = MsgBuffer();
+  int n = (int)(long) arg, i;
+  long seq;
+
+  outs = malloc(n * sizeof(lpel_stream_desc_t *));
+  for (i = 0; i < n; i++) outs[i] = LpelStreamOpen(streams[i], 'w');
+
+  Begin();
+  for (seq = 0; seq < rounds; seq++) {
+    Send(outs[seq % n], MsgCreate(seq, outs[seq % n], buf));
+  }
+  for (i = 0; i < n; i++) {
+    msg = MsgCreate(-1, outs[i], buf);
+    msg->term = 1;
+    Send(outs[i], msg);
+    LpelStreamClose(outs[i], 0);
+  }
+  free(outs);
+  free(buf);
+  return NULL;
+}
+
+static void *Relay(void *arg)
+{
+  int id = (int)(long) arg;
+  lpel_stream_desc_t *in, *out;
+  msg_t *msg, *buf = MsgBuffer();
+  int term = 0;
+
+  /* pipe: relay i reads stream i, writes stream i+1;
+   * fanout: branch i reads stream i, writes stream size+i;
+   * merge: all branches write stream size */
+  in = LpelStreamOpen(streams[id], 'r');
+  out = LpelStreamOpen(streams[(topo == TOPO_PIPE) ? id + 1 :
+      (topo == TOPO_MERGE) ? size : size + id], 'w');
+
+  while (!term) {
+    msg = Recv(in, buf);
+    MsgTouch(msg);
+    term = msg->term;
+    Forward(in, out, msg);
+  }
+
+  LpelStreamClose(in, 1);
+  LpelStreamClose(out, 0);
+  free(buf);
+  return NULL;
+}
+
+/* receives from the streams [first, first+n), until every branch
+ * has sent its terminating message */
+static void *Sink(void *arg)
+{
+  int first = (int)(long) arg;
+  int n = (topo == TOPO_FANOUT) ? size : 1;
+  int ends = (topo == TOPO_PIPE) ? 1 : size;
+  lpel_stream_desc_t **ins, *sd;
+  lpel_streamset_t set = NULL;
+  msg_t *msg, *buf = MsgBuffer();
+  int i, terms = 0;
+
+  ins = malloc(n * sizeof(lpel_stream_desc_t *));
+  for (i = 0; i < n; i++) {
+    ins[i] = LpelStreamOpen(streams[first + i], 'r');
+    LpelStreamsetPut(&set, ins[i]);
+  }
+
+  while (terms < ends) {
+    sd = (n == 1) ? ins[0] : LpelStreamPoll(&set);
+    msg = Recv(sd, buf);
+    MsgTouch(msg);
+    if (msg->term) {
+      terms++;
+    } else {
+      lat[lat_cnt++] = NowNs() - msg->stamp;
+    }
+    MsgFree(sd, msg);
+  }
+  End();
+
+  for (i = 0; i < n; i++) LpelStreamClose(ins[i], 1);
+  free(ins);
+  free(buf);
+  return NULL;
+}
+
+
+static void Start(void *(*func)(void *), long arg, int id)
+{
+  LpelTaskStart(LpelTaskCreate(Place(id), func, (void *) arg, STACK_SIZE));
+}
+
+static void CreateTopology(void)
+{
+  int i, n;
+
+  /* ring: size streams; pipe: size+1; fanout: size out, size in;
+   * merge: size out, one in; the sink reads the streams from index
+   * size on */
+  n = (topo == TOPO_RING) ? size : (topo == TOPO_FANOUT) ? 2 * size : size + 1;
+  streams = malloc(n * sizeof(lpel_stream_t *));
+  for (i = 0; i < n; i++) {
+#ifndef HRC
+    if (topo == TOPO_MERGE && i == size) {
+      streams[i] = LpelStreamCreateMultiProducer(0);
+      continue;
+    }
+#endif
+    streams[i] = by_value ?
+      LpelStreamCreateValue(0, (int) (sizeof(msg_t) + msgsize)) :
+      LpelStreamCreate(0);
+  }
+
+  switch (topo) {
+  case TOPO_RING:
+    for (i = size - 1; i >= 0; i--) Start(RingProcess, i, i);
+    break;
+  case TOPO_PIPE:
+    Start(Sink, size, size + 1);
+    for (i = size - 1; i >= 0; i--) Start(Relay, i, i + 1);
+    Start(Source, 1, 0);
+    break;
+  case TOPO_FANOUT:
+  case TOPO_MERGE:
+    Start(Sink, size, size + 1);
+    for (i = size - 1; i >= 0; i--) Start(Relay, i, i + 1);
+    Start(Source, size, 0);
+    break;
+  }
+}
+
+
+/******************************************************************************/
+/*  REPORT                                                                    */
+/******************************************************************************/
+
+static int CompareULL(const void *a, const void *b)
+{
+  unsigned long long x = *(const unsigned long long *) a;
+  unsigned long long y = *(const unsigned long long *) b;
+  return (x > y) - (x < y);
+}
+
+static unsigned long long Percentile(double p)
+{
+  long i;
+
+  if (lat_cnt == 0) return 0;
+  i = (long) (p / 100.0 * (lat_cnt - 1) + 0.5);
+  return lat[i];
+}
+
+static void Report(void)
+{
+  double elapsed = (t_end - t_begin) * 1e-9;
+  double cpu = (cpu_end - cpu_begin) * 1e-9 / (elapsed * num_workers);
+  long msgs = (topo == TOPO_RING) ? rounds * size : rounds;
+  const char *mode = in_place ? "inplace" : by_value ? "value" : "pointer";
+  double util;
+  int i, have_util = 0;
+
+  qsort(lat, lat_cnt, sizeof(lat[0]), CompareULL);
+
+  for (i = 0; i < num_workers; i++) {
+    if (mon_workers[i] != NULL && mon_workers[i]->wait > 0) have_util = 1;
+  }
+
+  if (json) {
+    printf("{\"backend\":\"%s\",\"topology\":\"%s\",\"size\":%d,"
+        "\"rounds\":%ld,\"msgsize\":%lu,\"streams\":\"%s\",\"workers\":%d,"
+        "\"elapsed_s\":%.6f,\"msgs_per_s\":%.1f,"
+        "\"lat_p50_ns\":%llu,\"lat_p90_ns\":%llu,\"lat_p99_ns\":%llu,"
+        "\"lat_max_ns\":%llu,\"cpu_util\":%.3f,\"worker_util\":[",
+        BACKEND, topo_names[topo], size, rounds, (unsigned long) msgsize,
+        mode, num_workers, elapsed, msgs / elapsed,
+        Percentile(50), Percentile(90), Percentile(99), Percentile(100), cpu);
+  } else {
+    if (header) {
+      printf("backend,topology,size,rounds,msgsize,streams,workers,elapsed_s,"
+          "msgs_per_s,lat_p50_ns,lat_p90_ns,lat_p99_ns,lat_max_ns,"
+          "cpu_util,worker_util\n");
+    }
+    printf("%s,%s,%d,%ld,%lu,%s,%d,%.6f,%.1f,%llu,%llu,%llu,%llu,%.3f,",
+        BACKEND, topo_names[topo], size, rounds, (unsigned long) msgsize,
+        mode, num_workers, elapsed, msgs / elapsed,
+        Percentile(50), Percentile(90), Percentile(99), Percentile(100), cpu);
+  }
+
+  /* separated by ';' in CSV, empty without wait monitoring */
+  for (i = 0; have_util && i < num_workers; i++) {
+    util = (mon_workers[i] == NULL) ? 0.0
+      : 1.0 - mon_workers[i]->wait * 1e-9 / elapsed;
+    if (util < 0.0) util = 0.0;
+    printf("%s%.3f", (i == 0) ? "" : (json ? "," : ";"), util);
+  }
+  printf(json ? "]}\n" : "\n");
+}
+
+
+static void Usage(const char *prog)
+{
+  fprintf(stderr, "usage: %s [-t ring|pipe|fanout|merge] [-n size] [-r rounds]"
+      " [-m msgsize] [-w workers] [-f csv|json] [-V|-Z] [-H]\n", prog);
+  exit(EXIT_FAILURE);
+}
+
+int main(int argc, char **argv)
+{
+  lpel_config_t cfg;
+  long nproc;
+  int opt, i;
+
+  while ((opt = getopt(argc, argv, "t:n:r:m:w:f:VZH")) != -1) {
+    switch (opt) {
+    case 't':
+      for (i = 0; i < NUM_TOPOS && strcmp(optarg, topo_names[i]) != 0; i++) ;
+      if (i == NUM_TOPOS) Usage(argv[0]);
+      topo = (topo_t) i;
+      break;
+    case 'n': size = atoi(optarg); break;
+    case 'r': rounds = atol(optarg); break;
+    case 'm': msgsize = (size_t) atol(optarg); break;
+    case 'w': num_workers = atoi(optarg); break;
+    case 'f': json = (strcmp(optarg, "json") == 0); break;
+    case 'V': by_value = 1; break;
+#ifndef HRC
+    case 'Z': by_value = in_place = 1; break;
+#endif
+    case 'H': header = 0; break;
+    default: Usage(argv[0]);
+    }
+  }
+  if (size < 1 || rounds < 1 || num_workers < 1) Usage(argv[0]);
+  if (topo == TOPO_RING && size < 2) size = 2;
+  /* multi-producer streams carry pointers */
+  if (topo == TOPO_MERGE && by_value) Usage(argv[0]);
+
+  lat = malloc(rounds * sizeof(lat[0]));
+  mon_workers = calloc(num_workers, sizeof(mon_worker_t *));
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+#ifdef HRC
+  /* the master is a worker of its own */
+  cfg.num_workers = num_workers + 1;
+  cfg.type = HRC_LPEL;
+#else
+  cfg.num_workers = num_workers;
+#endif
+  nproc = sysconf(_SC_NPROCESSORS_ONLN);
+  cfg.proc_workers = (nproc > 0 && nproc < cfg.num_workers) ?
+    (int) nproc : cfg.num_workers;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.mon.worker_create = MonWorkerCreate;
+  cfg.mon.worker_destroy = MonWorkerDestroy;
+  cfg.mon.worker_waitstart = MonWorkerWaitStart;
+  cfg.mon.worker_waitstop = MonWorkerWaitStop;
+
+  LpelInit(&cfg);
+  if (LpelStart(&cfg) != 0) {
+    fprintf(stderr, "LpelStart failed\n");
+    return EXIT_FAILURE;
+  }
+  CreateTopology();
+#ifndef HRC
+  LpelStop();
+#endif
+  LpelCleanup();
+
+  Report();
+
+  for (i = 0; i < num_workers; i++) free(mon_workers[i]);
+  free(mon_workers);
+  free(streams);
+  free(lat);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,96 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <lpel.h>
+#include <lpel/timing.h>
+
+/*
+ * Measures the latency of entering and leaving an (empty) SPMD region,
+ * i.e. the cost of the start and stop barriers over all workers.
+ *
+ * usage: spmdtest [num_workers]
+ */
+
+#ifndef ROUNDS
+#define ROUNDS 10000
+#endif
+
+
+static int num_workers = 2;
+static volatile int entered;
+
+
+static void Empty(void *arg)
+{
+  (void) arg;
+  (void) __sync_fetch_and_add(&entered, 1);
+}
+
+
+void *Requester(void *arg)
+{
+  lpel_timing_t ts;
+  int i;
+  (void) arg;
+
+  /* warm up */
+  LpelTaskEnterSPMD(Empty, NULL);
+
+  entered = 0;
+  LpelTimingStart( &ts);
+  for (i=0; i<ROUNDS; i++) {
+    LpelTaskEnterSPMD(Empty, NULL);
+  }
+  LpelTimingEnd( &ts);
+
+  if (entered != ROUNDS * num_workers) {
+    printf("error: %d workers entered, expected %d\n",
+        entered, ROUNDS * num_workers);
+    exit(1);
+  }
+
+#ifndef BENCHMARK
+  printf("Time for %d spmd regions on %d workers: %.2f ms (%.2f us each)\n",
+      ROUNDS, num_workers, LpelTimingToMSec( &ts),
+      LpelTimingToMSec( &ts) * 1000.0 / ROUNDS);
+#else
+  printf("%d %.1f\n", num_workers, LpelTimingToNSec( &ts) / ROUNDS);
+#endif
+
+  LpelStop();
+  return NULL;
+}
+
+
+int main(int argc, char **argv)
+{
+  lpel_config_t cfg;
+  lpel_task_t *t;
+  int num_cores;
+
+  if (argc > 1) num_workers = atoi(argv[1]);
+  if (LpelGetNumCores( &num_cores) != 0) num_cores = num_workers;
+
+  memset(&cfg, 0, sizeof(lpel_config_t));
+  cfg.num_workers = num_workers;
+  cfg.proc_workers = (num_workers < num_cores) ? num_workers : num_cores;
+  cfg.proc_others = 0;
+  cfg.flags = 0;
+  cfg.type = DECEN_LPEL;
+
+  LpelInit(&cfg);
+  if (LpelStart(&cfg)) {
+    fprintf(stderr, "cannot start lpel with %d workers\n", num_workers);
+    return 1;
+  }
+
+  t = LpelTaskCreate( 0, Requester, NULL, 0);
+  LpelTaskStart( t);
+
+  LpelCleanup();
+#ifndef BENCHMARK
+  printf("test finished\n");
+#endif
+  return 0;
+}
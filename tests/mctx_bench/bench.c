@@ -0,0 +1,294 @@
+/*
+ * Context switching micro benchmark
+ *
+ * Measures the machine context back-end selected at compile time
+ * (USE_MCTX_*, see arch/mctx.h): switch latency between two contexts,
+ * also keeping the floating-point control state, and in rings of many
+ * contexts, the cost of creating a context and of the whole life cycle
+ * of a task context, and the memory footprint of the context and of its
+ * stack frames.
+ *
+ * Output is one CSV line per result: backend,metric,value,unit
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef USE_MCTX_PCL
+#include <pcl.h>
+#endif
+#include "arch/mctx.h"
+
+
+#ifndef BACKEND
+#define BACKEND "unknown"
+#endif
+
+#define STACKSIZE   8192
+/* guard above the stack, writes beyond it are reported */
+#define STACKGUARD  64
+/* position dependent, registers restored from the fill and saved again
+ * at a different place are detected as well */
+#define STACKFILL(i)  ((unsigned char) ((i) * 131 + 7))
+
+static long iterations = 1000000;
+
+static mctx_t ctx_main;
+static mctx_t *ring;
+static int ring_size;
+static volatile long count;
+
+
+static double Now(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void Report(const char *metric, double value, const char *unit)
+{
+  printf("%s,%s,%.2f,%s\n", BACKEND, metric, value, unit);
+}
+
+static char *StackAlloc(void)
+{
+  char *sk = (char *) valloc(STACKSIZE + STACKGUARD);
+  if (sk == NULL) {
+    perror("valloc");
+    exit(EXIT_FAILURE);
+  }
+  return sk;
+}
+
+static void Create(mctx_t *mctx, void (*func)(void *), void *arg, char *sk)
+{
+  mctx_create(mctx, func, arg, sk, STACKSIZE);
+#ifdef USE_MCTX_PCL
+  if (*mctx == NULL) {
+    fprintf(stderr, "co_create failed\n");
+    exit(EXIT_FAILURE);
+  }
+#endif
+}
+
+static void Delete(mctx_t *mctx)
+{
+#ifdef USE_MCTX_PCL
+  co_delete(*mctx);
+#else
+  (void) mctx;
+#endif
+}
+
+
+/******************************************************************************/
+/*  SWITCH LATENCY                                                            */
+/******************************************************************************/
+
+static void PingFunc(void *arg)
+{
+  mctx_t *self = (mctx_t *) arg;
+  while (1) mctx_switch(self, &ctx_main);
+}
+
+/* two contexts switching back and forth */
+static void BenchPingPong(void)
+{
+  mctx_t ctx;
+  char *sk = StackAlloc();
+  long i;
+  double start;
+
+  Create(&ctx, PingFunc, &ctx, sk);
+  mctx_switch(&ctx_main, &ctx);
+
+  start = Now();
+  for (i = 0; i < iterations; i++) {
+    mctx_switch(&ctx_main, &ctx);
+  }
+  Report("switch", (Now() - start) * 1e9 / (2.0 * iterations), "ns");
+
+  Delete(&ctx);
+  free(sk);
+}
+
+static void PingFpFunc(void *arg)
+{
+  mctx_t *self = (mctx_t *) arg;
+  while (1) mctx_switch_fp(self, &ctx_main, MCTX_FP_OLD);
+}
+
+/* the same, the context keeps its floating-point control state */
+static void BenchPingPongFp(void)
+{
+  mctx_t ctx;
+  char *sk = StackAlloc();
+  long i;
+  double start;
+
+  Create(&ctx, PingFpFunc, &ctx, sk);
+  mctx_init_fp(&ctx);
+  mctx_switch_fp(&ctx_main, &ctx, MCTX_FP_NEW);
+
+  start = Now();
+  for (i = 0; i < iterations; i++) {
+    mctx_switch_fp(&ctx_main, &ctx, MCTX_FP_NEW);
+  }
+  Report("switch_fp", (Now() - start) * 1e9 / (2.0 * iterations), "ns");
+
+  Delete(&ctx);
+  free(sk);
+}
+
+
+static void RingFunc(void *arg)
+{
+  int i = (int)(long) arg;
+  while (1) {
+    if (--count <= 0) mctx_switch(&ring[i], &ctx_main);
+    else mctx_switch(&ring[i], &ring[(i + 1) % ring_size]);
+  }
+}
+
+/* n contexts passing control around, exposing the cache footprint */
+static void BenchRing(int n)
+{
+  char **sk = (char **) malloc(n * sizeof(char *));
+  char metric[32];
+  long switches = (iterations / n + 1) * n;
+  double start;
+  int i;
+
+  ring = (mctx_t *) malloc(n * sizeof(mctx_t));
+  ring_size = n;
+  for (i = 0; i < n; i++) {
+    sk[i] = StackAlloc();
+    /* touch the stack pages once, outside the measurement */
+    memset(sk[i], 0, STACKSIZE);
+    Create(&ring[i], RingFunc, (void *)(long) i, sk[i]);
+  }
+
+  /* one warm-up round */
+  count = n;
+  mctx_switch(&ctx_main, &ring[0]);
+
+  /* the last context of the round returned to main, it continues */
+  count = switches;
+  start = Now();
+  mctx_switch(&ctx_main, &ring[n-1]);
+  snprintf(metric, sizeof(metric), "switch_ring_%d", n);
+  Report(metric, (Now() - start) * 1e9 / switches, "ns");
+
+  for (i = 0; i < n; i++) {
+    Delete(&ring[i]);
+    free(sk[i]);
+  }
+  free(ring);
+  free(sk);
+}
+
+
+/******************************************************************************/
+/*  CREATE AND DESTROY                                                        */
+/******************************************************************************/
+
+static void NopFunc(void *arg)
+{
+  mctx_switch((mctx_t *) arg, &ctx_main);
+}
+
+/* mctx_create on a given stack (and deletion, which only PCL has) */
+static void BenchCreate(void)
+{
+  char *sk = StackAlloc();
+  mctx_t ctx;
+  long i;
+  double start = Now();
+
+  for (i = 0; i < iterations; i++) {
+    Create(&ctx, NopFunc, &ctx, sk);
+    Delete(&ctx);
+  }
+  Report("create", (Now() - start) * 1e9 / iterations, "ns");
+  free(sk);
+}
+
+/* the life cycle of a task context: stack allocation, creation,
+ * first switch in and out, deletion */
+static void BenchLifecycle(void)
+{
+  long n = iterations / 10 + 1, i;
+  mctx_t ctx;
+  char *sk;
+  double start = Now();
+
+  for (i = 0; i < n; i++) {
+    sk = StackAlloc();
+    Create(&ctx, NopFunc, &ctx, sk);
+    mctx_switch(&ctx_main, &ctx);
+    Delete(&ctx);
+    free(sk);
+  }
+  Report("lifecycle", (Now() - start) * 1e9 / n, "ns");
+}
+
+
+/******************************************************************************/
+/*  FOOTPRINT                                                                 */
+/******************************************************************************/
+
+/* stack consumed by the back-end: creation, entry and one switch */
+static void BenchFootprint(void)
+{
+  char *sk = StackAlloc();
+  mctx_t ctx;
+  int used, beyond = 0, i;
+
+  for (i = 0; i < STACKSIZE + STACKGUARD; i++) sk[i] = STACKFILL(i);
+  Create(&ctx, NopFunc, &ctx, sk);
+  mctx_switch(&ctx_main, &ctx);
+
+  for (used = 0; used < STACKSIZE; used++) {
+    if ((unsigned char) sk[used] != STACKFILL(used)) break;
+  }
+  /* writes above the stack given to mctx_create */
+  for (i = 0; i < STACKGUARD; i++) {
+    if ((unsigned char) sk[STACKSIZE + i] != STACKFILL(STACKSIZE + i)) {
+      beyond = i + 1;
+    }
+  }
+  Report("context_size", sizeof(mctx_t), "bytes");
+  Report("stack_used", STACKSIZE - used, "bytes");
+  Report("stack_overrun", beyond, "bytes");
+
+  Delete(&ctx);
+  free(sk);
+}
+
+
+int main(int argc, char **argv)
+{
+  if (argc > 1) iterations = atol(argv[1]);
+  if (iterations <= 0) {
+    fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+#ifdef USE_MCTX_PCL
+  co_thread_init();
+  ctx_main = co_current();
+#endif
+
+  BenchFootprint();
+  BenchPingPong();
+  BenchPingPongFp();
+  BenchRing(16);
+  BenchRing(256);
+  BenchRing(4096);
+  BenchCreate();
+  BenchLifecycle();
+  return EXIT_SUCCESS;
+}